@@ -64,17 +64,28 @@
 #include "nrf_ble_qwr.h"
 #include "app_timer.h"
 #include "ble_nus.h"
-#include "app_uart.h"
+#include "uart_dma.h"
+#include "uart_framing.h"
+#include "flow_ctrl.h"
+#include "flash_manager.h"
+#include "at_command_parser.h"
+#include "pipeline.h"
+#include "frame_pool.h"
+#include "spsc_ring.h"
+#include "crypto_session.h"
+#include "key_exchange.h"
+#include "resume_cache.h"
+#include "crypto_bench.h"
+#include "ble_tx_queue.h"
+#include "ble_coalesce.h"
+#include "ble_rx.h"
+#include "app_scheduler.h"
 #include "app_util_platform.h"
 #include "bsp_btn_ble.h"
 #include "nrf_pwr_mgmt.h"
 #include "nrf_drv_gpiote.h"
 #include "app_button.h"
 
-// Add ECDH related includes
-#include "nrf_crypto_ecc.h"
-#include "nrf_crypto_ecdh.h"
-
 #if defined (UART_PRESENT)
 #include "nrf_uart.h"
 #endif
@@ -88,6 +99,10 @@
 #include "fds.h"
 #include "nrf_fstorage.h"
 
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
 // Remove base64 encoding/decoding
 // #include "mbedtls/base64.h"
 
@@ -97,18 +112,23 @@
 #define NUS_SERVICE_UUID_TYPE           BLE_UUID_TYPE_VENDOR_BEGIN                  /**< UUID type for the Nordic UART Service (vendor specific). */
 
 // Further reduce buffer sizes
-#define UART_TX_BUF_SIZE                32                                         /**< Reduced from 64 */
-#define UART_RX_BUF_SIZE                32                                         /**< Reduced from 64 */
-#define NRF_CRYPTO_AES_MAX_DATA_SIZE    32                                         /**< Reduced from 64 */
 #define BASE64_MAX_DATA_SIZE            32                                         /**< Reduced from 64 */
 
 // Key exchange message types
 #define MSG_TYPE_KEY_EXCHANGE_REQ       0x0001  /**< Key exchange request message type */
 #define MSG_TYPE_KEY_EXCHANGE_RESP      0x0002  /**< Key exchange response message type */
 #define MSG_TYPE_DATA                   0x0003  /**< Encrypted data message type */
+#define MSG_TYPE_RESUME_REQ             0x0004  /**< Session resumption request: session ID, central nonce */
+#define MSG_TYPE_RESUME_RESP            0x0005  /**< Session resumed: peripheral nonce */
+#define MSG_TYPE_RESUME_REJECT          0x0006  /**< Unknown session, a full key exchange follows */
+#define MSG_TYPE_PSK_REQ                0x0007  /**< Pre-shared key handshake request: requester nonce */
+#define MSG_TYPE_PSK_RESP               0x0008  /**< Pre-shared key handshake response: responder nonce */
+#define MSG_TYPE_PSK_REJECT             0x0009  /**< Pre-shared key mode is off, a full key exchange follows */
 
 #define KEY_EXCHANGE_MSG_HEADER_SIZE    2       /**< Size of message type header */
-#define PUBLIC_KEY_SIZE                 64      /**< Size of secp256r1 public key */
+#define RESUME_REQ_SIZE                 (KEY_EXCHANGE_MSG_HEADER_SIZE + RESUME_CACHE_ID_SIZE + KEY_EXCHANGE_NONCE_SIZE)
+#define RESUME_RESP_SIZE                (KEY_EXCHANGE_MSG_HEADER_SIZE + KEY_EXCHANGE_NONCE_SIZE)
+#define PSK_MSG_SIZE                    (KEY_EXCHANGE_MSG_HEADER_SIZE + KEY_EXCHANGE_NONCE_SIZE)
 
 #define APP_BLE_OBSERVER_PRIO           3                                           /**< Application's BLE observer priority. You shouldn't need to modify this value. */
 
@@ -124,6 +144,16 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(10000)                     /**< Reduced from 30000 */
 #define MAX_CONN_PARAMS_UPDATE_COUNT    1                                           /**< Reduced from 3 */
 
+#define UART_FLOW_CONTROL               true                                        /**< Use RTS/CTS hardware flow control on the UART. */
+#define BLE_TX_HIGH_WATERMARK           128                                         /**< Stop UART reception when this many bytes wait for the radio. */
+#define BLE_TX_LOW_WATERMARK            32                                          /**< Restart UART reception when the backlog has dropped to this many bytes. */
+#define AT_COMMAND_MAX_LEN              64                                          /**< Longest AT command accepted over UART. */
+#define UART_RX_HIGH_WATERMARK          (PIPELINE_UART_RX_DEPTH - 1)                /**< Stop UART reception when this many frames wait to be sent. */
+#define UART_RX_LOW_WATERMARK           (PIPELINE_UART_RX_DEPTH - 2)                /**< Restart UART reception when this many frames wait to be sent. */
+#define UART_RX_RING_SIZE               256                                         /**< Received UART bytes waiting to be split into frames in the main loop. */
+#define UART_RX_RING_HEADROOM           (2 * UART_DMA_RX_CHUNK_SIZE)                /**< Pause UART reception with less room than the chunks that may still arrive. */
+#define UART_RX_IDLE_RING_SIZE          16                                          /**< Line idle positions waiting for the main loop, 4 bytes each. */
+
 #define DEAD_BEEF                       0xDEADBEEF                                  /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
 BLE_NUS_DEF(m_nus, NRF_SDH_BLE_TOTAL_LINK_COUNT);                                   /**< BLE NUS service instance. */
@@ -138,7 +168,20 @@ static ble_uuid_t m_adv_uuids[]          =
     {BLE_UUID_NUS_SERVICE, NUS_SERVICE_UUID_TYPE}
 };
 
-static bool m_at_command_mode = false;
+static bool m_at_command_mode = true;                                               /**< UART frames are AT commands while no central is connected. */
+static key_exchange_curve_t m_key_exchange_curve;                                  /**< Curve of the key exchange request of the peer being answered. */
+static bool m_key_exchange_sent;                                                    /**< The first UART frame of the session has sent our key exchange request. */
+static bool m_records_held;                                                         /**< Records wait in the pipeline for the key exchange that came before them. */
+static volatile bool m_session_end_pending;                                         /**< Set on disconnect, the session is ended in the main loop. */
+
+static flow_ctrl_t     m_ble_tx_flow;                                               /**< Throttles the UART with the BLE transmit backlog. */
+static flow_ctrl_t     m_uart_rx_flow;                                              /**< Throttles the UART with the number of frames waiting to be sent. */
+static ble_tx_queue_t  m_ble_tx_queue;                                              /**< Notifications waiting for room in the SoftDevice. */
+static volatile bool   m_uart_rx_ring_full;                                         /**< Throttles the UART while @ref m_uart_rx_ring has no headroom. */
+static uint32_t        m_uart_rx_ring_dropped;                                      /**< Received bytes lost because @ref m_uart_rx_ring was full. */
+
+SPSC_RING_DEF(m_uart_rx_ring, UART_RX_RING_SIZE);                                   /**< Received bytes, written by the UART interrupt and read by the main loop. */
+SPSC_RING_DEF(m_uart_rx_idle_ring, UART_RX_IDLE_RING_SIZE);                         /**< Write positions of @ref m_uart_rx_ring at which the line went idle. */
 
 
 /**@brief Function for assert macro callback.
@@ -210,27 +253,12 @@ static void nrf_qwr_error_handler(uint32_t nrf_error)
 /////////////////////////////////////////////////
 //encrypt globals
 /////////////////////////////////////////////////
-static nrf_crypto_ecc_private_key_t m_private_key;
-static nrf_crypto_ecc_public_key_t m_public_key;
-static nrf_crypto_ecc_secp256r1_raw_public_key_t m_raw_public_key;
-static nrf_crypto_ecdh_secp256r1_shared_secret_t m_shared_secret;
-static bool m_ecdh_initialized = false;
-
 static uint8_t m_key[32] = {'A', 'O', 'R', 'D', 'I', 'C', ' ',
                             'S', 'E', 'M', 'I', 'C', 'O', 'N', 'D', 'U', 'C', 'T', 'O', 'R',
                             'A', 'E', 'S', '&', 'M', 'A', 'C', ' ', 'T', 'E', 'S', 'T'};
 
-static nrf_crypto_key_size_id_t m_key_size = NRF_CRYPTO_KEY_SIZE_256;
-static uint8_t iv[16];
-static nrf_crypto_aes_info_t const * p_cbc_info;
-static nrf_crypto_aes_context_t cbc_encr_ctx;   
-static nrf_crypto_aes_context_t cbc_decr_ctx;   
+STATIC_ASSERT(sizeof(m_key) == CRYPTO_SESSION_KEY_SIZE);
 
-static char encrypted_data[NRF_CRYPTO_AES_MAX_DATA_SIZE];  
-static int encrypted_data_len = 0;
-  
-static char decrypted_data[NRF_CRYPTO_AES_MAX_DATA_SIZE];    
-static int decrypted_data_len = 0;
 
 /////////////////////////////////////////////////
 //FDS globals
@@ -260,11 +288,11 @@ static void fds_evt_handler(fds_evt_t const * p_evt)
 {
     if (p_evt->result == NRF_SUCCESS)
     {
-        printf("FDS event: %d\r\n", p_evt->id);
+        NRF_LOG_DEBUG("fds_evt_handler, event: %d.", p_evt->id);
     }
     else
     {
-        printf("FDS error: 0x%x\r\n", p_evt->result);
+        NRF_LOG_ERROR("fds_evt_handler, error: 0x%x.", p_evt->result);
     }
 
     if (p_evt->id == FDS_EVT_INIT && p_evt->result == NRF_SUCCESS)
@@ -273,180 +301,330 @@ static void fds_evt_handler(fds_evt_t const * p_evt)
     }
 }
 
-void print_as_hex(const uint8_t *data, int len) {
-    for (int i = 0; i < len; ++i) {
-        printf("%02X ", data[i]);
+//Encryption method
+//Encrypts len bytes in place. CBC pads the buffer to the next multiple of 16, CTR and CCM append the record number and CCM the tag before it, so size must leave room for them.
+//Records are held back while a key exchange runs, see records_hold, so the session keys are current.
+ret_code_t encrypt_data(uint8_t * p_data, size_t len, size_t size, size_t * p_encrypted_len) 
+{     
+    return crypto_session_encrypt(p_data, len, size, p_encrypted_len);
+}
+
+//Decryption method
+//Decrypts len bytes in place with the shared secret as the key. A CCM record whose tag does not
+//match is rejected, so it never reaches the UART.
+ret_code_t decrypt_data(uint8_t * p_data, size_t len, size_t * p_decrypted_len) 
+{    
+    ret_code_t ret_val = crypto_session_decrypt(p_data, len, p_decrypted_len);
+    if (ret_val == NRF_ERROR_INVALID_LENGTH)
+    {
+        printf("decrypt_data, invalid size!\r\n");  
     }
-    printf("\r\n");
+    else if (ret_val == NRF_ERROR_INVALID_DATA)
+    {
+        printf("decrypt_data, authentication failed!\r\n");  
+    }
+     
+    return ret_val;
 }
 
-//Initialize all encryption data.
-void crypt_init()
+/**@brief Hand a notification to the SoftDevice, the send function of @ref m_ble_tx_queue. */
+static uint32_t ble_nus_send(uint8_t * p_data, uint16_t * p_length, void * p_context)
 {
-    printf("crypt_init\r\n"); 
-    ret_code_t  ret_val;
-    memset(iv, 0, sizeof(iv));    
-    
-    p_cbc_info = &g_nrf_crypto_aes_cbc_256_info;    
-    /* Init encrypt and decrypt context */
-    ret_val = nrf_crypto_aes_init(&cbc_encr_ctx,
-                                  p_cbc_info,
-                                  NRF_CRYPTO_ENCRYPT);
-    APP_ERROR_CHECK(ret_val);
-
-    /* Set encryption and decryption key */
-    ret_val = nrf_crypto_aes_key_set(&cbc_encr_ctx, m_key);
-    APP_ERROR_CHECK(ret_val);
-
-    /* Set IV */
-    ret_val = nrf_crypto_aes_iv_set(&cbc_encr_ctx, iv);
-    APP_ERROR_CHECK(ret_val);
-
-    printf("crypt_init succeeded\r\n"); 
+    return ble_nus_data_send(p_context, p_data, p_length, m_conn_handle);
 }
 
-// Initialize ECDH and generate key pair
-ret_code_t ecdh_init(void)
+/**@brief Encrypt a record in place and queue it for sending. Also the flush function of the
+ *        coalescing stage.
+ *
+ * @param[in] p_record  Record in a frame pool block, overwritten with the ciphertext. The block is
+ *                      handed on to @ref m_ble_tx_queue.
+ * @param[in] length    Record length.
+ * @param[in] size      Size of the buffer at @p p_record, room for the padding, the tag and the
+ *                      record number.
+ */
+static void ble_record_send(uint8_t * p_record, size_t length, size_t size)
 {
-    ret_code_t err_code;
-    size_t size;
+    size_t encrypted_len;
 
-    if (m_ecdh_initialized)
+    ret_code_t err_code = encrypt_data(p_record, length, size, &encrypted_len); 
+    if (err_code != NRF_SUCCESS)
     {
-        return NRF_SUCCESS;
+        // For example CTR before the first key exchange.
+        frame_pool_free(p_record);
+        printf("Encryption failed: 0x%x\r\n", (unsigned int)err_code);
+        return;
     }
 
-    // Generate new key pair
-    err_code = nrf_crypto_ecc_key_pair_generate(NULL,
-                                               &g_nrf_crypto_ecc_secp256r1_curve_info,
-                                               &m_private_key,
-                                               &m_public_key);
-    APP_ERROR_CHECK(err_code);
+    // Counted in the queue statistics if the queue is full.
+    UNUSED_RETURN_VALUE(ble_tx_queue_push(&m_ble_tx_queue, p_record, (uint16_t)encrypted_len));
+}
 
-    // Convert public key to raw format for transmission
-    size = sizeof(m_raw_public_key);
-    err_code = nrf_crypto_ecc_public_key_to_raw(&m_public_key,
-                                               m_raw_public_key,
-                                               &size);
-    APP_ERROR_CHECK(err_code);
+/**@brief Tell the coalescing stage whether notifications are still waiting to be sent. */
+static bool ble_tx_busy(void)
+{
+    return !ble_tx_queue_is_idle(&m_ble_tx_queue);
+}
 
-    // Free the public key structure as we only need the raw format
-    err_code = nrf_crypto_ecc_public_key_free(&m_public_key);
-    APP_ERROR_CHECK(err_code);
+/**@brief Size records and UART frames to what one encrypted notification can carry. */
+static void ble_payload_len_update(void)
+{
+    uint16_t record_max = crypto_session_plaintext_max(MIN(m_ble_nus_max_data_len, BLE_COALESCE_BUF_SIZE));
+
+    ble_coalesce_capacity_set(record_max);
+    uart_framing_max_len_set(record_max - BLE_COALESCE_TAG_SIZE);
+}
+
+/**@brief Print the BLE transmit queue statistics. */
+static void ble_tx_queue_stats_print(void)
+{
+    ble_tx_queue_stats_t stats;
+    ble_tx_queue_stats_get(&m_ble_tx_queue, &stats);
+
+    printf("BLE TX: queued %lu, sent %lu, overflow %lu, dropped %lu, max depth %d\r\n",
+           (unsigned long)stats.queued, (unsigned long)stats.sent,
+           (unsigned long)stats.overflow, (unsigned long)stats.dropped, stats.depth_max);
+}
+
+/**@brief Pause UART reception while the BLE transmit backlog or the queue of received frames is
+ *        above its high watermark, or the received bytes ring is nearly full.
+ */
+static void uart_rx_pause_update(void)
+{
+    uart_dma_rx_pause(m_ble_tx_flow.paused || m_uart_rx_flow.paused || m_uart_rx_ring_full);
+}
+
+static void uart_rx_flow_handler(bool paused, void * p_context)
+{
+    UNUSED_PARAMETER(paused);
+    UNUSED_PARAMETER(p_context);
+
+    uart_rx_pause_update();
+}
 
-    m_ecdh_initialized = true;
-    return NRF_SUCCESS;
+/**@brief Hold the records received over UART and BLE from now on until the key exchange just
+ *        started has ended, so that none overtakes it. The ECDH runs step by step in the main
+ *        loop meanwhile.
+ */
+static void records_hold(void)
+{
+    if (!m_records_held)
+    {
+        m_records_held = true;
+        pipeline_pause();
+    }
+}
+
+/**@brief Process the records held by @ref records_hold, in the order they came. */
+static void records_release(void)
+{
+    if (m_records_held)
+    {
+        m_records_held = false;
+        pipeline_resume();
+    }
+}
+
+/**@brief Send our public key in answer to a key exchange request, once the session keys are set. */
+static void key_exchange_req_done(ret_code_t result, uint32_t latency_us)
+{
+    // The response is queued before the held records are encrypted with the new keys.
+    records_release();
+
+    if (result != NRF_SUCCESS)
+    {
+        printf("Key exchange failed: 0x%x\r\n", (unsigned int)result);
+        return;
+    }
+
+    uint8_t * response = frame_pool_alloc();
+    ret_code_t err_code = NRF_ERROR_NO_MEM;
+
+    if (response != NULL)
+    {
+        size_t key_size = key_exchange_public_key_size(m_key_exchange_curve);
+
+        // The key pair was taken when the job started, on the curve of the request.
+        response[0] = (MSG_TYPE_KEY_EXCHANGE_RESP >> 8) & 0xFF;
+        response[1] = MSG_TYPE_KEY_EXCHANGE_RESP & 0xFF;
+        memcpy(response + KEY_EXCHANGE_MSG_HEADER_SIZE, 
+              key_exchange_public_key_get(m_key_exchange_curve), 
+              key_size);
+
+        err_code = ble_tx_queue_push(&m_ble_tx_queue,
+                                     response,
+                                     KEY_EXCHANGE_MSG_HEADER_SIZE + key_size);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        printf("Key exchange response dropped\r\n");
+    }
+
+    printf("Key exchange completed successfully in %lu us\r\n", (unsigned long)latency_us);
 }
 
-// Compute shared secret from received public key
-ret_code_t ecdh_compute_shared_secret(const uint8_t *p_peer_public_key, size_t key_size)
+/**@brief Report the end of a key exchange this device started. */
+static void key_exchange_resp_done(ret_code_t result, uint32_t latency_us)
 {
+    records_release();
+
+    if (result != NRF_SUCCESS)
+    {
+        printf("Key exchange failed: 0x%x\r\n", (unsigned int)result);
+        return;
+    }
+
+    printf("Key exchange completed successfully in %lu us\r\n", (unsigned long)latency_us);
+}
+
+/**@brief Send a key exchange request in @p p_block, which is handed on.
+ *
+ * @param[in] psk  Start a pre-shared key handshake instead of an ECDH key exchange.
+ */
+static ret_code_t key_exchange_request_send(uint8_t * p_block, bool psk)
+{
+    uint16_t   msg_type;
+    uint16_t   msg_len;
     ret_code_t err_code;
-    nrf_crypto_ecc_public_key_t peer_public_key;
-    size_t shared_secret_size;
-
-    // Convert received public key to internal format
-    err_code = nrf_crypto_ecc_public_key_from_raw(&g_nrf_crypto_ecc_secp256r1_curve_info,
-                                                 &peer_public_key,
-                                                 p_peer_public_key,
-                                                 key_size);
-    APP_ERROR_CHECK(err_code);
 
-    // Compute shared secret
-    shared_secret_size = sizeof(m_shared_secret);
-    err_code = nrf_crypto_ecdh_compute(NULL,
-                                      &m_private_key,
-                                      &peer_public_key,
-                                      m_shared_secret,
-                                      &shared_secret_size);
-    APP_ERROR_CHECK(err_code);
+    if (psk)
+    {
+        msg_type = MSG_TYPE_PSK_REQ;
+        msg_len  = PSK_MSG_SIZE;
+        err_code = key_exchange_psk_request(p_block + KEY_EXCHANGE_MSG_HEADER_SIZE);
+    }
+    else
+    {
+        key_exchange_curve_t curve        = (key_exchange_curve_t)flash_mgr_get_curve();
+        uint8_t const *      p_public_key = key_exchange_public_key_get(curve);
+        size_t               key_size     = key_exchange_public_key_size(curve);
+
+        // The curve is offered by the size of the key, the peer answers on the same one.
+        msg_type = MSG_TYPE_KEY_EXCHANGE_REQ;
+        msg_len  = KEY_EXCHANGE_MSG_HEADER_SIZE + key_size;
+        err_code = (p_public_key != NULL) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+        if (err_code == NRF_SUCCESS)
+        {
+            memcpy(p_block + KEY_EXCHANGE_MSG_HEADER_SIZE, p_public_key, key_size);
+        }
+    }
 
-    // Clean up
-    err_code = nrf_crypto_ecc_public_key_free(&peer_public_key);
-    APP_ERROR_CHECK(err_code);
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_block);
+        return err_code;
+    }
 
-    return NRF_SUCCESS;
+    p_block[0] = (msg_type >> 8) & 0xFF;
+    p_block[1] = msg_type & 0xFF;
+
+    return ble_tx_queue_push(&m_ble_tx_queue, p_block, msg_len);
 }
 
-//Encryption method
-ret_code_t encrypt_data(char * data, int len) 
-{     
-    ret_code_t  ret_val;
+/**@brief Answer a pre-shared key handshake request, or reject it if the mode is off. */
+static ret_code_t handle_psk_request(const uint8_t * p_data)
+{
+    uint8_t *  p_msg = frame_pool_alloc();
+    ret_code_t err_code;
+    uint16_t   msg_type;
+    uint16_t   msg_len;
 
-    if (!m_ecdh_initialized)
+    if (p_msg == NULL)
     {
-        return NRF_ERROR_INVALID_STATE;
+        return NRF_ERROR_NO_MEM;
     }
 
-    crypt_init();
+    if (flash_mgr_get_psk_mode())
+    {
+        err_code = key_exchange_psk_respond(m_key,
+                                            p_data + KEY_EXCHANGE_MSG_HEADER_SIZE,
+                                            p_msg + KEY_EXCHANGE_MSG_HEADER_SIZE);
+    }
+    else
+    {
+        err_code = NRF_ERROR_NOT_SUPPORTED;
+    }
 
-    memset(encrypted_data, 0, sizeof(encrypted_data));    
+    if (err_code == NRF_SUCCESS)
+    {
+        key_exchange_stats_t stats;
+        key_exchange_stats_get(&stats);
+        printf("Pre-shared key handshake completed in %lu us\r\n", (unsigned long)stats.psk_last_us);
 
-    char data_to_encrypt[NRF_CRYPTO_AES_MAX_DATA_SIZE];
-    int data_to_encrypt_len = 0;
+        m_key_exchange_sent = true;
+        msg_type = MSG_TYPE_PSK_RESP;
+        msg_len  = PSK_MSG_SIZE;
+    }
+    else
+    {
+        msg_type = MSG_TYPE_PSK_REJECT;
+        msg_len  = KEY_EXCHANGE_MSG_HEADER_SIZE;
+    }
 
-    //We set the buffer with 0x4 instead of 0x0 due to the way the decryption in the android app works.
-    memset(data_to_encrypt, 4, sizeof(data_to_encrypt));
-    
-    memcpy(data_to_encrypt, data, len);     
-    
-    //len should be a multiple of 16. so we take the closest 16 multiple to len.
-    data_to_encrypt_len = ((len / 16)  + 1) * 16;  //integer devided by 16 
+    p_msg[0] = (msg_type >> 8) & 0xFF;
+    p_msg[1] = msg_type & 0xFF;
 
-    encrypted_data_len = sizeof(encrypted_data);
+    if (ble_tx_queue_push(&m_ble_tx_queue, p_msg, msg_len) != NRF_SUCCESS)
+    {
+        printf("Pre-shared key response dropped\r\n");
+    }
 
-    /* Encrypt using the shared secret as the key */
-    ret_val = nrf_crypto_aes_finalize(&cbc_encr_ctx,
-                                      (uint8_t *)data_to_encrypt,
-                                      data_to_encrypt_len,
-                                      (uint8_t *)encrypted_data,
-                                      &encrypted_data_len);
-     
-    return ret_val;
+    return err_code;
 }
 
-//Decryption method
-ret_code_t decrypt_data(const uint8_t * data, int len) 
-{    
-    ret_code_t  ret_val;
+/**@brief Answer a resumption request, with our nonce if the session was resumed.
+ *
+ * @details The central sends no data before the answer, it needs our nonce for its keys. A
+ *          rejected central starts a full key exchange.
+ */
+static ret_code_t handle_resume(const uint8_t * p_data)
+{
+    uint8_t *  p_msg = frame_pool_alloc();
+    ret_code_t err_code;
+    uint16_t   msg_type;
+    uint16_t   msg_len;
 
-    if (!m_ecdh_initialized)
+    if (p_msg == NULL)
     {
-        printf("ECDH not initialized!\r\n");
-        return NRF_ERROR_INVALID_STATE;
+        return NRF_ERROR_NO_MEM;
     }
 
-    if (len % 16 != 0)
+    err_code = key_exchange_resume(p_data + KEY_EXCHANGE_MSG_HEADER_SIZE,
+                                   p_data + KEY_EXCHANGE_MSG_HEADER_SIZE + RESUME_CACHE_ID_SIZE,
+                                   p_msg + KEY_EXCHANGE_MSG_HEADER_SIZE);
+    if (err_code == NRF_SUCCESS)
     {
-        printf("decrypt_data, invalid size!\r\n");  
-        return NRF_ERROR_INVALID_LENGTH;
+        key_exchange_stats_t stats;
+        key_exchange_stats_get(&stats);
+        printf("Session resumed in %lu us\r\n", (unsigned long)stats.resume_last_us);
+
+        // The session is set up, no request of our own is needed.
+        m_key_exchange_sent = true;
+        msg_type = MSG_TYPE_RESUME_RESP;
+        msg_len  = RESUME_RESP_SIZE;
+    }
+    else
+    {
+        msg_type = MSG_TYPE_RESUME_REJECT;
+        msg_len  = KEY_EXCHANGE_MSG_HEADER_SIZE;
     }
 
-    crypt_init();
-    
-    memset(decrypted_data, 0, sizeof(decrypted_data));
+    p_msg[0] = (msg_type >> 8) & 0xFF;
+    p_msg[1] = msg_type & 0xFF;
 
-    decrypted_data_len = sizeof(decrypted_data);
-    
-    ret_val = nrf_crypto_aes_crypt(&cbc_decr_ctx,
-                                   p_cbc_info,
-                                   NRF_CRYPTO_DECRYPT,
-                                   m_shared_secret,  // Use shared secret as key
-                                   iv,
-                                   (uint8_t *)data,
-                                   len,
-                                   (uint8_t *)decrypted_data,
-                                   &decrypted_data_len);
-     
-    return ret_val;
+    if (ble_tx_queue_push(&m_ble_tx_queue, p_msg, msg_len) != NRF_SUCCESS)
+    {
+        printf("Resumption response dropped\r\n");
+    }
+
+    return err_code;
 }
 
 // Handle key exchange
-static ret_code_t handle_key_exchange(const uint8_t * p_data, uint16_t length, uint16_t conn_handle)
+// The shared secret is computed in the background by key_exchange_process, the request is
+// answered when it is done.
+// Notifications go out on the current connection through m_ble_tx_queue.
+static ret_code_t handle_key_exchange(const uint8_t * p_data, uint16_t length)
 {
-    ret_code_t err_code;
-    static bool key_exchanged = false;
-    
     if (length < KEY_EXCHANGE_MSG_HEADER_SIZE)
     {
         return NRF_ERROR_INVALID_LENGTH;
@@ -458,124 +636,123 @@ static ret_code_t handle_key_exchange(const uint8_t * p_data, uint16_t length, u
     {
         case MSG_TYPE_KEY_EXCHANGE_REQ:
         {
-            if (length != KEY_EXCHANGE_MSG_HEADER_SIZE + PUBLIC_KEY_SIZE)
+            key_exchange_curve_t curve;
+
+            if (key_exchange_curve_from_size(length - KEY_EXCHANGE_MSG_HEADER_SIZE, &curve) != NRF_SUCCESS)
             {
                 return NRF_ERROR_INVALID_LENGTH;
             }
 
-            // Compute shared secret from received public key
-            err_code = ecdh_compute_shared_secret(p_data + KEY_EXCHANGE_MSG_HEADER_SIZE, 
-                                                PUBLIC_KEY_SIZE);
-            APP_ERROR_CHECK(err_code);
+            ret_code_t err_code = key_exchange_start(curve,
+                                                     p_data + KEY_EXCHANGE_MSG_HEADER_SIZE,
+                                                     key_exchange_req_done);
+            if (err_code == NRF_SUCCESS)
+            {
+                m_key_exchange_curve = curve;
+                records_hold();
+            }
+            return err_code;
+        }
 
-            // Send our public key back
-            uint8_t response[KEY_EXCHANGE_MSG_HEADER_SIZE + PUBLIC_KEY_SIZE];
-            response[0] = (MSG_TYPE_KEY_EXCHANGE_RESP >> 8) & 0xFF;
-            response[1] = MSG_TYPE_KEY_EXCHANGE_RESP & 0xFF;
-            memcpy(response + KEY_EXCHANGE_MSG_HEADER_SIZE, 
-                  m_raw_public_key, 
-                  sizeof(m_raw_public_key));
-            
-            uint16_t response_length = sizeof(response);
-            do
+        case MSG_TYPE_KEY_EXCHANGE_RESP:
+        {
+            key_exchange_curve_t curve;
+
+            if (key_exchange_curve_from_size(length - KEY_EXCHANGE_MSG_HEADER_SIZE, &curve) != NRF_SUCCESS)
             {
-                err_code = ble_nus_data_send(&m_nus, response, &response_length, conn_handle);
-                if ((err_code != NRF_ERROR_INVALID_STATE) &&
-                    (err_code != NRF_ERROR_RESOURCES) &&
-                    (err_code != NRF_ERROR_NOT_FOUND))
-                {
-                    APP_ERROR_CHECK(err_code);
-                }
-            } while (err_code == NRF_ERROR_RESOURCES);
+                return NRF_ERROR_INVALID_LENGTH;
+            }
 
-            key_exchanged = true;
-            printf("Key exchange completed successfully\r\n");
-            break;
+            ret_code_t err_code = key_exchange_start(curve,
+                                                     p_data + KEY_EXCHANGE_MSG_HEADER_SIZE,
+                                                     key_exchange_resp_done);
+            if (err_code == NRF_SUCCESS)
+            {
+                records_hold();
+            }
+            return err_code;
         }
 
-        case MSG_TYPE_KEY_EXCHANGE_RESP:
+        case MSG_TYPE_RESUME_REQ:
         {
-            if (length != KEY_EXCHANGE_MSG_HEADER_SIZE + PUBLIC_KEY_SIZE)
+            if (length != RESUME_REQ_SIZE)
             {
                 return NRF_ERROR_INVALID_LENGTH;
             }
 
-            // Compute shared secret from received public key
-            err_code = ecdh_compute_shared_secret(p_data + KEY_EXCHANGE_MSG_HEADER_SIZE, 
-                                                PUBLIC_KEY_SIZE);
-            APP_ERROR_CHECK(err_code);
+            return handle_resume(p_data);
+        }
 
-            key_exchanged = true;
-            printf("Key exchange completed successfully\r\n");
-            break;
+        case MSG_TYPE_PSK_REQ:
+        {
+            if (length != PSK_MSG_SIZE)
+            {
+                return NRF_ERROR_INVALID_LENGTH;
+            }
+
+            return handle_psk_request(p_data);
+        }
+
+        case MSG_TYPE_PSK_RESP:
+        {
+            if (length != PSK_MSG_SIZE)
+            {
+                return NRF_ERROR_INVALID_LENGTH;
+            }
+
+            ret_code_t err_code = key_exchange_psk_complete(m_key, p_data + KEY_EXCHANGE_MSG_HEADER_SIZE);
+            if (err_code == NRF_SUCCESS)
+            {
+                key_exchange_stats_t stats;
+                key_exchange_stats_get(&stats);
+                printf("Pre-shared key handshake completed in %lu us\r\n", (unsigned long)stats.psk_last_us);
+            }
+            return err_code;
+        }
+
+        case MSG_TYPE_PSK_REJECT:
+        {
+            // The central has no pre-shared key mode, fall back to ECDH.
+            uint8_t * p_block = frame_pool_alloc();
+            if ((p_block == NULL) || (key_exchange_request_send(p_block, false) != NRF_SUCCESS))
+            {
+                printf("Key exchange request dropped\r\n");
+            }
+            return NRF_ERROR_NOT_SUPPORTED;
         }
 
         default:
             return NRF_ERROR_INVALID_DATA;
     }
-
-    return NRF_SUCCESS;
 }
 
+/**@brief What the BLE receive stage needs from the application. */
+static ble_rx_ops_t const m_ble_rx_ops =
+{
+    .key_exchange = handle_key_exchange,
+    .decrypt      = decrypt_data,
+    .send         = uart_dma_send,
+};
+
+
 /**@brief Function for handling the data from the Nordic UART Service.
  *
- * @details This function will process the data received from the Nordic UART BLE Service and send
- *          it to the UART module.
+ * @details This function runs in the SoftDevice event handler. It only queues the received data,
+ *          which is processed in the main loop by @ref ble_rx_process.
  *
  * @param[in] p_evt       Nordic UART Service event.
  */
 /**@snippet [Handling the data received over BLE] */
 static void nus_data_handler(ble_nus_evt_t * p_evt)
 {
-
     if (p_evt->type == BLE_NUS_EVT_RX_DATA)
     {
-        uint32_t err_code;
-        static bool key_exchanged = false;
-
-        printf("Received data from BLE NUS\r\n");
-
-        // Check if this is a key exchange message
-        if (!key_exchanged)
-        {
-            err_code = handle_key_exchange(p_evt->params.rx_data.p_data, 
-                                         p_evt->params.rx_data.length,
-                                         m_conn_handle);
-            if (err_code == NRF_SUCCESS)
-            {
-                key_exchanged = true;
-                return;
-            }
-            else if (err_code != NRF_ERROR_INVALID_DATA)
-            {
-                printf("Key exchange failed: 0x%x\r\n", err_code);
-                return;
-            }
-            // If NRF_ERROR_INVALID_DATA, continue with normal data processing
-        }
-
-        // Handle normal encrypted data
-        err_code = decrypt_data(p_evt->params.rx_data.p_data, p_evt->params.rx_data.length);
-        printf("Decryption ended. ret code: 0x%x, size: %d\r\n", err_code, decrypted_data_len);
-
-        APP_ERROR_CHECK(err_code);
-
-        //remove all trailing bytes after the '=' character.
-        for(;decrypted_data_len > 0 && decrypted_data[decrypted_data_len-1] < ' '; decrypted_data_len--);
-
-        printf("base64 encoded data length: %d\r\n", decrypted_data_len);
-
-        for (uint32_t i = 0; i < decrypted_data_len; i++)
+        uint32_t err_code = pipeline_put(PIPELINE_STAGE_BLE_RX,
+                                         p_evt->params.rx_data.p_data,
+                                         p_evt->params.rx_data.length);
+        if (err_code != NRF_SUCCESS)
         {
-            do
-            {                
-                err_code = app_uart_put(decrypted_data[i]);
-                if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_BUSY))
-                {
-                    printf("Failed receiving NUS message. Error 0x%x. \r\n", err_code);
-                    APP_ERROR_CHECK(err_code);
-                }
-            } while (err_code == NRF_ERROR_BUSY);
+            NRF_LOG_WARNING("nus_data_handler, BLE data dropped. error: 0x%x.", err_code);
         }
     }
 }
@@ -649,14 +826,133 @@ static void power_management_init(void)
 }
 
 
+/**@brief   Function for splitting the received bytes into frames, in the main loop.
+ *
+ * @details Takes whole contiguous spans of @ref m_uart_rx_ring, stopping at every position where
+ *          the line went idle so that the idle gap ends the right frame.
+ */
+static void uart_rx_ring_process(void)
+{
+    for (;;)
+    {
+        uint8_t const * p_span;
+        uint32_t        idle_at = 0;
+        bool            idle    = (spsc_ring_read_span(&m_uart_rx_idle_ring, &p_span) >= sizeof(idle_at));
+
+        if (idle)
+        {
+            memcpy(&idle_at, p_span, sizeof(idle_at));
+        }
+
+        size_t length = spsc_ring_read_span(&m_uart_rx_ring, &p_span);
+        if (idle)
+        {
+            length = MIN(length, idle_at - m_uart_rx_ring.read);
+        }
+
+        if (length > 0)
+        {
+            uart_framing_rx(p_span, length);
+            spsc_ring_read_commit(&m_uart_rx_ring, length);
+        }
+        else if (idle)
+        {
+            uart_framing_idle();
+            spsc_ring_read_commit(&m_uart_rx_idle_ring, sizeof(idle_at));
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (m_uart_rx_ring_full)
+    {
+        CRITICAL_REGION_ENTER();
+        if (spsc_ring_free(&m_uart_rx_ring) >= UART_RX_RING_HEADROOM)
+        {
+            m_uart_rx_ring_full = false;
+            uart_rx_pause_update();
+        }
+        CRITICAL_REGION_EXIT();
+    }
+}
+
+
+/**@brief Key the session for records sent with the stored key and received with a zero key, as
+ *        before the first key exchange. The CTR and CCM keys are forgotten.
+ */
+static void session_keys_reset(void)
+{
+    static const uint8_t no_secret[CRYPTO_SESSION_KEY_SIZE] = {0};
+    ret_code_t           err_code;
+
+    crypto_session_clear();
+
+    err_code = crypto_session_key_set(CRYPTO_SESSION_TX, m_key);
+    APP_ERROR_CHECK(err_code);
+    err_code = crypto_session_key_set(CRYPTO_SESSION_RX, no_secret);
+    APP_ERROR_CHECK(err_code);
+}
+
+/**@brief End the session after a disconnect, so the next connection starts with a new key
+ *        exchange and a fresh key pair.
+ */
+static void session_end(void)
+{
+    m_session_end_pending = false;
+
+    // The job is dropped without its handler.
+    key_exchange_session_end();
+    records_release();
+    session_keys_reset();
+
+    m_key_exchange_sent = false;
+    ble_rx_session_reset();
+
+    // Printed here rather than from the disconnect event, which runs in the SoftDevice handler.
+    ble_tx_queue_stats_print();
+}
+
 /**@brief Function for handling the idle state (main loop).
  *
  * @details Sleep until the next event occurs.
  */
 static void idle_state_handle(void)
 {
-    // Simplified idle state - just wait for events
-    sd_app_evt_wait();
+    bool work_left;
+
+    if (m_session_end_pending)
+    {
+        session_end();
+    }
+
+    uart_rx_ring_process();
+    app_sched_execute();
+    uart_dma_process();
+    if (!m_records_held)
+    {
+        // A coalesced record waits for the session keys as well.
+        ble_coalesce_process();
+    }
+    key_exchange_process();
+    crypto_session_keystream_fill();
+
+    // Key pairs for the next sessions are generated while advertising, one per pass.
+    work_left = key_exchange_is_busy();
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        work_left |= key_exchange_pool_fill((key_exchange_curve_t)flash_mgr_get_curve());
+    }
+
+    // Deferred log entries are written out one per pass.
+    work_left |= NRF_LOG_PROCESS();
+
+    // Simplified idle state - just wait for events, unless there is work left
+    if (!work_left)
+    {
+        sd_app_evt_wait();
+    }
 }
 
 
@@ -678,7 +974,7 @@ static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
             break;
         case BLE_ADV_EVT_IDLE:
             // Simplified - just restart advertising without sleep mode
-            printf("Advertising timeout, restarting...\r\n");
+            NRF_LOG_INFO("on_adv_evt, advertising timeout, restarting.");
             err_code = ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST);
             APP_ERROR_CHECK(err_code);
             break;
@@ -700,25 +996,30 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
-            printf("Connected\r\n");
+            NRF_LOG_INFO("ble_evt_handler, connected.");
             err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
             APP_ERROR_CHECK(err_code);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
             err_code = nrf_ble_qwr_conn_handle_assign(&m_qwr, m_conn_handle);
             APP_ERROR_CHECK(err_code);
-            printf("+CONNECTED\r\n");
+            m_at_command_mode = false;
+            // The cipher may have been changed over AT commands.
+            ble_payload_len_update();
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
-            printf("Disconnected\r\n");
+            NRF_LOG_INFO("ble_evt_handler, disconnected.");
             // LED indication will be changed when advertising starts.
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
-            printf("+DISCONNECTED\r\n");
+            ble_coalesce_reset();
+            ble_tx_queue_reset(&m_ble_tx_queue);
+            m_at_command_mode = true;
+            m_session_end_pending = true;
             break;
 
         case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
         {
-            printf("PHY update request.\r\n");
+            NRF_LOG_DEBUG("ble_evt_handler, PHY update request.");
             ble_gap_phys_t const phys =
             {
                 .rx_phys = BLE_GAP_PHY_2MBPS,
@@ -734,6 +1035,10 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
             APP_ERROR_CHECK(err_code);
             break;
 
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            ble_tx_queue_tx_complete(&m_ble_tx_queue, p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+            break;
+
         case BLE_GATTS_EVT_SYS_ATTR_MISSING:
             // No system attributes have been stored.
             err_code = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0, 0);
@@ -793,9 +1098,10 @@ void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t const * p_evt)
     if ((m_conn_handle == p_evt->conn_handle) && (p_evt->evt_id == NRF_BLE_GATT_EVT_ATT_MTU_UPDATED))
     {
         m_ble_nus_max_data_len = p_evt->params.att_mtu_effective - OPCODE_LENGTH - HANDLE_LENGTH;
-        printf("Data len is set to 0x%X(%d)\r\n", m_ble_nus_max_data_len, m_ble_nus_max_data_len);
+        NRF_LOG_INFO("gatt_evt_handler, data len is set to %d.", m_ble_nus_max_data_len);
+        ble_payload_len_update();
     }
-    printf("ATT MTU exchange completed. central 0x%x peripheral 0x%x\r\n",
+    NRF_LOG_DEBUG("gatt_evt_handler, ATT MTU exchange completed. central %d, peripheral %d.",
                   p_gatt->att_mtu_desired_central,
                   p_gatt->att_mtu_desired_periph);
 }
@@ -852,87 +1158,155 @@ void bsp_event_handler(bsp_event_t event)
 }
 
 
-/**@brief   Function for handling app_uart events.
+/**@brief   Function for passing a frame received over UART to the AT command parser.
  *
- * @details This function will receive a single character from the app_uart module and append it to
- *          a string. The string will be be sent over BLE when the last character received was a
- *          'new line' '\n' (hex 0x0A) or if the string has reached the maximum data length.
+ * @details The parser expects a null terminated string, so the command is copied and any line
+ *          ending is removed.
  */
-/**@snippet [Handling the data received over UART] */
-void uart_event_handle(app_uart_evt_t * p_event)
+static void at_command_handle(uint8_t const * p_frame, size_t length)
+{
+    char command[AT_COMMAND_MAX_LEN + 1];
+
+    if (length > AT_COMMAND_MAX_LEN)
+    {
+        printf("ERROR\r\n");
+        return;
+    }
+
+    memcpy(command, p_frame, length);
+    for (; (length > 0) && ((command[length - 1] == '\r') || (command[length - 1] == '\n')); length--);
+    command[length] = '\0';
+
+    UNUSED_RETURN_VALUE(at_command_parse(command, length));
+}
+
+
+/**@brief   Function for handling a complete frame received over UART.
+ *
+ * @details The first frame starts the key exchange, every following frame is encrypted and sent
+ *          over BLE.
+ *
+ * @param[in] p_frame  Frame data, without the trailer, in a frame pool block that is handed on or
+ *                     freed. Frames that are not coalesced are encrypted in place.
+ * @param[in] length   Frame length.
+ */
+static void uart_frame_handle(uint8_t * p_frame, size_t length)
 {
-    static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
-    static int index = 0;
-    static bool key_exchanged = false;
-    uint32_t       err_code;
+    uint32_t err_code;
+
+    if (length == 0)
+    {
+        frame_pool_free(p_frame);
+        return;
+    }
+
+    if (m_at_command_mode)
+    {
+        at_command_handle(p_frame, length);
+        frame_pool_free(p_frame);
+        return;
+    }
 
-    switch (p_event->evt_type)
+    if (!m_key_exchange_sent)
     {
-        case APP_UART_DATA_READY:
-            UNUSED_VARIABLE(app_uart_get(&data_array[index]));
-            index++;
-
-            if (((index > 3) && 
-                 (data_array[index - 3] == 0xA5) && 
-                 (data_array[index - 2] == 0xA6) && 
-                 (data_array[index - 1] == 0xA7)) ||
-                (index >= m_ble_nus_max_data_len))
+        // Start the key exchange first, in the block of the frame that started it
+        err_code = key_exchange_request_send(p_frame, flash_mgr_get_psk_mode());
+        if (err_code != NRF_SUCCESS)
+        {
+            printf("Key exchange request dropped\r\n");
+        }
+
+        m_key_exchange_sent = true;
+    }
+    else
+    {
+        // Encrypt and send data
+        if (ble_rx_records_tagged())
+        {
+            err_code = ble_coalesce_put(p_frame, length);
+            frame_pool_free(p_frame);
+            if (err_code != NRF_SUCCESS)
             {
-                if (index > 3)
-                {
-                    if (!key_exchanged)
-                    {
-                        // Send our public key first
-                        uint8_t key_exchange[66]; // 2 bytes type + 64 bytes public key
-                        key_exchange[0] = 0x00;
-                        key_exchange[1] = MSG_TYPE_KEY_EXCHANGE_REQ;
-                        memcpy(key_exchange + 2, m_raw_public_key, sizeof(m_raw_public_key));
-                        
-                        uint16_t length = sizeof(key_exchange);
-                        do
-                        {
-                            err_code = ble_nus_data_send(&m_nus, key_exchange, &length, m_conn_handle);
-                            if ((err_code != NRF_ERROR_INVALID_STATE) &&
-                                (err_code != NRF_ERROR_RESOURCES) &&
-                                (err_code != NRF_ERROR_NOT_FOUND))
-                            {
-                                APP_ERROR_CHECK(err_code);
-                            }
-                        } while (err_code == NRF_ERROR_RESOURCES);
-                        
-                        key_exchanged = true;
-                    }
-                    else
-                    {
-                        // Encrypt and send data
-                        err_code = encrypt_data(data_array, index-3); 
-                        APP_ERROR_CHECK(err_code);
-
-                        do
-                        {
-                            uint16_t length = (uint16_t)encrypted_data_len;
-                            err_code = ble_nus_data_send(&m_nus, encrypted_data, &length, m_conn_handle);
-                            if ((err_code != NRF_ERROR_INVALID_STATE) &&
-                                (err_code != NRF_ERROR_RESOURCES) &&
-                                (err_code != NRF_ERROR_NOT_FOUND))
-                            {
-                                APP_ERROR_CHECK(err_code);
-                            }
-                        } while (err_code == NRF_ERROR_RESOURCES);
-                    }
-                }
+                printf("Frame not coalesced. Error 0x%x.\r\n", (unsigned int)err_code);
+            }
+        }
+        else
+        {
+            ble_record_send(p_frame, length, FRAME_POOL_BLOCK_SIZE);
+        }
+    }
+}
+
+
+/**@brief   Function for processing a frame received over UART, in the main loop. */
+static void uart_rx_process(uint8_t * p_frame, size_t length)
+{
+    uart_frame_handle(p_frame, length);
+
+    CRITICAL_REGION_ENTER();
+    flow_ctrl_remove(&m_uart_rx_flow, 1);
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief   Function for queuing a frame received over UART.
+ *
+ * @details Runs in the main loop, from @ref uart_rx_ring_process. The frame is copied to the
+ *          pipeline, it is encrypted and sent by @ref uart_rx_process.
+ */
+static void uart_frame_queue(uint8_t const * p_frame, size_t length)
+{
+    ret_code_t err_code = pipeline_put(PIPELINE_STAGE_UART_RX, p_frame, length);
+    if (err_code != NRF_SUCCESS)
+    {
+        printf("UART frame dropped. Error 0x%x.\r\n", err_code);
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    flow_ctrl_add(&m_uart_rx_flow, 1);
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief   Function for handling UART DMA events.
+ *
+ * @details Received bytes arrive a chunk at a time in the UART interrupt. They are only copied to
+ *          @ref m_uart_rx_ring, without masking interrupts, and split into frames according to the
+ *          selected data mode by @ref uart_rx_ring_process, see @ref uart_framing_mode_t.
+ */
+/**@snippet [Handling the data received over UART] */
+void uart_event_handle(uart_dma_evt_t const * p_event)
+{
+    switch (p_event->type)
+    {
+        case UART_DMA_EVT_RX_DATA:
+        {
+            size_t written = spsc_ring_write(&m_uart_rx_ring, p_event->data.rx.p_data, p_event->data.rx.length);
+            if (written < p_event->data.rx.length)
+            {
+                m_uart_rx_ring_dropped += p_event->data.rx.length - written;
+                NRF_LOG_WARNING("uart_event_handle, UART bytes dropped: %u.", m_uart_rx_ring_dropped);
+            }
 
-                memset(data_array, 0, sizeof(data_array));
-                index = 0;
+            if (!m_uart_rx_ring_full && (spsc_ring_free(&m_uart_rx_ring) < UART_RX_RING_HEADROOM))
+            {
+                m_uart_rx_ring_full = true;
+                uart_rx_pause_update();
             }
-            break;
+        } break;
 
-        case APP_UART_COMMUNICATION_ERROR:
-            APP_ERROR_HANDLER(p_event->data.error_communication);
-            break;
+        case UART_DMA_EVT_RX_IDLE:
+        {
+            uint32_t idle_at = m_uart_rx_ring.write;
+
+            // With every slot taken the gap is lost and the bytes run into the next frame.
+            UNUSED_RETURN_VALUE(spsc_ring_write(&m_uart_rx_idle_ring, (uint8_t const *)&idle_at, sizeof(idle_at)));
+        } break;
 
-        case APP_UART_FIFO_ERROR:
-            APP_ERROR_HANDLER(p_event->data.error_code);
+        case UART_DMA_EVT_COMM_ERROR:
+            // The UARTE restarts reception by itself, only the corrupted bytes are lost.
+            NRF_LOG_WARNING("uart_event_handle, UART communication error: 0x%x.", p_event->data.error_mask);
             break;
 
         default:
@@ -947,28 +1321,40 @@ void uart_event_handle(app_uart_evt_t * p_event)
 /**@snippet [UART Initialization] */
 static void uart_init(void)
 {
-    uint32_t                     err_code;
-    app_uart_comm_params_t const comm_params =
+    uint32_t          err_code;
+    uart_dma_config_t comm_params =
     {
         .rx_pin_no    = 12,
         .tx_pin_no    = 16,
         .rts_pin_no   = RTS_PIN_NUMBER,
         .cts_pin_no   = CTS_PIN_NUMBER,
-        .flow_control = APP_UART_FLOW_CONTROL_DISABLED,
-        .use_parity   = false,
-#if defined (UART_PRESENT)
-        .baud_rate    = NRF_UARTE_BAUDRATE_115200
-#else
-        .baud_rate    = NRF_UARTE_BAUDRATE_115200
-#endif
+        .flow_control = UART_FLOW_CONTROL,
+        .use_parity   = (flash_mgr_get_uart_parity() == UART_PARITY_EVEN),
+        .baud_rate    = NRF_UARTE_BAUDRATE_115200,
+        .irq_priority = APP_IRQ_PRIORITY_LOWEST
     };
 
-    APP_UART_FIFO_INIT(&comm_params,
-                       UART_RX_BUF_SIZE,
-                       UART_TX_BUF_SIZE,
-                       uart_event_handle,
-                       APP_IRQ_PRIORITY_LOWEST,
-                       err_code);
+    // Fall back to 115200 if the stored baud rate is not supported.
+    UNUSED_RETURN_VALUE(uart_dma_baud_rate_get(flash_mgr_get_uart_baud_rate(), &comm_params.baud_rate));
+
+    uart_framing_init((uart_framing_mode_t)flash_mgr_get_data_mode(), m_ble_nus_max_data_len, uart_frame_queue);
+    flow_ctrl_init(&m_ble_tx_flow, BLE_TX_HIGH_WATERMARK, BLE_TX_LOW_WATERMARK, uart_rx_flow_handler, NULL);
+    flow_ctrl_init(&m_uart_rx_flow, UART_RX_HIGH_WATERMARK, UART_RX_LOW_WATERMARK, uart_rx_flow_handler, NULL);
+    ble_tx_queue_init(&m_ble_tx_queue, ble_nus_send, &m_nus, &m_ble_tx_flow);
+    pipeline_stage_init(PIPELINE_STAGE_UART_RX, uart_rx_process);
+
+    err_code = ble_coalesce_init(ble_record_send, ble_tx_busy);
+    APP_ERROR_CHECK(err_code);
+
+    // Keep sending every frame on its own if the stored policy is not valid.
+    UNUSED_RETURN_VALUE(ble_coalesce_policy_set((ble_coalesce_policy_t)flash_mgr_get_coalesce_policy(),
+                                                flash_mgr_get_coalesce_delay_ms()));
+    ble_payload_len_update();
+
+    err_code = uart_dma_init(&comm_params, uart_event_handle);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = uart_dma_rx_timeout_set(flash_mgr_get_idle_gap_ms());
     APP_ERROR_CHECK(err_code);
 }
 /**@snippet [UART Initialization] */
@@ -1020,11 +1406,27 @@ static void buttons_leds_init(bool * p_erase_bonds)
 }
 
 
+/**@brief Function for initializing the event scheduler, which runs the pipeline stages in the
+ *        main loop.
+ */
+static void scheduler_init(void)
+{
+    APP_SCHED_INIT(PIPELINE_SCHED_EVENT_SIZE, PIPELINE_SCHED_QUEUE_SIZE);
+
+    ble_rx_init(&m_ble_rx_ops);
+    pipeline_stage_init(PIPELINE_STAGE_BLE_RX, ble_rx_process);
+}
+
+
 /**@brief Function for initializing the nrf log module.
  */
 static void log_init(void)
 {
-    // No initialization needed for printf
+    // printf is kept for the main loop, interrupt handlers log through the deferred NRF_LOG.
+    ret_code_t err_code = NRF_LOG_INIT(NULL);
+    APP_ERROR_CHECK(err_code);
+
+    NRF_LOG_DEFAULT_BACKENDS_INIT();
 }
 
 
@@ -1071,9 +1473,9 @@ int main(void)
     ret_code_t ret;
 
     // Initialize.
-    uart_init();
-    log_init();
     timers_init();
+    scheduler_init();
+    log_init();
    
     ret = nrf_crypto_init();
     APP_ERROR_CHECK(ret);
@@ -1082,8 +1484,15 @@ int main(void)
 
     flash_storage_init();
     flash_mgr_flash_mgr_init();    
+    resume_cache_init();
+
+    // Keep CBC if the stored cipher is not valid. CTR is only keyed by a key exchange.
+    UNUSED_RETURN_VALUE(crypto_session_cipher_set((crypto_session_cipher_t)flash_mgr_get_cipher()));
+
+    // The UART settings are stored in flash.
+    uart_init();
 
-    char * device_name = flash_mgr_get_device_name();
+    const char * device_name = flash_mgr_get_device_name();
     const uint8_t * key = flash_mgr_get_encryption_key();
     memcpy(m_key, key, sizeof(m_key));
         
@@ -1095,11 +1504,15 @@ int main(void)
     
     conn_params_init();
 
-    // Initialize ECDH
-    ret = ecdh_init();
-    APP_ERROR_CHECK(ret);
-    
-    crypt_init();    
+#if CRYPTO_BENCH_ENABLED
+    // After the SoftDevice is enabled, the record ciphers use the ECB peripheral through it.
+    crypto_bench_run();
+#endif
+
+    // Records are sent with the stored key and received with the shared secret, which stays zero
+    // until the first key exchange. The ECDH key pairs are generated in the main loop while
+    // advertising.
+    session_keys_reset();
     advertising_start();
 
     // Enter main loop.
@@ -0,0 +1,178 @@
+#include "aes_ctr.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+
+#if !AES_CTR_ECB
+
+/* Portable AES-128 encryption, FIPS-197. Only the forward cipher is needed for CTR mode. Small
+ * rather than fast: a single S-box table, no T-tables. */
+
+static const uint8_t m_sbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t xtime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static void key_expand(uint8_t round_keys[11][AES_CTR_BLOCK_SIZE], uint8_t const * p_raw_key)
+{
+    uint8_t rcon = 0x01;
+
+    memcpy(round_keys[0], p_raw_key, AES_CTR_KEY_SIZE);
+
+    for (uint32_t round = 1; round <= 10; round++)
+    {
+        uint8_t const * p_prev = round_keys[round - 1];
+        uint8_t *       p_next = round_keys[round];
+
+        p_next[0] = p_prev[0] ^ m_sbox[p_prev[13]] ^ rcon;
+        p_next[1] = p_prev[1] ^ m_sbox[p_prev[14]];
+        p_next[2] = p_prev[2] ^ m_sbox[p_prev[15]];
+        p_next[3] = p_prev[3] ^ m_sbox[p_prev[12]];
+
+        for (uint32_t i = 4; i < AES_CTR_BLOCK_SIZE; i++)
+        {
+            p_next[i] = p_prev[i] ^ p_next[i - 4];
+        }
+
+        rcon = xtime(rcon);
+    }
+}
+
+static void block_encrypt(uint8_t const round_keys[11][AES_CTR_BLOCK_SIZE], uint8_t const * p_in, uint8_t * p_out)
+{
+    uint8_t s[AES_CTR_BLOCK_SIZE];
+    uint8_t t[AES_CTR_BLOCK_SIZE];
+
+    for (uint32_t i = 0; i < AES_CTR_BLOCK_SIZE; i++)
+    {
+        s[i] = p_in[i] ^ round_keys[0][i];
+    }
+
+    for (uint32_t round = 1; round <= 10; round++)
+    {
+        // SubBytes and ShiftRows. The state is column major, byte i is row i % 4 of column i / 4.
+        for (uint32_t i = 0; i < AES_CTR_BLOCK_SIZE; i++)
+        {
+            t[i] = m_sbox[s[(i + 4 * (i % 4)) % AES_CTR_BLOCK_SIZE]];
+        }
+
+        // MixColumns, skipped in the last round.
+        for (uint32_t c = 0; c < AES_CTR_BLOCK_SIZE; c += 4)
+        {
+            if (round == 10)
+            {
+                memcpy(&s[c], &t[c], 4);
+                continue;
+            }
+
+            uint8_t all = t[c] ^ t[c + 1] ^ t[c + 2] ^ t[c + 3];
+
+            s[c]     = t[c]     ^ all ^ xtime(t[c]     ^ t[c + 1]);
+            s[c + 1] = t[c + 1] ^ all ^ xtime(t[c + 1] ^ t[c + 2]);
+            s[c + 2] = t[c + 2] ^ all ^ xtime(t[c + 2] ^ t[c + 3]);
+            s[c + 3] = t[c + 3] ^ all ^ xtime(t[c + 3] ^ t[c]);
+        }
+
+        for (uint32_t i = 0; i < AES_CTR_BLOCK_SIZE; i++)
+        {
+            s[i] ^= round_keys[round][i];
+        }
+    }
+
+    memcpy(p_out, s, AES_CTR_BLOCK_SIZE);
+}
+
+#endif // !AES_CTR_ECB
+
+void aes_ctr_key_set(aes_ctr_key_t * p_key, uint8_t const * p_raw_key)
+{
+#if AES_CTR_ECB
+    memcpy(p_key->ecb.key, p_raw_key, AES_CTR_KEY_SIZE);
+#else
+    key_expand(p_key->round_keys, p_raw_key);
+#endif
+}
+
+void aes_ctr_key_clear(aes_ctr_key_t * p_key)
+{
+    memset(p_key, 0, sizeof(*p_key));
+}
+
+ret_code_t aes_ctr_block_encrypt(aes_ctr_key_t * p_key, uint8_t const * p_in, uint8_t * p_out)
+{
+#if AES_CTR_ECB
+    memcpy(p_key->ecb.cleartext, p_in, AES_CTR_BLOCK_SIZE);
+
+    ret_code_t err_code = sd_ecb_block_encrypt(&p_key->ecb);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    memcpy(p_out, p_key->ecb.ciphertext, AES_CTR_BLOCK_SIZE);
+#else
+    block_encrypt(p_key->round_keys, p_in, p_out);
+#endif
+
+    return NRF_SUCCESS;
+}
+
+void aes_ctr_counter_inc(uint8_t * p_counter)
+{
+    for (int32_t i = AES_CTR_BLOCK_SIZE - 1; i >= AES_CTR_BLOCK_SIZE - 4; i--)
+    {
+        if (++p_counter[i] != 0)
+        {
+            break;
+        }
+    }
+}
+
+ret_code_t aes_ctr_crypt(aes_ctr_key_t * p_key, uint8_t * p_counter, uint8_t * p_data, size_t length)
+{
+    uint8_t keystream[AES_CTR_BLOCK_SIZE];
+
+    while (length > 0)
+    {
+        ret_code_t err_code = aes_ctr_block_encrypt(p_key, p_counter, keystream);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        aes_ctr_counter_inc(p_counter);
+
+        size_t block_len = MIN(length, AES_CTR_BLOCK_SIZE);
+        for (size_t i = 0; i < block_len; i++)
+        {
+            p_data[i] ^= keystream[i];
+        }
+
+        p_data += block_len;
+        length -= block_len;
+    }
+
+    memset(keystream, 0, sizeof(keystream));
+
+    return NRF_SUCCESS;
+}
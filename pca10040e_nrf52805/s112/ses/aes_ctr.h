@@ -0,0 +1,61 @@
+#ifndef AES_CTR_H
+#define AES_CTR_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+#define AES_CTR_KEY_SIZE    16      /**< AES-128, the only key size of the ECB peripheral. */
+#define AES_CTR_BLOCK_SIZE  16
+
+/* The block cipher runs on the ECB peripheral through the SoftDevice, or in software where there
+ * is no SoftDevice, for example on a host. Define AES_CTR_SOFTWARE to force the software cipher. */
+#if defined(SOFTDEVICE_PRESENT) && !defined(AES_CTR_SOFTWARE)
+#define AES_CTR_ECB         1
+#include "nrf_soc.h"
+#else
+#define AES_CTR_ECB         0
+#endif
+
+/**@brief Expanded key. */
+typedef struct
+{
+#if AES_CTR_ECB
+    nrf_ecb_hal_data_t ecb;         /**< Key, and the block being encrypted by the peripheral. */
+#else
+    uint8_t            round_keys[11][AES_CTR_BLOCK_SIZE];
+#endif
+} aes_ctr_key_t;
+
+/**@brief Set the key. */
+void aes_ctr_key_set(aes_ctr_key_t * p_key, uint8_t const * p_raw_key);
+
+/**@brief Wipe the key. */
+void aes_ctr_key_clear(aes_ctr_key_t * p_key);
+
+/**@brief Encrypt one block, the keystream for one counter value.
+ *
+ * @details Not reentrant for the same key, the peripheral works on a copy inside @p p_key.
+ *
+ * @retval NRF_SUCCESS  @p p_out holds the encrypted block.
+ * @return Otherwise the error from sd_ecb_block_encrypt.
+ */
+ret_code_t aes_ctr_block_encrypt(aes_ctr_key_t * p_key, uint8_t const * p_in, uint8_t * p_out);
+
+/**@brief Encrypt or decrypt @p length bytes in place, which are the same operation in CTR mode.
+ *
+ * @details The data is XORed with the encrypted counter blocks, so the output is exactly as long
+ *          as the input. The last 32 bits of @p p_counter are a big endian block counter, which is
+ *          incremented for every block used. A partly used last block is thrown away.
+ *
+ * @param[in]     p_key      Key.
+ * @param[in,out] p_counter  @ref AES_CTR_BLOCK_SIZE byte counter block, advanced past the data.
+ * @param[in,out] p_data     Data.
+ * @param[in]     length     Data length.
+ */
+ret_code_t aes_ctr_crypt(aes_ctr_key_t * p_key, uint8_t * p_counter, uint8_t * p_data, size_t length);
+
+/**@brief Increment the 32 bit big endian block counter at the end of a counter block. */
+void aes_ctr_counter_inc(uint8_t * p_counter);
+
+#endif //AES_CTR_H
@@ -1,5 +1,11 @@
 #include "at_command_parser.h"
 #include "flash_manager.h"
+#include "uart_dma.h"
+#include "uart_framing.h"
+#include "pipeline.h"
+#include "ble_coalesce.h"
+#include "crypto_session.h"
+#include "key_exchange.h"
 
 #include "nrf_ble_gatt.h"
 #include "nrf_sdh_ble.h"
@@ -16,6 +22,8 @@
 #define DEVICE_NAME_MAX_LEN 20
 #define CRYPT_KEY_LEN 32
 #define PARAM_LENGTH 10
+#define UART_PARAM_LENGTH 20
+#define IDLE_GAP_MAX_MS 1000
 
 ret_code_t at_command_parse(char * cmd, int len)
 {
@@ -180,7 +188,7 @@ ret_code_t at_command_parse(char * cmd, int len)
         }
         else
         {
-            NRF_LOG_INFO("at_command_parse, unknown parameter: %s", param)
+            NRF_LOG_INFO("at_command_parse, unknown parameter: %s", param);
         }
 
         printf("OK\r\n");
@@ -191,28 +199,47 @@ ret_code_t at_command_parse(char * cmd, int len)
         //Baud rate, Stop bit,Parity
         
         NRF_LOG_INFO("at_command_parse, command: AT+UART?");
-        int baudRate = 115200;
-        int stopBit = 1;
-        int parity = 0;
+        unsigned long baudRate = flash_mgr_get_uart_baud_rate();
+        int stopBit = flash_mgr_get_uart_stop_bits();
+        int parity = flash_mgr_get_uart_parity();
 
         char result[100] = {0};
-        snprintf(result, sizeof(result), "AT+UART:%d,%s,%s\r\n", baudRate, stopBit, parity);
+        snprintf(result, sizeof(result), "AT+UART:%lu,%d,%d\r\n", baudRate, stopBit, parity);
 
         printf(result);
         printf("OK\r\n");
     } 
     else if (strncmp(cmd, "AT+UART=", 8) == 0) 
     {
-        // Extract the new name
-        char param[PARAM_LENGTH] = {0};
+        //AT+UART=<param>,<param2>,<param3>
+        //Baud rate, Stop bit,Parity (0 - none, 1 - odd, 2 - even)
+        char param[UART_PARAM_LENGTH] = {0};
         strncpy(param, cmd + 8, sizeof(param) - 1);
 
-        NRF_LOG_INFO("at_command_parse, command: AT+STOP, param: %s", param);
-        
-        //TODO - 3:adv on ,scan stop, UART stop
-        
+        NRF_LOG_INFO("at_command_parse, command: AT+UART, param: %s", param);
+
+        unsigned long baudRate;
+        unsigned int stopBit;
+        unsigned int parity;
+        nrf_uarte_baudrate_t baud_rate;
+
+        // The UARTE only supports one stop bit and even parity.
+        if ((sscanf(param, "%lu,%u,%u", &baudRate, &stopBit, &parity) != 3) ||
+            (uart_dma_baud_rate_get(baudRate, &baud_rate) != NRF_SUCCESS) ||
+            (stopBit != 1) ||
+            ((parity != UART_PARITY_NONE) && (parity != UART_PARITY_EVEN)))
+        {
+            NRF_LOG_INFO("at_command_parse, unsupported UART settings: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        flash_mgr_set_uart_config(baudRate, stopBit, parity);
 
+        // Answer before switching, the new settings take effect once the reply has been sent.
         printf("OK\r\n");
+
+        uart_dma_line_config_set(baud_rate, parity == UART_PARITY_EVEN);
     } 
     else if (strncmp(cmd, "AT+DEFAULT", 10) == 0) 
     {
@@ -222,12 +249,234 @@ ret_code_t at_command_parse(char * cmd, int len)
     } 
     else if (strncmp(cmd, "AT+DATAMODE=", 12) == 0) 
     {
-        NRF_LOG_INFO("at_command_parse, command: AT+DATAMODE");
+        //AT+DATAMODE=<mode>[,<idle gap ms>]
+        //0 - frames end with 0xA5 0xA6 0xA7, 1 - transparent, frames end when the line goes idle
+        //2 - 16 bit big endian length before every frame, 3 - COBS, frames end with 0x00
+        char param[PARAM_LENGTH] = {0};
+        strncpy(param, cmd + 12, sizeof(param) - 1);
 
-        //TODO - implement
+        NRF_LOG_INFO("at_command_parse, command: AT+DATAMODE, param: %s", param);
+
+        unsigned int mode;
+        unsigned int idleGap = flash_mgr_get_idle_gap_ms();
+
+        int count = sscanf(param, "%u,%u", &mode, &idleGap);
+        if ((count < 1) ||
+            (mode >= UART_FRAMING_MODE_COUNT) ||
+            (idleGap == 0) || (idleGap > IDLE_GAP_MAX_MS))
+        {
+            NRF_LOG_INFO("at_command_parse, invalid data mode: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        flash_mgr_set_data_mode(mode, idleGap);
+
+        uart_framing_mode_set((uart_framing_mode_t)mode);
+        uart_dma_rx_timeout_set(idleGap);
+        
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+DATAMODE?", 12) == 0) 
+    {
+        NRF_LOG_INFO("at_command_parse, command: AT+DATAMODE?");
+
+        char result[100] = {0};
+        snprintf(result, sizeof(result), "AT+DATAMODE:%d,%d\r\n", flash_mgr_get_data_mode(), flash_mgr_get_idle_gap_ms());
+
+        printf(result);
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+COALESCE=", 12) == 0) 
+    {
+        //AT+COALESCE=<policy>[,<delay ms>]
+        //0 - off, every frame is its own notification, 1 - latency first, 2 - throughput first
+        char param[PARAM_LENGTH] = {0};
+        strncpy(param, cmd + 12, sizeof(param) - 1);
+
+        NRF_LOG_INFO("at_command_parse, command: AT+COALESCE, param: %s", param);
+
+        unsigned int policy;
+        unsigned int delay = flash_mgr_get_coalesce_delay_ms();
+
+        int count = sscanf(param, "%u,%u", &policy, &delay);
+        if ((count < 1) ||
+            (ble_coalesce_policy_set((ble_coalesce_policy_t)policy, delay) != NRF_SUCCESS))
+        {
+            NRF_LOG_INFO("at_command_parse, invalid coalesce policy: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        flash_mgr_set_coalesce(policy, delay);
+        
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+COALESCE?", 12) == 0) 
+    {
+        NRF_LOG_INFO("at_command_parse, command: AT+COALESCE?");
+
+        char result[100] = {0};
+        snprintf(result, sizeof(result), "AT+COALESCE:%d,%d\r\n", flash_mgr_get_coalesce_policy(), flash_mgr_get_coalesce_delay_ms());
+
+        printf(result);
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+CIPHER=", 10) == 0) 
+    {
+        //AT+CIPHER=<cipher>
+        //0 - AES-256-CBC, 1 - AES-128-CTR, 2 - AES-128-CCM, the last two only after a key exchange.
+        //The central must use the same.
+        char param[PARAM_LENGTH] = {0};
+        strncpy(param, cmd + 10, sizeof(param) - 1);
+
+        NRF_LOG_INFO("at_command_parse, command: AT+CIPHER, param: %s", param);
+
+        unsigned int cipher;
+
+        int count = sscanf(param, "%u", &cipher);
+        if ((count < 1) ||
+            (crypto_session_cipher_set((crypto_session_cipher_t)cipher) != NRF_SUCCESS))
+        {
+            NRF_LOG_INFO("at_command_parse, invalid cipher: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        flash_mgr_set_cipher(cipher);
         
         printf("OK\r\n");
     } 
+    else if (strncmp(cmd, "AT+CIPHER?", 10) == 0) 
+    {
+        NRF_LOG_INFO("at_command_parse, command: AT+CIPHER?");
+
+        char result[100] = {0};
+        snprintf(result, sizeof(result), "AT+CIPHER:%d\r\n", flash_mgr_get_cipher());
+
+        printf(result);
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+PSK=", 7) == 0) 
+    {
+        //AT+PSK=<mode>
+        //0 - sessions start with an ECDH key exchange, 1 - with the pre-shared key handshake, using
+        //the key of AT+CRYPTKEY. Taken over on the next connection.
+        char param[PARAM_LENGTH] = {0};
+        strncpy(param, cmd + 7, sizeof(param) - 1);
+
+        NRF_LOG_INFO("at_command_parse, command: AT+PSK, param: %s", param);
+
+        unsigned int psk_mode;
+
+        int count = sscanf(param, "%u", &psk_mode);
+        if ((count < 1) ||
+            (flash_mgr_set_psk_mode(psk_mode) != NRF_SUCCESS))
+        {
+            NRF_LOG_INFO("at_command_parse, invalid psk mode: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+PSK?", 7) == 0) 
+    {
+        NRF_LOG_INFO("at_command_parse, command: AT+PSK?");
+
+        char result[100] = {0};
+        snprintf(result, sizeof(result), "AT+PSK:%d\r\n", flash_mgr_get_psk_mode());
+
+        printf(result);
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+CURVE=", 9) == 0) 
+    {
+        //AT+CURVE=<curve>
+        //0 - secp256r1, 1 - X25519. Curve of the key exchanges this device starts, a request of the
+        //peer is answered on its own curve. Taken over on the next connection.
+        char param[PARAM_LENGTH] = {0};
+        strncpy(param, cmd + 9, sizeof(param) - 1);
+
+        NRF_LOG_INFO("at_command_parse, command: AT+CURVE, param: %s", param);
+
+        unsigned int curve;
+
+        int count = sscanf(param, "%u", &curve);
+        if ((count < 1) ||
+            (curve > UINT8_MAX) ||
+            (flash_mgr_set_curve(curve) != NRF_SUCCESS))
+        {
+            NRF_LOG_INFO("at_command_parse, invalid curve: %s", param);
+            printf("ERROR\r\n");
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+CURVE?", 9) == 0) 
+    {
+        NRF_LOG_INFO("at_command_parse, command: AT+CURVE?");
+
+        char result[100] = {0};
+        snprintf(result, sizeof(result), "AT+CURVE:%d\r\n", flash_mgr_get_curve());
+
+        printf(result);
+        printf("OK\r\n");
+    } 
+    else if (strncmp(cmd, "AT+STATS?", 9) == 0) 
+    {
+        //AT+STATS:<stage>,<depth>,<max depth>,<processed>,<dropped>,<last latency us>,<max latency us>
+        //AT+POOL:<blocks in use>,<max blocks in use>,<failed allocations>
+        //AT+KEYSTREAM:<CTR blocks from precomputed keystream>,<CTR blocks computed on demand>
+        //AT+AUTH:<CCM records dropped on a tag mismatch>,<received records skipped over as lost>
+        //AT+KEX:<key exchanges>,<failed>,<last latency us>,<max latency us>,<longest step us>
+        //AT+KEYPOOL:<sessions with a key pair generated ahead>,<sessions that generated their own>
+        //AT+RESUME:<resumed sessions>,<refused>,<last latency us>,<max latency us>
+        //AT+PSKHS:<pre-shared key handshakes>,<last latency us>,<max latency us>
+        NRF_LOG_INFO("at_command_parse, command: AT+STATS?");
+
+        for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++)
+        {
+            pipeline_stats_t stats;
+            pipeline_stats_get((pipeline_stage_t)stage, &stats);
+
+            printf("AT+STATS:%d,%d,%d,%lu,%lu,%lu,%lu\r\n",
+                   stage, stats.depth, stats.depth_max,
+                   (unsigned long)stats.processed, (unsigned long)stats.dropped,
+                   (unsigned long)stats.latency_last_us, (unsigned long)stats.latency_max_us);
+        }
+
+        frame_pool_stats_t pool_stats;
+        frame_pool_stats_get(&pool_stats);
+
+        printf("AT+POOL:%d,%d,%lu\r\n",
+               pool_stats.in_use, pool_stats.in_use_max, (unsigned long)pool_stats.alloc_failed);
+
+        crypto_session_stats_t crypto_stats;
+        crypto_session_stats_get(&crypto_stats);
+
+        printf("AT+KEYSTREAM:%lu,%lu\r\n",
+               (unsigned long)crypto_stats.keystream_hits, (unsigned long)crypto_stats.keystream_misses);
+        printf("AT+AUTH:%lu,%lu\r\n", (unsigned long)crypto_stats.auth_failed, (unsigned long)crypto_stats.records_skipped);
+
+        key_exchange_stats_t kex_stats;
+        key_exchange_stats_get(&kex_stats);
+
+        printf("AT+KEX:%lu,%lu,%lu,%lu,%lu\r\n",
+               (unsigned long)kex_stats.completed, (unsigned long)kex_stats.failed,
+               (unsigned long)kex_stats.latency_last_us, (unsigned long)kex_stats.latency_max_us,
+               (unsigned long)kex_stats.step_max_us);
+        printf("AT+KEYPOOL:%lu,%lu\r\n",
+               (unsigned long)kex_stats.pool_hits, (unsigned long)kex_stats.pool_misses);
+        printf("AT+RESUME:%lu,%lu,%lu,%lu\r\n",
+               (unsigned long)kex_stats.resumed, (unsigned long)kex_stats.resume_misses,
+               (unsigned long)kex_stats.resume_last_us, (unsigned long)kex_stats.resume_max_us);
+        printf("AT+PSKHS:%lu,%lu,%lu\r\n",
+               (unsigned long)kex_stats.psk, (unsigned long)kex_stats.psk_last_us,
+               (unsigned long)kex_stats.psk_max_us);
+        printf("OK\r\n");
+    } 
     else 
     {
         NRF_LOG_ERROR("at_command_parse, unknown command: %s", cmd);
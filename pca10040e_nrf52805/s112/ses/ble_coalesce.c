@@ -0,0 +1,203 @@
+#include "ble_coalesce.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "app_timer.h"
+#include "frame_pool.h"
+
+APP_TIMER_DEF(m_delay_timer);
+
+static ble_coalesce_flush_t  m_flush;
+static ble_coalesce_busy_t   m_busy;
+static ble_coalesce_policy_t m_policy   = BLE_COALESCE_OFF;
+static uint16_t              m_delay_ms = BLE_COALESCE_DELAY_MS;
+static uint16_t              m_capacity = BLE_COALESCE_BUF_SIZE;
+static volatile bool         m_flush_due;   /**< Set by the timer, the record is sent in the main loop. */
+
+static uint8_t * mp_buf;    /**< Pool block holding the record being filled, [length][frame] pairs. */
+static uint16_t  m_len;
+
+STATIC_ASSERT(BLE_COALESCE_BUF_SIZE <= FRAME_POOL_BLOCK_SIZE);
+
+static void delay_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    m_flush_due = true;
+}
+
+ret_code_t ble_coalesce_init(ble_coalesce_flush_t flush, ble_coalesce_busy_t busy)
+{
+    m_flush = flush;
+    m_busy  = busy;
+    mp_buf  = NULL;
+    m_len   = 0;
+
+    return app_timer_create(&m_delay_timer, APP_TIMER_MODE_SINGLE_SHOT, delay_timeout_handler);
+}
+
+ret_code_t ble_coalesce_policy_set(ble_coalesce_policy_t policy, uint16_t delay_ms)
+{
+    if ((policy >= BLE_COALESCE_POLICY_COUNT) ||
+        (delay_ms == 0) || (delay_ms > BLE_COALESCE_DELAY_MAX_MS))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    ble_coalesce_flush();
+
+    m_policy   = policy;
+    m_delay_ms = delay_ms;
+
+    return NRF_SUCCESS;
+}
+
+ble_coalesce_policy_t ble_coalesce_policy_get(void)
+{
+    return m_policy;
+}
+
+void ble_coalesce_capacity_set(uint16_t capacity)
+{
+    ble_coalesce_flush();
+
+    m_capacity = MIN(capacity, BLE_COALESCE_BUF_SIZE);
+}
+
+ret_code_t ble_coalesce_put(uint8_t const * p_frame, size_t length)
+{
+    if (BLE_COALESCE_TAG_SIZE + length > m_capacity)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    if (m_len + BLE_COALESCE_TAG_SIZE + length > m_capacity)
+    {
+        ble_coalesce_flush();
+    }
+
+    bool first = (m_len == 0);
+
+    if (mp_buf == NULL)
+    {
+        mp_buf = frame_pool_alloc();
+        if (mp_buf == NULL)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+
+    mp_buf[m_len++] = (uint8_t)(length >> 8);
+    mp_buf[m_len++] = (uint8_t)length;
+    memcpy(mp_buf + m_len, p_frame, length);
+    m_len += length;
+
+    if ((m_policy == BLE_COALESCE_OFF) ||
+        (m_capacity - m_len <= BLE_COALESCE_TAG_SIZE) ||
+        ((m_policy == BLE_COALESCE_LATENCY) && !m_busy()))
+    {
+        ble_coalesce_flush();
+    }
+    else if (first)
+    {
+        m_flush_due = false;
+
+        ret_code_t err_code = app_timer_start(m_delay_timer, APP_TIMER_TICKS(m_delay_ms), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    return NRF_SUCCESS;
+}
+
+void ble_coalesce_flush(void)
+{
+    if (m_len == 0)
+    {
+        return;
+    }
+
+    UNUSED_RETURN_VALUE(app_timer_stop(m_delay_timer));
+    m_flush_due = false;
+
+    uint8_t * p_record = mp_buf;
+    uint16_t  length   = m_len;
+    mp_buf = NULL;
+    m_len  = 0;
+
+    m_flush(p_record, length, FRAME_POOL_BLOCK_SIZE);
+}
+
+void ble_coalesce_reset(void)
+{
+    UNUSED_RETURN_VALUE(app_timer_stop(m_delay_timer));
+    m_flush_due = false;
+    m_len       = 0;
+
+    if (mp_buf != NULL)
+    {
+        frame_pool_free(mp_buf);
+        mp_buf = NULL;
+    }
+}
+
+void ble_coalesce_process(void)
+{
+    if ((m_len > 0) &&
+        (m_flush_due || ((m_policy == BLE_COALESCE_LATENCY) && !m_busy())))
+    {
+        ble_coalesce_flush();
+    }
+}
+
+ret_code_t ble_coalesce_split(uint8_t const * p_record, size_t length, ble_coalesce_frame_handler_t handler)
+{
+    ret_code_t err_code = NRF_ERROR_NOT_FOUND;
+    size_t     offset   = 0;
+
+    while (length - offset >= BLE_COALESCE_TAG_SIZE)
+    {
+        size_t frame_len = ((size_t)p_record[offset] << 8) | p_record[offset + 1];
+        offset += BLE_COALESCE_TAG_SIZE;
+
+        if ((frame_len == 0) || (frame_len > length - offset))
+        {
+            break;
+        }
+
+        handler(p_record + offset, frame_len);
+        offset  += frame_len;
+        err_code = NRF_SUCCESS;
+    }
+
+    return err_code;
+}
+
+size_t ble_coalesce_unpack(uint8_t * p_record, size_t length, bool keep_tags)
+{
+    size_t in  = 0;
+    size_t out = 0;
+
+    while (length - in >= BLE_COALESCE_TAG_SIZE)
+    {
+        size_t frame_len = ((size_t)p_record[in] << 8) | p_record[in + 1];
+
+        if ((frame_len == 0) || (frame_len > length - in - BLE_COALESCE_TAG_SIZE))
+        {
+            break;
+        }
+
+        if (keep_tags)
+        {
+            out = in + BLE_COALESCE_TAG_SIZE + frame_len;
+        }
+        else
+        {
+            memmove(p_record + out, p_record + in + BLE_COALESCE_TAG_SIZE, frame_len);
+            out += frame_len;
+        }
+        in += BLE_COALESCE_TAG_SIZE + frame_len;
+    }
+
+    return out;
+}
@@ -0,0 +1,99 @@
+#ifndef BLE_COALESCE_H
+#define BLE_COALESCE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+#define BLE_COALESCE_BUF_SIZE       244     /**< Largest coalesced record, the maximum NUS payload. */
+#define BLE_COALESCE_TAG_SIZE       2       /**< Size of the big endian length in front of every frame. */
+#define BLE_COALESCE_DELAY_MS       10      /**< Default time a partly filled record may wait. */
+#define BLE_COALESCE_DELAY_MAX_MS   1000
+
+/**@brief When a partly filled record is sent. */
+typedef enum
+{
+    BLE_COALESCE_OFF        = 0,    /**< Every frame is sent on its own. */
+    BLE_COALESCE_LATENCY    = 1,    /**< Sent as soon as the link has nothing in flight, or after the delay. */
+    BLE_COALESCE_THROUGHPUT = 2,    /**< Sent when full, or after the delay. */
+    BLE_COALESCE_POLICY_COUNT
+} ble_coalesce_policy_t;
+
+/**@brief Called with a record to encrypt and send.
+ *
+ * @details The record is a frame pool block of @p size bytes that the handler takes over. It may be
+ *          overwritten, so it can be encrypted in place, and must be passed on or returned with
+ *          @ref frame_pool_free.
+ */
+typedef void (*ble_coalesce_flush_t)(uint8_t * p_record, size_t length, size_t size);
+
+/**@brief Tells whether notifications are still queued or in flight. */
+typedef bool (*ble_coalesce_busy_t)(void);
+
+/**@brief Called by @ref ble_coalesce_split with every frame of a record. */
+typedef void (*ble_coalesce_frame_handler_t)(uint8_t const * p_frame, size_t length);
+
+/**@brief Initialize coalescing. The app_timer module must be initialized first.
+ *
+ * @param[in] flush  Sends a record.
+ * @param[in] busy   Link state for @ref BLE_COALESCE_LATENCY.
+ */
+ret_code_t ble_coalesce_init(ble_coalesce_flush_t flush, ble_coalesce_busy_t busy);
+
+/**@brief Select the policy and the longest time a partly filled record may wait.
+ *
+ * @details A partly filled record is sent first.
+ *
+ * @retval NRF_SUCCESS              Policy set.
+ * @retval NRF_ERROR_INVALID_PARAM  Unknown policy, or a delay of 0 or above @ref BLE_COALESCE_DELAY_MAX_MS.
+ */
+ret_code_t ble_coalesce_policy_set(ble_coalesce_policy_t policy, uint16_t delay_ms);
+
+/**@brief Get the policy in use. */
+ble_coalesce_policy_t ble_coalesce_policy_get(void);
+
+/**@brief Set the largest record, for example after an ATT MTU exchange. A partly filled record is sent first. */
+void ble_coalesce_capacity_set(uint16_t capacity);
+
+/**@brief Add a frame, sending the record when the policy says so. Main loop only.
+ *
+ * @details A new record takes a frame pool block, so nothing is held while no record is open.
+ *
+ * @retval NRF_SUCCESS              Frame added.
+ * @retval NRF_ERROR_NO_MEM         No frame pool block for a new record.
+ * @retval NRF_ERROR_INVALID_LENGTH The frame does not fit in an empty record.
+ */
+ret_code_t ble_coalesce_put(uint8_t const * p_frame, size_t length);
+
+/**@brief Send the partly filled record, if any. */
+void ble_coalesce_flush(void);
+
+/**@brief Drop the partly filled record, for example on disconnect, and return its block. */
+void ble_coalesce_reset(void);
+
+/**@brief Send a partly filled record once its delay has expired or, for @ref BLE_COALESCE_LATENCY,
+ *        the link has gone idle. Call from the main loop.
+ */
+void ble_coalesce_process(void);
+
+/**@brief Split a received record into its frames.
+ *
+ * @details Splitting stops at the end of the record or at a length that does not fit, which is
+ *          where the cipher padding starts.
+ *
+ * @retval NRF_SUCCESS          At least one frame was found.
+ * @retval NRF_ERROR_NOT_FOUND  The record holds no frame.
+ */
+ret_code_t ble_coalesce_split(uint8_t const * p_record, size_t length, ble_coalesce_frame_handler_t handler);
+
+/**@brief Unpack a received record in place.
+ *
+ * @details Stops where @ref ble_coalesce_split does. With @p keep_tags the frames keep their
+ *          length in front and stay where they are, otherwise the tags are dropped and the frames
+ *          are moved together at the start of the record.
+ *
+ * @return Number of bytes of the unpacked frames, 0 if the record holds no frame.
+ */
+size_t ble_coalesce_unpack(uint8_t * p_record, size_t length, bool keep_tags);
+
+#endif //BLE_COALESCE_H
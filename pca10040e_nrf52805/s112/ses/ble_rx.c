@@ -0,0 +1,136 @@
+#include "ble_rx.h"
+
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "ble_coalesce.h"
+#include "crypto_session.h"
+#include "frame_pool.h"
+#include "uart_framing.h"
+
+static ble_rx_ops_t const * mp_ops;
+static bool                 m_key_exchange_received;    /**< The first BLE packet of the session has started the key exchange. */
+
+void ble_rx_init(ble_rx_ops_t const * p_ops)
+{
+    mp_ops                  = p_ops;
+    m_key_exchange_received = false;
+}
+
+void ble_rx_session_reset(void)
+{
+    m_key_exchange_received = false;
+}
+
+bool ble_rx_records_tagged(void)
+{
+    return uart_framing_is_binary(uart_framing_mode_get()) ||
+           (ble_coalesce_policy_get() != BLE_COALESCE_OFF);
+}
+
+/**@brief Send a pool block to the UART, freeing it if that fails. */
+static void block_send(uint8_t * p_block, size_t length)
+{
+    ret_code_t err_code = mp_ops->send(p_block, length);
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_block);
+        NRF_LOG_WARNING("ble_rx, UART send failed. error: 0x%x.", err_code);
+    }
+}
+
+/**@brief Encode one frame received over BLE for the current mode into a new block and send it. */
+static void frame_write(uint8_t const * p_frame, size_t length)
+{
+    uint8_t * p_block = frame_pool_alloc();
+    if (p_block == NULL)
+    {
+        NRF_LOG_WARNING("ble_rx, frame dropped, no buffer.");
+        return;
+    }
+
+    size_t     uart_frame_len = FRAME_POOL_BLOCK_SIZE;
+    ret_code_t err_code       = uart_framing_encode(p_frame, length, p_block, &uart_frame_len);
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_block);
+        NRF_LOG_WARNING("ble_rx, frame not encoded. error: 0x%x.", err_code);
+        return;
+    }
+
+    block_send(p_block, uart_frame_len);
+}
+
+void ble_rx_process(uint8_t * p_data, size_t length)
+{
+    ret_code_t err_code;
+
+    NRF_LOG_DEBUG("ble_rx, %u bytes received.", length);
+
+    // Check if this is a key exchange message
+    if (!m_key_exchange_received)
+    {
+        err_code = mp_ops->key_exchange(p_data, length);
+        if (err_code == NRF_SUCCESS)
+        {
+            m_key_exchange_received = true;
+            frame_pool_free(p_data);
+            return;
+        }
+        else if (err_code != NRF_ERROR_INVALID_DATA)
+        {
+            NRF_LOG_WARNING("ble_rx, key exchange failed. error: 0x%x.", err_code);
+            frame_pool_free(p_data);
+            return;
+        }
+        // If NRF_ERROR_INVALID_DATA, continue with normal data processing
+    }
+
+    // Handle normal encrypted data, decrypted in place
+    err_code = mp_ops->decrypt(p_data, length, &length);
+    NRF_LOG_DEBUG("ble_rx, decryption ended. error: 0x%x, size: %u.", err_code, length);
+
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_data);
+        return;
+    }
+
+    if (!ble_rx_records_tagged())
+    {
+        //CTR and CCM records carry no padding, the CCM tag and the record number are already cut off.
+        if (crypto_session_cipher_get() == CRYPTO_SESSION_CIPHER_CBC)
+        {
+            //remove all trailing bytes after the '=' character.
+            for(;length > 0 && p_data[length-1] < ' '; length--);
+        }
+    }
+    else if (uart_framing_mode_get() == UART_FRAMING_COBS)
+    {
+        //COBS frames are encoded into new blocks.
+        err_code = ble_coalesce_split(p_data, length, frame_write);
+        if (err_code != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("ble_rx, invalid record.");
+        }
+        length = 0;
+    }
+    else
+    {
+        //Records carry the length of every frame, the padding after the last one is dropped. The
+        //record tags are the same 16 bit big endian lengths the length mode puts on the UART.
+        length = ble_coalesce_unpack(p_data, length, uart_framing_mode_get() == UART_FRAMING_LENGTH);
+        if (length == 0)
+        {
+            NRF_LOG_WARNING("ble_rx, invalid record.");
+        }
+    }
+
+    if (length > 0)
+    {
+        block_send(p_data, length);
+    }
+    else
+    {
+        frame_pool_free(p_data);
+    }
+}
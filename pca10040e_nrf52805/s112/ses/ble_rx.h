@@ -0,0 +1,50 @@
+#ifndef BLE_RX_H
+#define BLE_RX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+/**@brief What the receive path needs from the application. */
+typedef struct
+{
+    /**@brief Handle the first packet of a session as a key exchange message.
+     *
+     * @retval NRF_SUCCESS            The key exchange was started.
+     * @retval NRF_ERROR_INVALID_DATA Not a key exchange message, the packet is processed as data.
+     */
+    ret_code_t (*key_exchange)(uint8_t const * p_data, uint16_t length);
+
+    /**@brief Decrypt a record in place, as crypto_session_decrypt. */
+    ret_code_t (*decrypt)(uint8_t * p_data, size_t length, size_t * p_length);
+
+    /**@brief Send a pool block to the UART, as uart_dma_send: the block is only taken over on
+     *        success. */
+    ret_code_t (*send)(uint8_t * p_block, size_t length);
+} ble_rx_ops_t;
+
+/**@brief Set the functions the receive path uses. */
+void ble_rx_init(ble_rx_ops_t const * p_ops);
+
+/**@brief Start a new session: its first packet is tried as a key exchange message again. */
+void ble_rx_session_reset(void);
+
+/**@brief Check if frames travel as length tagged records, which may hold several frames.
+ *
+ * @details Binary payloads may end in padding-like bytes, so their exact length is sent along.
+ *          Text frames are sent as they are unless coalescing is on, as older peers expect.
+ */
+bool ble_rx_records_tagged(void);
+
+/**@brief Process data received over BLE, in the main loop.
+ *
+ * @details The first packet starts the key exchange, every following packet is decrypted in
+ *          place and, unless it needs COBS encoding, sent to the UART from the same block. The
+ *          block is freed on every path that does not hand it to the UART.
+ *
+ * @param[in] p_data  Received data, in a frame pool block this function owns.
+ * @param[in] length  Length of the received data.
+ */
+void ble_rx_process(uint8_t * p_data, size_t length);
+
+#endif //BLE_RX_H
@@ -0,0 +1,177 @@
+#include "ble_tx_queue.h"
+
+#include <string.h>
+
+#include "app_util_platform.h"
+
+static void flow_add(ble_tx_queue_t * p_queue, uint32_t bytes)
+{
+    if (p_queue->p_flow != NULL)
+    {
+        flow_ctrl_add(p_queue->p_flow, bytes);
+    }
+}
+
+static void flow_remove(ble_tx_queue_t * p_queue, uint32_t bytes)
+{
+    if (p_queue->p_flow != NULL)
+    {
+        flow_ctrl_remove(p_queue->p_flow, bytes);
+    }
+}
+
+/**@brief Remove the oldest queued notification and free its block. */
+static void entry_pop(ble_tx_queue_t * p_queue)
+{
+    frame_pool_free(p_queue->entries[p_queue->head].p_data);
+
+    p_queue->head = (p_queue->head + 1) % BLE_TX_QUEUE_SIZE;
+    p_queue->count--;
+}
+
+/**@brief Send queued notifications. Must be called inside a critical region. */
+static void drain(ble_tx_queue_t * p_queue)
+{
+    while ((p_queue->count > 0) && (p_queue->inflight_count < BLE_TX_QUEUE_INFLIGHT_MAX))
+    {
+        ble_tx_entry_t const * p_entry = &p_queue->entries[p_queue->head];
+        uint16_t               length  = p_entry->length;
+
+        uint32_t err_code = p_queue->send(p_entry->p_data, &length, p_queue->p_context);
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            // Retried on the next BLE_GATTS_EVT_HVN_TX_COMPLETE.
+            break;
+        }
+
+        if (err_code == NRF_SUCCESS)
+        {
+            uint8_t index = (p_queue->inflight_head + p_queue->inflight_count) % BLE_TX_QUEUE_INFLIGHT_MAX;
+            p_queue->inflight_len[index] = p_entry->length;
+            p_queue->inflight_count++;
+            p_queue->stats.sent++;
+        }
+        else
+        {
+            flow_remove(p_queue, p_entry->length);
+            p_queue->stats.dropped++;
+        }
+
+        // The SoftDevice has copied the notification, or refused it, so the block is done with.
+        entry_pop(p_queue);
+    }
+}
+
+void ble_tx_queue_init(ble_tx_queue_t * p_queue, ble_tx_send_t send, void * p_context, flow_ctrl_t * p_flow)
+{
+    memset(p_queue, 0, sizeof(*p_queue));
+
+    p_queue->send      = send;
+    p_queue->p_context = p_context;
+    p_queue->p_flow    = p_flow;
+}
+
+ret_code_t ble_tx_queue_push(ble_tx_queue_t * p_queue, uint8_t * p_block, uint16_t length)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+
+    if (length > BLE_TX_QUEUE_ENTRY_SIZE)
+    {
+        frame_pool_free(p_block);
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    if (p_queue->count == BLE_TX_QUEUE_SIZE)
+    {
+        p_queue->stats.overflow++;
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        ble_tx_entry_t * p_entry = &p_queue->entries[(p_queue->head + p_queue->count) % BLE_TX_QUEUE_SIZE];
+
+        p_entry->p_data = p_block;
+        p_entry->length = length;
+
+        p_queue->count++;
+        p_queue->stats.queued++;
+        if (p_queue->count > p_queue->stats.depth_max)
+        {
+            p_queue->stats.depth_max = p_queue->count;
+        }
+        flow_add(p_queue, length);
+
+        drain(p_queue);
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_block);
+    }
+
+    return err_code;
+}
+
+void ble_tx_queue_drain(ble_tx_queue_t * p_queue)
+{
+    CRITICAL_REGION_ENTER();
+    drain(p_queue);
+    CRITICAL_REGION_EXIT();
+}
+
+void ble_tx_queue_tx_complete(ble_tx_queue_t * p_queue, uint8_t count)
+{
+    uint32_t bytes = 0;
+
+    CRITICAL_REGION_ENTER();
+
+    while ((count > 0) && (p_queue->inflight_count > 0))
+    {
+        bytes += p_queue->inflight_len[p_queue->inflight_head];
+        p_queue->inflight_head = (p_queue->inflight_head + 1) % BLE_TX_QUEUE_INFLIGHT_MAX;
+        p_queue->inflight_count--;
+        p_queue->stats.completed++;
+        count--;
+    }
+    flow_remove(p_queue, bytes);
+
+    drain(p_queue);
+
+    CRITICAL_REGION_EXIT();
+}
+
+bool ble_tx_queue_is_idle(ble_tx_queue_t const * p_queue)
+{
+    return (p_queue->count == 0) && (p_queue->inflight_count == 0);
+}
+
+void ble_tx_queue_reset(ble_tx_queue_t * p_queue)
+{
+    CRITICAL_REGION_ENTER();
+
+    while (p_queue->count > 0)
+    {
+        entry_pop(p_queue);
+    }
+    p_queue->head           = 0;
+    p_queue->inflight_head  = 0;
+    p_queue->inflight_count = 0;
+
+    if (p_queue->p_flow != NULL)
+    {
+        flow_ctrl_reset(p_queue->p_flow);
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+void ble_tx_queue_stats_get(ble_tx_queue_t const * p_queue, ble_tx_queue_stats_t * p_stats)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stats = p_queue->stats;
+    CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,95 @@
+#ifndef BLE_TX_QUEUE_H
+#define BLE_TX_QUEUE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "flow_ctrl.h"
+#include "frame_pool.h"
+
+#define BLE_TX_QUEUE_SIZE           4       /**< Notifications waiting for the SoftDevice, each holds a frame pool block. */
+#define BLE_TX_QUEUE_ENTRY_SIZE     244     /**< Largest notification, the maximum NUS payload. */
+#define BLE_TX_QUEUE_INFLIGHT_MAX   8       /**< Notifications accepted by the SoftDevice but not yet sent. */
+
+/**@brief Function that hands one notification to the SoftDevice.
+ *
+ * @details Same contract as ble_nus_data_send: NRF_ERROR_RESOURCES means the SoftDevice has no
+ *          free buffer and the notification must be retried later, any other error drops it.
+ */
+typedef uint32_t (*ble_tx_send_t)(uint8_t * p_data, uint16_t * p_length, void * p_context);
+
+/**@brief Queue statistics. */
+typedef struct
+{
+    uint32_t queued;        /**< Notifications accepted by @ref ble_tx_queue_push. */
+    uint32_t sent;          /**< Notifications accepted by the SoftDevice. */
+    uint32_t completed;     /**< Notifications reported sent by BLE_GATTS_EVT_HVN_TX_COMPLETE. */
+    uint32_t overflow;      /**< Notifications rejected because the queue was full. */
+    uint32_t dropped;       /**< Notifications the SoftDevice refused, for example without a connection. */
+    uint16_t depth_max;     /**< Most notifications queued at once. */
+} ble_tx_queue_stats_t;
+
+/**@brief Outbound notification queue.
+ *
+ * @details Notifications are frame pool blocks queued by reference and handed to the SoftDevice as
+ *          soon as it has room, from @ref ble_tx_queue_push and from @ref ble_tx_queue_tx_complete.
+ *          Nothing waits for the SoftDevice. A block goes back to the pool as soon as the
+ *          SoftDevice has taken its copy of the notification. If a flow control instance is given,
+ *          it tracks the bytes that are queued or in the SoftDevice and not yet sent.
+ */
+typedef struct
+{
+    uint8_t * p_data;
+    uint16_t  length;
+} ble_tx_entry_t;
+
+typedef struct
+{
+    ble_tx_send_t        send;
+    void *               p_context;
+    flow_ctrl_t *        p_flow;
+    ble_tx_entry_t       entries[BLE_TX_QUEUE_SIZE];
+    uint8_t              head;      /**< Index of the oldest entry. */
+    uint8_t              count;
+    uint16_t             inflight_len[BLE_TX_QUEUE_INFLIGHT_MAX];
+    uint8_t              inflight_head;
+    uint8_t              inflight_count;
+    ble_tx_queue_stats_t stats;
+} ble_tx_queue_t;
+
+/**@brief Initialize an empty queue.
+ *
+ * @param[out] p_queue    Queue.
+ * @param[in]  send       Hands a notification to the SoftDevice, usually wraps ble_nus_data_send.
+ * @param[in]  p_context  Passed to @p send.
+ * @param[in]  p_flow     Flow control to account queued bytes in, may be NULL.
+ */
+void ble_tx_queue_init(ble_tx_queue_t * p_queue, ble_tx_send_t send, void * p_context, flow_ctrl_t * p_flow);
+
+/**@brief Queue a notification and try to send it.
+ *
+ * @details The queue takes over @p p_block, a frame pool block or any address inside one, and
+ *          frees it once sent or dropped. On error it is freed before returning.
+ *
+ * @retval NRF_SUCCESS              Queued.
+ * @retval NRF_ERROR_INVALID_LENGTH @p length is larger than @ref BLE_TX_QUEUE_ENTRY_SIZE.
+ * @retval NRF_ERROR_NO_MEM         The queue has no room, the notification was dropped.
+ */
+ret_code_t ble_tx_queue_push(ble_tx_queue_t * p_queue, uint8_t * p_block, uint16_t length);
+
+/**@brief Hand queued notifications to the SoftDevice until it runs out of room. */
+void ble_tx_queue_drain(ble_tx_queue_t * p_queue);
+
+/**@brief Handle BLE_GATTS_EVT_HVN_TX_COMPLETE: account for @p count sent notifications and send more. */
+void ble_tx_queue_tx_complete(ble_tx_queue_t * p_queue, uint8_t count);
+
+/**@brief Check if nothing is queued or waiting in the SoftDevice. */
+bool ble_tx_queue_is_idle(ble_tx_queue_t const * p_queue);
+
+/**@brief Drop everything and free the queued blocks, for example on disconnect. Statistics are kept. */
+void ble_tx_queue_reset(ble_tx_queue_t * p_queue);
+
+/**@brief Read the queue statistics. */
+void ble_tx_queue_stats_get(ble_tx_queue_t const * p_queue, ble_tx_queue_stats_t * p_stats);
+
+#endif //BLE_TX_QUEUE_H
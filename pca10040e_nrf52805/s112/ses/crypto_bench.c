@@ -0,0 +1,242 @@
+#include "crypto_bench.h"
+
+#if CRYPTO_BENCH_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nordic_common.h"
+#include "sdk_config.h"
+#include "nrf_crypto.h"
+#include "nrf_crypto_aead.h"
+#include "nrf_crypto_ecc.h"
+#include "nrf_crypto_ecdh.h"
+#include "nrf_crypto_hmac.h"
+#include "crypto_session.h"
+
+#define BENCH_PAYLOAD_MAX       244     /**< Largest notification payload with a 247 byte ATT MTU. */
+#define BENCH_BUFFER_SIZE       (BENCH_PAYLOAD_MAX + CRYPTO_SESSION_BLOCK_SIZE)   /**< Room for CBC padding or a tag. */
+#define BENCH_CCM_NONCE_SIZE    13
+#define BENCH_GCM_NONCE_SIZE    12
+#define BENCH_GCM_TAG_SIZE      16
+
+static uint16_t const m_sizes[] = {16, 64, 128, BENCH_PAYLOAD_MAX};
+
+/* Static, the contexts are too large for the stack. Only built with CRYPTO_BENCH_ENABLED. */
+static uint8_t                      m_key[CRYPTO_SESSION_KEY_SIZE];
+static uint8_t                      m_iv[CRYPTO_SESSION_BLOCK_SIZE];   /**< Also the AEAD nonce. */
+static uint8_t                      m_mac[BENCH_GCM_TAG_SIZE];
+static uint8_t                      m_in[BENCH_BUFFER_SIZE];
+static uint8_t                      m_out[BENCH_BUFFER_SIZE];
+static nrf_crypto_aes_context_t     m_aes_ctx;
+static nrf_crypto_aead_context_t    m_aead_ctx;
+static nrf_crypto_ecc_private_key_t m_private_key;
+static nrf_crypto_ecc_public_key_t  m_public_key;
+
+static void cycle_counter_start(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT       = 0;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**@brief Print one result line, see @ref crypto_bench_run. Key exchanges have no payload, 0 bytes. */
+static void result_print(char const * p_name, size_t bytes, uint32_t cycles, uint32_t runs, ret_code_t err_code)
+{
+    if (err_code != NRF_SUCCESS)
+    {
+        printf("BENCH:%s,%u,ERROR 0x%x\r\n", p_name, (unsigned int)bytes, (unsigned int)err_code);
+        return;
+    }
+
+    uint32_t per_op       = cycles / runs;
+    uint32_t per_byte_x10 = (bytes > 0) ? (uint32_t)(((uint64_t)cycles * 10) / ((uint64_t)runs * bytes)) : 0;
+    uint32_t ops          = (per_op > 0) ? (SystemCoreClock / per_op) : 0;
+
+    printf("BENCH:%s,%u,%lu,%lu.%lu,%lu\r\n",
+           p_name, (unsigned int)bytes, (unsigned long)per_op,
+           (unsigned long)(per_byte_x10 / 10), (unsigned long)(per_byte_x10 % 10),
+           (unsigned long)ops);
+}
+
+static void config_print(void)
+{
+    printf("BENCHCFG:cc310=%d,cc310_bl=%d,mbedtls=%d,oberon=%d,cifra=%d,micro_ecc=%d,nrf_hw_rng=%d\r\n",
+           NRF_CRYPTO_BACKEND_CC310_ENABLED,
+           NRF_CRYPTO_BACKEND_CC310_BL_ENABLED,
+           NRF_CRYPTO_BACKEND_MBEDTLS_ENABLED,
+           NRF_CRYPTO_BACKEND_OBERON_ENABLED,
+           NRF_CRYPTO_BACKEND_CIFRA_ENABLED,
+           NRF_CRYPTO_BACKEND_MICRO_ECC_ENABLED,
+           NRF_CRYPTO_BACKEND_NRF_HW_RNG_ENABLED);
+}
+
+/**@brief Context sizes of the backends, the part of the RAM use that changes with the configuration. */
+static void ram_print(void)
+{
+    printf("BENCHRAM:aes_context,%u\r\n", (unsigned int)sizeof(nrf_crypto_aes_context_t));
+    printf("BENCHRAM:aead_context,%u\r\n", (unsigned int)sizeof(nrf_crypto_aead_context_t));
+    printf("BENCHRAM:hmac_context,%u\r\n", (unsigned int)sizeof(nrf_crypto_hmac_context_t));
+    printf("BENCHRAM:ecc_private_key,%u\r\n", (unsigned int)sizeof(nrf_crypto_ecc_private_key_t));
+    printf("BENCHRAM:ecc_public_key,%u\r\n", (unsigned int)sizeof(nrf_crypto_ecc_public_key_t));
+    printf("BENCHRAM:ecc_key_pair_generate_context,%u\r\n",
+           (unsigned int)sizeof(nrf_crypto_ecc_key_pair_generate_context_t));
+    printf("BENCHRAM:ecdh_context,%u\r\n", (unsigned int)sizeof(nrf_crypto_ecdh_context_t));
+}
+
+/**@brief Time one-shot nrf_crypto AES calls, the key schedule included as for a single record. */
+static void aes_bench(char const * p_name, nrf_crypto_aes_info_t const * p_info, bool whole_blocks)
+{
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_sizes); i++)
+    {
+        size_t     length   = m_sizes[i];
+        ret_code_t err_code = NRF_SUCCESS;
+
+        if (whole_blocks)
+        {
+            length = (length + CRYPTO_SESSION_BLOCK_SIZE - 1) & ~(size_t)(CRYPTO_SESSION_BLOCK_SIZE - 1);
+        }
+
+        uint32_t start = DWT->CYCCNT;
+        for (uint32_t run = 0; (run < CRYPTO_BENCH_AES_RUNS) && (err_code == NRF_SUCCESS); run++)
+        {
+            size_t out_size = sizeof(m_out);
+
+            err_code = nrf_crypto_aes_crypt(&m_aes_ctx, p_info, NRF_CRYPTO_ENCRYPT,
+                                            m_key, m_iv, m_in, length, m_out, &out_size);
+        }
+        uint32_t cycles = DWT->CYCCNT - start;
+
+        result_print(p_name, length, cycles, CRYPTO_BENCH_AES_RUNS, err_code);
+    }
+}
+
+/**@brief Time nrf_crypto AEAD encryption, keyed once as for a session. */
+static void aead_bench(char const * p_name, nrf_crypto_aead_info_t const * p_info, size_t nonce_size, size_t mac_size)
+{
+    ret_code_t err_code = nrf_crypto_aead_init(&m_aead_ctx, p_info, m_key);
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_sizes); i++)
+    {
+        uint32_t start = DWT->CYCCNT;
+        for (uint32_t run = 0; (run < CRYPTO_BENCH_AES_RUNS) && (err_code == NRF_SUCCESS); run++)
+        {
+            err_code = nrf_crypto_aead_crypt(&m_aead_ctx, NRF_CRYPTO_ENCRYPT,
+                                             m_iv, nonce_size, NULL, 0,
+                                             m_in, m_sizes[i], m_out, m_mac, mac_size);
+        }
+        uint32_t cycles = DWT->CYCCNT - start;
+
+        result_print(p_name, m_sizes[i], cycles, CRYPTO_BENCH_AES_RUNS, err_code);
+    }
+
+    UNUSED_RETURN_VALUE(nrf_crypto_aead_uninit(&m_aead_ctx));
+}
+
+/**@brief Time the record ciphers as sent, copy into the notification buffer included. */
+static void record_bench(char const * p_name, crypto_session_cipher_t cipher)
+{
+    ret_code_t err_code = crypto_session_cipher_set(cipher);
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_sizes); i++)
+    {
+        uint32_t start = DWT->CYCCNT;
+        for (uint32_t run = 0; (run < CRYPTO_BENCH_AES_RUNS) && (err_code == NRF_SUCCESS); run++)
+        {
+            size_t out_len;
+
+            memcpy(m_out, m_in, m_sizes[i]);
+            err_code = crypto_session_encrypt(m_out, m_sizes[i], sizeof(m_out), &out_len);
+        }
+        uint32_t cycles = DWT->CYCCNT - start;
+
+        result_print(p_name, m_sizes[i], cycles, CRYPTO_BENCH_AES_RUNS, err_code);
+    }
+}
+
+/**@brief Time key pair generation and the shared secret, with the own public key as the peer key. */
+static void ecdh_bench(char const * p_keygen_name, char const * p_shared_name,
+                       nrf_crypto_ecc_curve_info_t const * p_curve_info)
+{
+    uint8_t    secret[32];
+    uint32_t   keygen_cycles = 0;
+    uint32_t   shared_cycles = 0;
+    ret_code_t err_code      = NRF_SUCCESS;
+
+    for (uint32_t run = 0; (run < CRYPTO_BENCH_ECDH_RUNS) && (err_code == NRF_SUCCESS); run++)
+    {
+        size_t   size  = sizeof(secret);
+        uint32_t start = DWT->CYCCNT;
+
+        err_code = nrf_crypto_ecc_key_pair_generate(NULL, p_curve_info, &m_private_key, &m_public_key);
+        keygen_cycles += DWT->CYCCNT - start;
+        if (err_code != NRF_SUCCESS)
+        {
+            break;
+        }
+
+        start    = DWT->CYCCNT;
+        err_code = nrf_crypto_ecdh_compute(NULL, &m_private_key, &m_public_key, secret, &size);
+        shared_cycles += DWT->CYCCNT - start;
+
+        UNUSED_RETURN_VALUE(nrf_crypto_ecc_private_key_free(&m_private_key));
+        UNUSED_RETURN_VALUE(nrf_crypto_ecc_public_key_free(&m_public_key));
+    }
+
+    memset(secret, 0, sizeof(secret));
+
+    result_print(p_keygen_name, 0, keygen_cycles, CRYPTO_BENCH_ECDH_RUNS, err_code);
+    result_print(p_shared_name, 0, shared_cycles, CRYPTO_BENCH_ECDH_RUNS, err_code);
+}
+
+void crypto_bench_run(void)
+{
+    crypto_session_cipher_t cipher = crypto_session_cipher_get();
+
+    for (uint32_t i = 0; i < sizeof(m_in); i++)
+    {
+        m_in[i] = (uint8_t)i;
+    }
+    memset(m_key, 0xA5, sizeof(m_key));
+
+    cycle_counter_start();
+    printf("Crypto benchmark, %lu Hz\r\n", (unsigned long)SystemCoreClock);
+    config_print();
+
+#if NRF_CRYPTO_AES_CBC_ENABLED
+    aes_bench("aes256_cbc", &g_nrf_crypto_aes_cbc_256_info, true);
+#endif
+#if NRF_CRYPTO_AES_CTR_ENABLED
+    aes_bench("aes128_ctr", &g_nrf_crypto_aes_ctr_128_info, false);
+#endif
+#if NRF_CRYPTO_AES_CCM_ENABLED
+    aead_bench("aes128_ccm", &g_nrf_crypto_aes_ccm_128_info, BENCH_CCM_NONCE_SIZE, CRYPTO_SESSION_TAG_SIZE);
+#endif
+#if NRF_CRYPTO_AES_GCM_ENABLED
+    aead_bench("aes128_gcm", &g_nrf_crypto_aes_gcm_128_info, BENCH_GCM_NONCE_SIZE, BENCH_GCM_TAG_SIZE);
+#endif
+
+    // The record ciphers of the app, CTR and CCM on the ECB peripheral. The keystream is not
+    // filled ahead here, CTR shows the cost of a record sent right after the previous one.
+    if ((crypto_session_key_set(CRYPTO_SESSION_TX, m_key) == NRF_SUCCESS) &&
+        (crypto_session_secret_set(m_key, sizeof(m_key)) == NRF_SUCCESS))
+    {
+        record_bench("record_cbc", CRYPTO_SESSION_CIPHER_CBC);
+        record_bench("record_ctr", CRYPTO_SESSION_CIPHER_CTR);
+        record_bench("record_ccm", CRYPTO_SESSION_CIPHER_CCM);
+    }
+    crypto_session_clear();
+    UNUSED_RETURN_VALUE(crypto_session_cipher_set(cipher));
+
+#if NRF_CRYPTO_ECC_SECP256R1_ENABLED
+    ecdh_bench("secp256r1_keygen", "secp256r1_shared", &g_nrf_crypto_ecc_secp256r1_curve_info);
+#endif
+#if NRF_CRYPTO_ECC_CURVE25519_ENABLED
+    ecdh_bench("x25519_keygen", "x25519_shared", &g_nrf_crypto_ecc_curve25519_curve_info);
+#endif
+
+    ram_print();
+}
+
+#endif // CRYPTO_BENCH_ENABLED
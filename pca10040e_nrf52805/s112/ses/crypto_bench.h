@@ -0,0 +1,36 @@
+#ifndef CRYPTO_BENCH_H
+#define CRYPTO_BENCH_H
+#include <stdint.h>
+
+#ifndef CRYPTO_BENCH_ENABLED
+#define CRYPTO_BENCH_ENABLED        0       /**< 1 to build the benchmark and run it at boot. */
+#endif
+
+#ifndef CRYPTO_BENCH_AES_RUNS
+#define CRYPTO_BENCH_AES_RUNS       50      /**< Operations timed per cipher and payload size. */
+#endif
+
+#ifndef CRYPTO_BENCH_ECDH_RUNS
+#define CRYPTO_BENCH_ECDH_RUNS      4       /**< Key generations and shared secrets timed per curve. */
+#endif
+
+/**@brief Time the ciphers and curves of the compiled nrf_crypto backends and print the results.
+ *
+ * @details Every AES mode and ECDH curve the sdk_config of the build enables is timed with the DWT
+ *          cycle counter, at the payload sizes of a notification, as are the record ciphers of
+ *          @ref crypto_session. Build once per backend configuration to compare them. The output
+ *          goes to RTT:
+ *
+ *          BENCHCFG:<backend>=<0|1>,...
+ *          BENCH:<name>,<payload bytes>,<cycles per operation>,<cycles per byte>,<operations per second>
+ *          BENCHRAM:<context>,<bytes>
+ *
+ *          BENCHRAM covers the crypto contexts only. The .data and .bss totals of each build, and
+ *          what the Bench build adds over Release, come from the linker maps, see map_ram.py.
+ *
+ *          The main loop is held for several seconds. Call after the SoftDevice is enabled, for the
+ *          ECB peripheral, and before advertising. The session keys are cleared afterwards.
+ */
+void crypto_bench_run(void);
+
+#endif //CRYPTO_BENCH_H
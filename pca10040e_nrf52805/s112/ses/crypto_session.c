@@ -0,0 +1,559 @@
+#include "crypto_session.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "app_util.h"
+#include "nrf_crypto.h"
+#include "nrf_crypto_hkdf.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+#define NONCE_RECORD_OFFSET     (CRYPTO_SESSION_NONCE_BASE_SIZE - sizeof(uint32_t))
+#define CTR_DOMAIN_BIT          0x80    /**< Set in the first byte of CTR counter blocks, always clear in the CCM flags. */
+#define CTR_BLOCK_OFFSET        CRYPTO_SESSION_NONCE_BASE_SIZE
+#define CCM_NONCE_OFFSET        1
+#define SEQ_MASK                ((1UL << (8 * CRYPTO_SESSION_SEQ_SIZE)) - 1)
+
+#define CCM_L                   (AES_CTR_BLOCK_SIZE - 1 - CRYPTO_SESSION_NONCE_SIZE)   /**< Bytes of the block counter and of the length in B0. */
+#define CCM_FLAGS_B0            ((((CRYPTO_SESSION_TAG_SIZE - 2) / 2) << 3) | (CCM_L - 1))
+#define CCM_FLAGS_A             (CCM_L - 1)
+
+#define HKDF_INFO               "MEGO session keys v1"
+#define HKDF_DIR_SIZE           (AES_CTR_KEY_SIZE + CRYPTO_SESSION_NONCE_BASE_SIZE)
+
+STATIC_ASSERT(CRYPTO_SESSION_NONCE_BASE_SIZE + sizeof(uint32_t) == AES_CTR_BLOCK_SIZE);
+STATIC_ASSERT(CCM_NONCE_OFFSET + CRYPTO_SESSION_NONCE_BASE_SIZE <= CRYPTO_SESSION_NONCE_SIZE);
+STATIC_ASSERT((CRYPTO_SESSION_TAG_SIZE >= 4) && (CRYPTO_SESSION_TAG_SIZE <= 16) && ((CRYPTO_SESSION_TAG_SIZE % 2) == 0));
+STATIC_ASSERT(CCM_L == 2);
+STATIC_ASSERT(CRYPTO_SESSION_SEQ_SIZE == sizeof(uint16_t));
+
+typedef struct
+{
+    nrf_crypto_aes_context_t ctx;   /**< Holds the expanded key schedule between records. */
+    bool                     keyed;
+    uint32_t                 record;    /**< Number of the next CTR or CCM record. */
+} crypto_session_cb_t;
+
+static crypto_session_cb_t     m_sessions[CRYPTO_SESSION_DIR_COUNT];
+static aes_ctr_key_t           m_keys[CRYPTO_SESSION_DIR_COUNT];     /**< Derived CTR and CCM keys. */
+static uint8_t                 m_nonce_bases[CRYPTO_SESSION_DIR_COUNT][CRYPTO_SESSION_NONCE_BASE_SIZE];
+static bool                    m_derived;      /**< Set once @ref m_keys and @ref m_nonce_bases hold derived values. */
+static crypto_session_cipher_t m_cipher = CRYPTO_SESSION_CIPHER_CBC;
+static crypto_session_stats_t  m_stats;
+
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+/* Keystream of the first blocks of the next transmitted record, computed while the CPU is idle. */
+static struct
+{
+    uint32_t blocks[CRYPTO_SESSION_KEYSTREAM_BLOCKS][AES_CTR_BLOCK_SIZE / sizeof(uint32_t)];
+    uint32_t record;    /**< Record the keystream belongs to. */
+    uint8_t  count;     /**< Blocks computed. */
+} m_keystream;
+#endif
+
+static const nrf_crypto_operation_t m_operations[CRYPTO_SESSION_DIR_COUNT] =
+{
+    [CRYPTO_SESSION_TX] = NRF_CRYPTO_ENCRYPT,
+    [CRYPTO_SESSION_RX] = NRF_CRYPTO_DECRYPT,
+};
+
+/**@brief Run one record through the cipher of @p p_session, restarting from a zero IV. */
+static ret_code_t session_crypt(crypto_session_cb_t * p_session, uint8_t * p_data, size_t length, size_t * p_out_len)
+{
+    // Every record is encrypted on its own. CBC leaves the last ciphertext block in the IV, so it
+    // is reset here, which is only a copy. The key schedule is kept.
+    uint8_t    iv[CRYPTO_SESSION_BLOCK_SIZE] = {0};
+    ret_code_t err_code = nrf_crypto_aes_iv_set(&p_session->ctx, iv);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    *p_out_len = length;
+
+    return nrf_crypto_aes_finalize(&p_session->ctx, p_data, length, p_data, p_out_len);
+}
+
+/**@brief Write the nonce of record @p record in direction @p dir, its nonce base with the record
+ *        number XORed into the last 4 bytes.
+ */
+static void record_nonce(uint8_t * p_nonce, crypto_session_dir_t dir, uint32_t record)
+{
+    uint8_t record_be[sizeof(uint32_t)];
+
+    memcpy(p_nonce, m_nonce_bases[dir], CRYPTO_SESSION_NONCE_BASE_SIZE);
+    UNUSED_RETURN_VALUE(uint32_big_encode(record, record_be));
+
+    for (size_t i = 0; i < sizeof(record_be); i++)
+    {
+        p_nonce[NONCE_RECORD_OFFSET + i] ^= record_be[i];
+    }
+}
+
+/**@brief Fill in the counter block of block @p block of record @p record in direction @p dir. */
+static void ctr_counter_init(uint8_t * p_counter, crypto_session_dir_t dir, uint32_t record, uint32_t block)
+{
+    record_nonce(p_counter, dir, record);
+    p_counter[0] |= CTR_DOMAIN_BIT;
+    UNUSED_RETURN_VALUE(uint32_big_encode(block, &p_counter[CTR_BLOCK_OFFSET]));
+}
+
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+/**@brief XOR up to one block of precomputed keystream into @p p_data, a word at a time if aligned. */
+static void keystream_xor(uint8_t * p_data, uint32_t const * p_keystream, size_t length)
+{
+    if ((length == AES_CTR_BLOCK_SIZE) && (((uintptr_t)p_data & (sizeof(uint32_t) - 1)) == 0))
+    {
+        uint32_t * p_words = (uint32_t *)p_data;
+
+        p_words[0] ^= p_keystream[0];
+        p_words[1] ^= p_keystream[1];
+        p_words[2] ^= p_keystream[2];
+        p_words[3] ^= p_keystream[3];
+        return;
+    }
+
+    uint8_t const * p_bytes = (uint8_t const *)p_keystream;
+    for (size_t i = 0; i < length; i++)
+    {
+        p_data[i] ^= p_bytes[i];
+    }
+}
+#endif
+
+/**@brief Run record @p record through AES-CTR.
+ *
+ * @details Transmitted records first use the keystream precomputed by
+ *          @ref crypto_session_keystream_fill, the rest is encrypted on the spot.
+ */
+static ret_code_t session_ctr_crypt(crypto_session_dir_t dir, uint32_t record, uint8_t * p_data, size_t length)
+{
+    uint8_t  counter[AES_CTR_BLOCK_SIZE];
+    uint32_t block  = 0;
+
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+    if (dir == CRYPTO_SESSION_TX)
+    {
+        if (m_keystream.record == record)
+        {
+            for (; (length > 0) && (block < m_keystream.count); block++)
+            {
+                size_t block_len = MIN(length, AES_CTR_BLOCK_SIZE);
+
+                keystream_xor(p_data, m_keystream.blocks[block], block_len);
+                p_data += block_len;
+                length -= block_len;
+            }
+            m_stats.keystream_hits += block;
+        }
+        m_stats.keystream_misses += (length + AES_CTR_BLOCK_SIZE - 1) / AES_CTR_BLOCK_SIZE;
+
+        // The rest belongs to this record, the next fill starts on the next one.
+        m_keystream.record = record + 1;
+        m_keystream.count  = 0;
+    }
+#endif
+
+    if (length == 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    ctr_counter_init(counter, dir, record, block);
+
+    return aes_ctr_crypt(&m_keys[dir], counter, p_data, length);
+}
+
+/**@brief Fill in a CCM block, B0 or a counter block, of record @p record in direction @p dir.
+ *
+ * @param[in] flags  @ref CCM_FLAGS_B0 or @ref CCM_FLAGS_A.
+ * @param[in] tail   Record length for B0, block number for a counter block.
+ */
+static void ccm_block_init(uint8_t * p_block, uint8_t flags, crypto_session_dir_t dir, uint32_t record, uint16_t tail)
+{
+    memset(p_block, 0, AES_CTR_BLOCK_SIZE);
+
+    p_block[0] = flags;
+    record_nonce(&p_block[CCM_NONCE_OFFSET], dir, record);
+    UNUSED_RETURN_VALUE(uint16_big_encode(tail, &p_block[AES_CTR_BLOCK_SIZE - CCM_L]));
+}
+
+/**@brief Compute the CCM tag of a record, the CBC-MAC of the plaintext encrypted with counter block 0. */
+static ret_code_t ccm_tag(crypto_session_dir_t dir, uint32_t record, uint8_t const * p_data, size_t length, uint8_t * p_tag)
+{
+    uint8_t    mac[AES_CTR_BLOCK_SIZE];
+    uint8_t    block[AES_CTR_BLOCK_SIZE];
+    ret_code_t err_code;
+
+    ccm_block_init(block, CCM_FLAGS_B0, dir, record, (uint16_t)length);
+    err_code = aes_ctr_block_encrypt(&m_keys[dir], block, mac);
+
+    // No associated data, the blocks of the record follow B0, the last one padded with zeros.
+    while ((err_code == NRF_SUCCESS) && (length > 0))
+    {
+        size_t block_len = MIN(length, AES_CTR_BLOCK_SIZE);
+
+        for (size_t i = 0; i < block_len; i++)
+        {
+            mac[i] ^= p_data[i];
+        }
+        err_code = aes_ctr_block_encrypt(&m_keys[dir], mac, mac);
+
+        p_data += block_len;
+        length -= block_len;
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        ccm_block_init(block, CCM_FLAGS_A, dir, record, 0);
+        err_code = aes_ctr_crypt(&m_keys[dir], block, mac, CRYPTO_SESSION_TAG_SIZE);
+    }
+
+    memcpy(p_tag, mac, CRYPTO_SESSION_TAG_SIZE);
+    memset(mac, 0, sizeof(mac));
+
+    return err_code;
+}
+
+/**@brief Encrypt or decrypt the payload of a CCM record, counter blocks from 1 on. */
+static ret_code_t ccm_payload_crypt(crypto_session_dir_t dir, uint32_t record, uint8_t * p_data, size_t length)
+{
+    uint8_t counter[AES_CTR_BLOCK_SIZE];
+
+    // A record is at most a few hundred bytes, the 16 bit block number never carries into the
+    // record number.
+    ccm_block_init(counter, CCM_FLAGS_A, dir, record, 1);
+
+    return aes_ctr_crypt(&m_keys[dir], counter, p_data, length);
+}
+
+/**@brief Encrypt CCM record @p record and append its tag. */
+static ret_code_t session_ccm_encrypt(uint32_t record, uint8_t * p_data, size_t length)
+{
+    ret_code_t err_code = ccm_tag(CRYPTO_SESSION_TX, record, p_data, length, p_data + length);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return ccm_payload_crypt(CRYPTO_SESSION_TX, record, p_data, length);
+}
+
+/**@brief Decrypt CCM record @p record and check its tag. */
+static ret_code_t session_ccm_decrypt(uint32_t record, uint8_t * p_data, size_t length)
+{
+    uint8_t    tag[CRYPTO_SESSION_TAG_SIZE];
+    uint8_t    diff = 0;
+    ret_code_t err_code;
+
+    err_code = ccm_payload_crypt(CRYPTO_SESSION_RX, record, p_data, length);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = ccm_tag(CRYPTO_SESSION_RX, record, p_data, length, tag);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        memset(p_data, 0, length);
+        return err_code;
+    }
+
+    // Compared in constant time, the received tag follows the record.
+    for (size_t i = 0; i < CRYPTO_SESSION_TAG_SIZE; i++)
+    {
+        diff |= tag[i] ^ p_data[length + i];
+    }
+
+    if (diff != 0)
+    {
+        memset(p_data, 0, length);
+        m_stats.auth_failed++;
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Recover the number of a received record from the low bits sent with it, the first
+ *        number from the next one expected on that match them.
+ */
+static uint32_t seq_record_get(uint8_t const * p_seq)
+{
+    uint32_t next = m_sessions[CRYPTO_SESSION_RX].record;
+
+    return next + ((uint16_big_decode(p_seq) - next) & SEQ_MASK);
+}
+
+ret_code_t crypto_session_key_set(crypto_session_dir_t dir, uint8_t const * p_key)
+{
+    crypto_session_cb_t * p_session = &m_sessions[dir];
+    uint8_t               key[CRYPTO_SESSION_KEY_SIZE];
+    ret_code_t            err_code;
+
+    if (p_session->keyed)
+    {
+        UNUSED_RETURN_VALUE(nrf_crypto_aes_uninit(&p_session->ctx));
+        p_session->keyed = false;
+    }
+
+    err_code = nrf_crypto_aes_init(&p_session->ctx, &g_nrf_crypto_aes_cbc_256_info, m_operations[dir]);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // nrf_crypto takes the key as non-const.
+    memcpy(key, p_key, sizeof(key));
+    err_code = nrf_crypto_aes_key_set(&p_session->ctx, key);
+    memset(key, 0, sizeof(key));
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("crypto_session, key_set failed. error: 0x%x.", err_code);
+        UNUSED_RETURN_VALUE(nrf_crypto_aes_uninit(&p_session->ctx));
+        return err_code;
+    }
+
+    p_session->keyed = true;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t crypto_session_secret_set(uint8_t const * p_secret, size_t secret_size)
+{
+    uint8_t    okm[CRYPTO_SESSION_DIR_COUNT * HKDF_DIR_SIZE];
+    size_t     okm_size = sizeof(okm);
+    ret_code_t err_code;
+
+    nrf_crypto_hmac_context_t hmac_ctx;
+
+    // Extract and expand once per key exchange, no salt. Only the AES keys and the nonce bases
+    // are kept, the shared secret is not needed again.
+    err_code = nrf_crypto_hkdf_calculate(&hmac_ctx,
+                                         &g_nrf_crypto_hmac_sha256_info,
+                                         okm,
+                                         &okm_size,
+                                         p_secret,
+                                         secret_size,
+                                         NULL,
+                                         0,
+                                         (uint8_t const *)HKDF_INFO,
+                                         sizeof(HKDF_INFO) - 1,
+                                         NRF_CRYPTO_HKDF_EXTRACT_AND_EXPAND);
+    memset(&hmac_ctx, 0, sizeof(hmac_ctx));
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("crypto_session, hkdf failed. error: 0x%x.", err_code);
+        memset(okm, 0, sizeof(okm));
+        return err_code;
+    }
+
+    // The central derives the same output, the first half is what the peripheral sends.
+    for (uint32_t dir = 0; dir < CRYPTO_SESSION_DIR_COUNT; dir++)
+    {
+        uint8_t const * p_okm = &okm[((dir == CRYPTO_SESSION_TX) ? 0 : 1) * HKDF_DIR_SIZE];
+
+        aes_ctr_key_set(&m_keys[dir], p_okm);
+        memcpy(m_nonce_bases[dir], p_okm + AES_CTR_KEY_SIZE, CRYPTO_SESSION_NONCE_BASE_SIZE);
+        m_sessions[dir].record = 0;
+    }
+    memset(okm, 0, sizeof(okm));
+
+    m_derived = true;
+
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+    // Computed with the old key.
+    memset(&m_keystream, 0, sizeof(m_keystream));
+#endif
+
+    return NRF_SUCCESS;
+}
+
+bool crypto_session_is_keyed(crypto_session_dir_t dir)
+{
+    return (m_cipher == CRYPTO_SESSION_CIPHER_CBC) ? m_sessions[dir].keyed : m_derived;
+}
+
+void crypto_session_clear(void)
+{
+    for (uint32_t dir = 0; dir < CRYPTO_SESSION_DIR_COUNT; dir++)
+    {
+        if (m_sessions[dir].keyed)
+        {
+            UNUSED_RETURN_VALUE(nrf_crypto_aes_uninit(&m_sessions[dir].ctx));
+        }
+        memset(&m_sessions[dir], 0, sizeof(m_sessions[dir]));
+        aes_ctr_key_clear(&m_keys[dir]);
+    }
+
+    memset(m_nonce_bases, 0, sizeof(m_nonce_bases));
+    m_derived = false;
+
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+    memset(&m_keystream, 0, sizeof(m_keystream));
+#endif
+}
+
+void crypto_session_keystream_fill(void)
+{
+#if CRYPTO_SESSION_KEYSTREAM_BLOCKS > 0
+    if ((m_cipher != CRYPTO_SESSION_CIPHER_CTR) || !m_derived)
+    {
+        return;
+    }
+
+    uint32_t record = m_sessions[CRYPTO_SESSION_TX].record;
+    if (m_keystream.record != record)
+    {
+        m_keystream.record = record;
+        m_keystream.count  = 0;
+    }
+
+    while (m_keystream.count < CRYPTO_SESSION_KEYSTREAM_BLOCKS)
+    {
+        uint8_t counter[AES_CTR_BLOCK_SIZE];
+
+        ctr_counter_init(counter, CRYPTO_SESSION_TX, record, m_keystream.count);
+        if (aes_ctr_block_encrypt(&m_keys[CRYPTO_SESSION_TX], counter, (uint8_t *)m_keystream.blocks[m_keystream.count]) != NRF_SUCCESS)
+        {
+            break;
+        }
+        m_keystream.count++;
+    }
+#endif
+}
+
+void crypto_session_stats_get(crypto_session_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+ret_code_t crypto_session_cipher_set(crypto_session_cipher_t cipher)
+{
+    if (cipher >= CRYPTO_SESSION_CIPHER_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_cipher = cipher;
+
+    return NRF_SUCCESS;
+}
+
+crypto_session_cipher_t crypto_session_cipher_get(void)
+{
+    return m_cipher;
+}
+
+size_t crypto_session_plaintext_max(size_t cipher_len)
+{
+    if (m_cipher == CRYPTO_SESSION_CIPHER_CTR)
+    {
+        return (cipher_len > CRYPTO_SESSION_SEQ_SIZE) ? (cipher_len - CRYPTO_SESSION_SEQ_SIZE) : 0;
+    }
+
+    if (m_cipher == CRYPTO_SESSION_CIPHER_CCM)
+    {
+        size_t overhead = CRYPTO_SESSION_TAG_SIZE + CRYPTO_SESSION_SEQ_SIZE;
+
+        return (cipher_len > overhead) ? (cipher_len - overhead) : 0;
+    }
+
+    // CBC always adds at least one byte of padding.
+    return ((cipher_len / CRYPTO_SESSION_BLOCK_SIZE) * CRYPTO_SESSION_BLOCK_SIZE) - 1;
+}
+
+ret_code_t crypto_session_encrypt(uint8_t * p_data, size_t length, size_t size, size_t * p_out_len)
+{
+    crypto_session_cb_t * p_session = &m_sessions[CRYPTO_SESSION_TX];
+
+    if (!crypto_session_is_keyed(CRYPTO_SESSION_TX))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (m_cipher != CRYPTO_SESSION_CIPHER_CBC)
+    {
+        size_t     tag_len = (m_cipher == CRYPTO_SESSION_CIPHER_CCM) ? CRYPTO_SESSION_TAG_SIZE : 0;
+        uint32_t   record  = p_session->record;
+        ret_code_t err_code;
+
+        if (length + tag_len + CRYPTO_SESSION_SEQ_SIZE > size)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+
+        err_code = (tag_len > 0) ? session_ccm_encrypt(record, p_data, length)
+                                 : session_ctr_crypt(CRYPTO_SESSION_TX, record, p_data, length);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+
+        // The record number is sent so that the receiver keeps in step over records lost on the
+        // way, by either end.
+        UNUSED_RETURN_VALUE(uint16_big_encode((uint16_t)(record & SEQ_MASK), p_data + length + tag_len));
+        p_session->record++;
+
+        *p_out_len = length + tag_len + CRYPTO_SESSION_SEQ_SIZE;
+        return NRF_SUCCESS;
+    }
+
+    size_t padded_len = ((length / CRYPTO_SESSION_BLOCK_SIZE) + 1) * CRYPTO_SESSION_BLOCK_SIZE;
+    if (padded_len > size)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memset(p_data + length, CRYPTO_SESSION_PAD_BYTE, padded_len - length);
+
+    return session_crypt(p_session, p_data, padded_len, p_out_len);
+}
+
+ret_code_t crypto_session_decrypt(uint8_t * p_data, size_t length, size_t * p_out_len)
+{
+    crypto_session_cb_t * p_session = &m_sessions[CRYPTO_SESSION_RX];
+
+    if (!crypto_session_is_keyed(CRYPTO_SESSION_RX))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (m_cipher != CRYPTO_SESSION_CIPHER_CBC)
+    {
+        size_t     tag_len = (m_cipher == CRYPTO_SESSION_CIPHER_CCM) ? CRYPTO_SESSION_TAG_SIZE : 0;
+        ret_code_t err_code;
+
+        if (length < tag_len + CRYPTO_SESSION_SEQ_SIZE)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        size_t   plain_len = length - tag_len - CRYPTO_SESSION_SEQ_SIZE;
+        uint32_t record    = seq_record_get(p_data + length - CRYPTO_SESSION_SEQ_SIZE);
+
+        err_code = (tag_len > 0) ? session_ccm_decrypt(record, p_data, plain_len)
+                                 : session_ctr_crypt(CRYPTO_SESSION_RX, record, p_data, plain_len);
+        if (err_code != NRF_SUCCESS)
+        {
+            // A CCM record that fails its tag does not move the receiver on.
+            return err_code;
+        }
+
+        m_stats.records_skipped += record - p_session->record;
+        p_session->record        = record + 1;
+
+        *p_out_len = plain_len;
+        return NRF_SUCCESS;
+    }
+
+    if ((length % CRYPTO_SESSION_BLOCK_SIZE) != 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    return session_crypt(p_session, p_data, length, p_out_len);
+}
@@ -0,0 +1,155 @@
+#ifndef CRYPTO_SESSION_H
+#define CRYPTO_SESSION_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "aes_ctr.h"
+
+#define CRYPTO_SESSION_KEY_SIZE     32      /**< AES-256 key. */
+#define CRYPTO_SESSION_BLOCK_SIZE   16
+#define CRYPTO_SESSION_PAD_BYTE     0x04    /**< Not 0x00, due to the way the decryption in the android app works. */
+
+#ifndef CRYPTO_SESSION_KEYSTREAM_BLOCKS
+#define CRYPTO_SESSION_KEYSTREAM_BLOCKS 8   /**< CTR keystream blocks computed ahead for the next record sent, 0 to compute it only on demand. */
+#endif
+
+#ifndef CRYPTO_SESSION_TAG_SIZE
+#define CRYPTO_SESSION_TAG_SIZE     8       /**< Truncated CCM tag, an even number of bytes from 4 to 16. */
+#endif
+#define CRYPTO_SESSION_NONCE_SIZE   13      /**< CCM nonce, leaving 2 bytes for the block counter. */
+#define CRYPTO_SESSION_NONCE_BASE_SIZE 12   /**< Derived per direction, see @ref crypto_session_secret_set. */
+#define CRYPTO_SESSION_SEQ_SIZE     2       /**< Low bits of the record number, at the end of every CTR and CCM record. */
+
+/**@brief Cipher used for records. Both ends must use the same one. */
+typedef enum
+{
+    CRYPTO_SESSION_CIPHER_CBC = 0,  /**< AES-256-CBC, zero IV, padded to whole blocks. */
+    CRYPTO_SESSION_CIPHER_CTR = 1,  /**< AES-128-CTR on the ECB peripheral, no padding. Keyed by the key exchange only, see @ref crypto_session_secret_set. */
+    CRYPTO_SESSION_CIPHER_CCM = 2,  /**< AES-128-CCM on the ECB peripheral, a @ref CRYPTO_SESSION_TAG_SIZE tag and no padding. Keyed by the key exchange only. */
+    CRYPTO_SESSION_CIPHER_COUNT
+} crypto_session_cipher_t;
+
+/**@brief Session statistics. */
+typedef struct
+{
+    uint32_t keystream_hits;    /**< CTR blocks sent with keystream computed ahead. */
+    uint32_t keystream_misses;  /**< CTR blocks sent with keystream computed on demand. */
+    uint32_t auth_failed;       /**< CCM records dropped because their tag did not match. */
+    uint32_t records_skipped;   /**< Received record numbers never seen, records the central sent that were lost. */
+} crypto_session_stats_t;
+
+/**@brief Direction of a session key. */
+typedef enum
+{
+    CRYPTO_SESSION_TX,      /**< Records sent over BLE. */
+    CRYPTO_SESSION_RX,      /**< Records received over BLE. */
+    CRYPTO_SESSION_DIR_COUNT
+} crypto_session_dir_t;
+
+/**@brief Set the key of one direction.
+ *
+ * @details The AES key schedule is expanded here, once, and reused by every record until the key
+ *          is set again. nrf_crypto must be initialized first.
+ *
+ * @param[in] dir    Direction.
+ * @param[in] p_key  @ref CRYPTO_SESSION_KEY_SIZE bytes, copied.
+ */
+ret_code_t crypto_session_key_set(crypto_session_dir_t dir, uint8_t const * p_key);
+
+/**@brief Derive the CTR and CCM session keys from the shared secret of a key exchange.
+ *
+ * @details Runs HKDF-SHA256 once, with no salt and the info "MEGO session keys v1", for
+ *          2 * (@ref AES_CTR_KEY_SIZE + @ref CRYPTO_SESSION_NONCE_BASE_SIZE) bytes:
+ *          [peripheral to central key][nonce base][central to peripheral key][nonce base]. Each
+ *          direction keeps its key, ready for the ECB peripheral, and its nonce base for the rest
+ *          of the session, the secret itself is not kept.
+ *
+ *          The nonce of a record is its nonce base with the 32 bit big endian record number XORed
+ *          into the last 4 bytes. Both record numbers restart at 0, so every key exchange must
+ *          bring a fresh secret. The low @ref CRYPTO_SESSION_SEQ_SIZE bytes of the record number
+ *          follow every record, big endian, so a record lost on the way only leaves a gap. The CTR counter block is [nonce, first bit set][block number],
+ *          the CCM nonce is [nonce][0], whose flags byte never has the first bit set, so the two
+ *          ciphers never share a block.
+ *
+ * @param[in] p_secret     Shared secret.
+ * @param[in] secret_size  Its size.
+ *
+ * @retval NRF_SUCCESS  Keys derived.
+ * @return Otherwise the error from nrf_crypto_hkdf_calculate, the previous keys are kept.
+ */
+ret_code_t crypto_session_secret_set(uint8_t const * p_secret, size_t secret_size);
+
+/**@brief Check if a direction has a key for the cipher in use. */
+bool crypto_session_is_keyed(crypto_session_dir_t dir);
+
+/**@brief Forget the keys of both directions and wipe the key schedules. */
+void crypto_session_clear(void);
+
+/**@brief Select the cipher.
+ *
+ * @retval NRF_SUCCESS              Cipher set.
+ * @retval NRF_ERROR_INVALID_PARAM  Unknown cipher.
+ */
+ret_code_t crypto_session_cipher_set(crypto_session_cipher_t cipher);
+
+/**@brief Get the cipher in use. */
+crypto_session_cipher_t crypto_session_cipher_get(void);
+
+/**@brief Compute the CTR keystream of the next record sent ahead of time.
+ *
+ * @details Call from the main loop before the CPU goes to sleep. Encrypting a record then only
+ *          XORs its first @ref CRYPTO_SESSION_KEYSTREAM_BLOCKS blocks with ready keystream, the
+ *          rest is computed on demand. Does nothing with CBC or without a CTR key.
+ */
+void crypto_session_keystream_fill(void);
+
+/**@brief Read the session statistics. */
+void crypto_session_stats_get(crypto_session_stats_t * p_stats);
+
+/**@brief Longest record whose ciphertext fits in @p cipher_len bytes with the cipher in use. */
+size_t crypto_session_plaintext_max(size_t cipher_len);
+
+/**@brief Encrypt a record in place with the transmit key.
+ *
+ * @details With @ref CRYPTO_SESSION_CIPHER_CBC the record is padded with
+ *          @ref CRYPTO_SESSION_PAD_BYTE to the next multiple of @ref CRYPTO_SESSION_BLOCK_SIZE,
+ *          always adding at least one byte. With @ref CRYPTO_SESSION_CIPHER_CTR the ciphertext is
+ *          as long as the record, with @ref CRYPTO_SESSION_CIPHER_CCM it is followed by the tag.
+ *          Both then append the low bits of the record number, see
+ *          @ref CRYPTO_SESSION_SEQ_SIZE, and advance it.
+ *
+ * @param[in,out] p_data      Record, overwritten with the ciphertext.
+ * @param[in]     length      Record length.
+ * @param[in]     size        Size of the buffer at @p p_data, room for the padding, the tag and
+ *                            the record number.
+ * @param[out]    p_out_len   Ciphertext length.
+ *
+ * @retval NRF_SUCCESS              Encrypted.
+ * @retval NRF_ERROR_INVALID_STATE  No transmit key.
+ * @retval NRF_ERROR_NO_MEM         No room for the padding, the tag or the record number.
+ */
+ret_code_t crypto_session_encrypt(uint8_t * p_data, size_t length, size_t size, size_t * p_out_len);
+
+/**@brief Decrypt a record in place with the receive key.
+ *
+ * @details The number of a CTR or CCM record is the first one from the next expected on whose
+ *          low bits match those sent with it, so records the central sent that never arrived
+ *          are skipped over and counted. A CCM record is only returned if its tag matches.
+ *          Otherwise the record is wiped and the expected record number does not advance, so a
+ *          forged, corrupted or replayed record neither reaches the caller nor throws the
+ *          following records out of step.
+ *
+ * @param[in,out] p_data     Ciphertext, overwritten with the record.
+ * @param[in]     length     Ciphertext length.
+ * @param[out]    p_out_len  Record length, without the CCM tag and the record number.
+ *
+ * @retval NRF_SUCCESS              Decrypted, a CBC padding is left in place.
+ * @retval NRF_ERROR_INVALID_STATE  No receive key.
+ * @retval NRF_ERROR_INVALID_LENGTH CBC: @p length is not a multiple of @ref CRYPTO_SESSION_BLOCK_SIZE.
+ *                                  CTR and CCM: shorter than the tag and the record number.
+ * @retval NRF_ERROR_INVALID_DATA   CCM only, the tag does not match.
+ */
+ret_code_t crypto_session_decrypt(uint8_t * p_data, size_t length, size_t * p_out_len);
+
+#endif //CRYPTO_SESSION_H
@@ -1,9 +1,14 @@
 
 #include "flash_manager.h"
+
+#include <stddef.h>
+
 #include "boards.h"
+#include "nordic_common.h"
 #include "fds.h"
 #include "nrf_soc.h"
 #include "sdk_config.h"
+#include "key_exchange.h"
 
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
@@ -11,6 +16,7 @@
 
 #define CONFIG_FILE     (0x8010)
 #define CONFIG_REC_KEY  (0x7010)
+#define RESUME_REC_KEY  (0x7011)
 
 static configuration_t m_configuration =
 {
@@ -18,8 +24,27 @@ static configuration_t m_configuration =
                             'S', 'E', 'M', 'I', 'C', 'O', 'N', 'D', 'U', 'C', 'T', 'O', 'R',
                             'A', 'E', 'S', '&', 'M', 'A', 'C', ' ', 'T', 'E', 'S', 'T'},    
     .device_name = "MEGO",
+    .uart_baud_rate = 115200,
+    .uart_stop_bits = 1,
+    .uart_parity    = UART_PARITY_NONE,
+    .data_mode      = 0,
+    .idle_gap_ms    = 2,
+    .coalesce_policy   = 0,
+    .coalesce_delay_ms = 10,
+    .cipher            = 0,
+    .psk_mode          = 0,
+    .curve             = KEY_EXCHANGE_CURVE_DEFAULT,
 };
 
+/* Resumption record write in progress, until done is called. */
+static struct
+{
+    void const *             p_data;
+    uint32_t                 len;
+    flash_mgr_done_handler_t done;          /**< NULL when no write is in progress. */
+    bool                     gc_pending;    /**< Waiting for FDS_EVT_GC to try the write again. */
+} m_resumption;
+
 static fds_record_t const m_fds_record =
 {
     .file_id           = CONFIG_FILE,
@@ -29,10 +54,86 @@ static fds_record_t const m_fds_record =
     .data.length_words = (sizeof(m_configuration) + 3) / sizeof(uint32_t),
 };
 
+/**@brief Queue the resumption record, as an update if it is already in flash. */
+static ret_code_t resumption_write(void)
+{
+    fds_record_desc_t desc = {0};
+    fds_find_token_t  tok  = {0};
+    fds_record_t const rec =
+    {
+        .file_id           = CONFIG_FILE,
+        .key               = RESUME_REC_KEY,
+        .data.p_data       = m_resumption.p_data,
+        .data.length_words = (m_resumption.len + 3) / sizeof(uint32_t)
+    };
+
+    ret_code_t rc = fds_record_find(CONFIG_FILE, RESUME_REC_KEY, &desc, &tok);
+    if (rc == NRF_SUCCESS)
+    {
+        rc = fds_record_update(&desc, &rec);
+    }
+    else
+    {
+        rc = fds_record_write(NULL, &rec);
+    }
+    return rc;
+}
+
+static void resumption_done(ret_code_t result)
+{
+    flash_mgr_done_handler_t done = m_resumption.done;
+
+    m_resumption.done = NULL;
+    if (result != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_resumption, write failed. error: 0x%x.", result);
+    }
+    done(result);
+}
+
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+    if (m_resumption.done == NULL)
+    {
+        return;
+    }
+
+    switch (p_evt->id)
+    {
+        case FDS_EVT_WRITE:
+        case FDS_EVT_UPDATE:
+            if ((p_evt->write.file_id == CONFIG_FILE) && (p_evt->write.record_key == RESUME_REC_KEY))
+            {
+                resumption_done(p_evt->result);
+            }
+            break;
+
+        case FDS_EVT_GC:
+            if (m_resumption.gc_pending)
+            {
+                // Tried once more only, a second FDS_ERR_NO_SPACE_IN_FLASH is returned.
+                m_resumption.gc_pending = false;
+
+                ret_code_t rc = (p_evt->result == NRF_SUCCESS) ? resumption_write() : p_evt->result;
+                if (rc != NRF_SUCCESS)
+                {
+                    resumption_done(rc);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
 ret_code_t flash_mgr_flash_mgr_init()
 {
     ret_code_t rc = NRF_SUCCESS;
 
+    rc = fds_register(fds_evt_handler);
+    APP_ERROR_CHECK(rc);
+
     //read the configuration.
     //if it does not exist, create a default one in flash.
 
@@ -50,8 +151,17 @@ ret_code_t flash_mgr_flash_mgr_init()
         rc = fds_record_open(&desc, &config);
         APP_ERROR_CHECK(rc);
 
-        /* Copy the configuration from flash into m_dummy_cfg. */
-        memcpy(&m_configuration, config.p_data, sizeof(configuration_t));
+        /* Copy the configuration from flash into m_dummy_cfg. A record written by an older
+         * firmware is shorter, the fields it does not have keep their defaults. */
+        memcpy(&m_configuration, config.p_data,
+               MIN(sizeof(configuration_t), config.p_header->length_words * sizeof(uint32_t)));
+
+        /* A device configured before the curve could be chosen keeps offering secp256r1, so its
+         * peers see no change. Only a freshly provisioned device starts with the default. */
+        if (config.p_header->length_words * sizeof(uint32_t) <= offsetof(configuration_t, curve))
+        {
+            m_configuration.curve = KEY_EXCHANGE_CURVE_SECP256R1;
+        }
 
         NRF_LOG_INFO("flash_mgr_flash_mgr_init, Config file found, device name: %s", m_configuration.device_name);
 
@@ -142,6 +252,144 @@ ret_code_t flash_mgr_set_encryption_key(uint8_t * encryption_key, int len)
     return err_code;
 }
 
+ret_code_t flash_mgr_set_uart_config(uint32_t baud_rate, uint8_t stop_bits, uint8_t parity)
+{
+    if (parity > UART_PARITY_EVEN)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_uart_config, invalid parity %d", parity);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_configuration.uart_baud_rate = baud_rate;
+    m_configuration.uart_stop_bits = stop_bits;
+    m_configuration.uart_parity    = parity;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_data_mode(uint8_t data_mode, uint16_t idle_gap_ms)
+{
+    if (idle_gap_ms == 0)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_data_mode, idle gap must not be 0");
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_configuration.data_mode   = data_mode;
+    m_configuration.idle_gap_ms = idle_gap_ms;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_coalesce(uint8_t policy, uint16_t delay_ms)
+{
+    if (delay_ms == 0)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_coalesce, delay must not be 0");
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_configuration.coalesce_policy   = policy;
+    m_configuration.coalesce_delay_ms = delay_ms;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_cipher(uint8_t cipher)
+{
+    m_configuration.cipher = cipher;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_psk_mode(uint8_t psk_mode)
+{
+    if (psk_mode > 1)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_psk_mode, invalid mode %d", psk_mode);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_configuration.psk_mode = psk_mode;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_curve(uint8_t curve)
+{
+    if (key_exchange_public_key_size((key_exchange_curve_t)curve) == 0)
+    {
+        NRF_LOG_ERROR("flash_mgr_set_curve, invalid curve %d", curve);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_configuration.curve = curve;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t flash_mgr_set_resumption(void const * p_data, uint32_t len, flash_mgr_done_handler_t done)
+{
+    if (m_resumption.done != NULL)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    m_resumption.p_data     = p_data;
+    m_resumption.len        = len;
+    m_resumption.done       = done;
+    m_resumption.gc_pending = false;
+
+    ret_code_t rc = resumption_write();
+    if (rc == FDS_ERR_NO_SPACE_IN_FLASH)
+    {
+        // Every update leaves the old record behind, reclaim them and write on FDS_EVT_GC.
+        m_resumption.gc_pending = true;
+        rc = fds_gc();
+    }
+
+    if (rc != NRF_SUCCESS)
+    {
+        m_resumption.gc_pending = false;
+        m_resumption.done       = NULL;
+        NRF_LOG_ERROR("flash_mgr_set_resumption, write failed. error: 0x%x.", rc);
+    }
+    return rc;
+}
+
+ret_code_t flash_mgr_get_resumption(void * p_data, uint32_t len)
+{
+    fds_record_desc_t  desc   = {0};
+    fds_find_token_t   tok    = {0};
+    fds_flash_record_t record = {0};
+
+    ret_code_t rc = fds_record_find(CONFIG_FILE, RESUME_REC_KEY, &desc, &tok);
+    if (rc != NRF_SUCCESS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    rc = fds_record_open(&desc, &record);
+    if (rc != NRF_SUCCESS)
+    {
+        return rc;
+    }
+
+    // A record of another cache size is not used.
+    if (record.p_header->length_words != (len + 3) / sizeof(uint32_t))
+    {
+        rc = NRF_ERROR_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(p_data, record.p_data, len);
+    }
+
+    UNUSED_RETURN_VALUE(fds_record_close(&desc));
+
+    return rc;
+}
+
 const char * flash_mgr_get_device_name()
 {
     return (const char *)m_configuration.device_name;
@@ -163,6 +411,56 @@ const uint8_t * flash_mgr_get_encryption_key()
     */
 }
 
+uint32_t flash_mgr_get_uart_baud_rate()
+{
+    return m_configuration.uart_baud_rate;
+}
+
+uint8_t flash_mgr_get_uart_stop_bits()
+{
+    return m_configuration.uart_stop_bits;
+}
+
+uint8_t flash_mgr_get_uart_parity()
+{
+    return m_configuration.uart_parity;
+}
+
+uint8_t flash_mgr_get_data_mode()
+{
+    return m_configuration.data_mode;
+}
+
+uint16_t flash_mgr_get_idle_gap_ms()
+{
+    return m_configuration.idle_gap_ms;
+}
+
+uint8_t flash_mgr_get_coalesce_policy()
+{
+    return m_configuration.coalesce_policy;
+}
+
+uint16_t flash_mgr_get_coalesce_delay_ms()
+{
+    return m_configuration.coalesce_delay_ms;
+}
+
+uint8_t flash_mgr_get_cipher()
+{
+    return m_configuration.cipher;
+}
+
+uint8_t flash_mgr_get_psk_mode()
+{
+    return m_configuration.psk_mode;
+}
+
+uint8_t flash_mgr_get_curve()
+{
+    return m_configuration.curve;
+}
+
 ret_code_t flash_mgr_save()
 {
     NRF_LOG_DEBUG("flash_mgr_save");
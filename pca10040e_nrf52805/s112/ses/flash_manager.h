@@ -4,15 +4,31 @@
 #include "nrf.h"
 
 
-/* A dummy structure to save in flash. */
+#define UART_PARITY_NONE    0
+#define UART_PARITY_ODD     1
+#define UART_PARITY_EVEN    2
+
+/* A dummy structure to save in flash.
+ * New fields are only ever appended, records written by older firmware are shorter and the
+ * missing fields keep their defaults. */
 typedef struct
 {    
     char        device_name[16];
     uint8_t     encryption_key[32];    
+    uint32_t    uart_baud_rate;     /**< Baud rate in bits per second. */
+    uint8_t     uart_stop_bits;
+    uint8_t     uart_parity;        /**< One of the UART_PARITY_ values. */
+    uint8_t     data_mode;          /**< UART framing, a uart_framing_mode_t value. */
+    uint16_t    idle_gap_ms;        /**< Line idle time that ends a frame in transparent mode. */
+    uint8_t     coalesce_policy;    /**< When frames are packed into one notification, a ble_coalesce_policy_t value. */
+    uint16_t    coalesce_delay_ms;  /**< Longest time a partly filled notification may wait. */
+    uint8_t     cipher;             /**< Record cipher, a crypto_session_cipher_t value. */
+    uint8_t     psk_mode;           /**< 1 to start sessions with the pre-shared key handshake instead of ECDH. */
+    uint8_t     curve;              /**< Curve of the ECDH key exchanges this device starts, a key_exchange_curve_t value. */
 } configuration_t;
 
 
-ret_code_t flash_mgr_init();
+ret_code_t flash_mgr_flash_mgr_init();
 ret_code_t flash_mgr_write_record(uint32_t fid,
                                   uint32_t key,
                                   void const * p_data,
@@ -24,9 +40,36 @@ ret_code_t flash_mgr_save();
 
 ret_code_t flash_mgr_set_device_name(char * device_name);
 ret_code_t flash_mgr_set_encryption_key(uint8_t * encryption_key, int len);
+ret_code_t flash_mgr_set_uart_config(uint32_t baud_rate, uint8_t stop_bits, uint8_t parity);
+ret_code_t flash_mgr_set_data_mode(uint8_t data_mode, uint16_t idle_gap_ms);
+ret_code_t flash_mgr_set_coalesce(uint8_t policy, uint16_t delay_ms);
+ret_code_t flash_mgr_set_cipher(uint8_t cipher);
+ret_code_t flash_mgr_set_psk_mode(uint8_t psk_mode);
+ret_code_t flash_mgr_set_curve(uint8_t curve);
+
+/* Called when a resumption record write has completed, with NRF_SUCCESS or the fds error. */
+typedef void (*flash_mgr_done_handler_t)(ret_code_t result);
+
+/* Session resumption cache, kept in a record of its own so it is not rewritten with the
+ * configuration. fds reads p_data until done is called, so it must not change before that. When
+ * the flash is full, the space of replaced records is garbage collected first. Returns
+ * NRF_ERROR_BUSY while an earlier write has not completed, done is not called for an error
+ * returned here. */
+ret_code_t flash_mgr_set_resumption(void const * p_data, uint32_t len, flash_mgr_done_handler_t done);
+ret_code_t flash_mgr_get_resumption(void * p_data, uint32_t len);
 
 const char * flash_mgr_get_device_name();
 const uint8_t * flash_mgr_get_encryption_key();
+uint32_t flash_mgr_get_uart_baud_rate();
+uint8_t flash_mgr_get_uart_stop_bits();
+uint8_t flash_mgr_get_uart_parity();
+uint8_t flash_mgr_get_data_mode();
+uint16_t flash_mgr_get_idle_gap_ms();
+uint8_t flash_mgr_get_coalesce_policy();
+uint16_t flash_mgr_get_coalesce_delay_ms();
+uint8_t flash_mgr_get_cipher();
+uint8_t flash_mgr_get_psk_mode();
+uint8_t flash_mgr_get_curve();
 
 
 #endif //FLASH_MGR_H
@@ -0,0 +1,60 @@
+#include "flow_ctrl.h"
+
+#include <stddef.h>
+
+static void state_set(flow_ctrl_t * p_flow, bool paused)
+{
+    if (p_flow->paused != paused)
+    {
+        p_flow->paused = paused;
+        if (p_flow->handler != NULL)
+        {
+            p_flow->handler(paused, p_flow->p_context);
+        }
+    }
+}
+
+void flow_ctrl_init(flow_ctrl_t *       p_flow,
+                    uint32_t            high,
+                    uint32_t            low,
+                    flow_ctrl_handler_t handler,
+                    void *              p_context)
+{
+    p_flow->handler   = handler;
+    p_flow->p_context = p_context;
+    p_flow->high      = high;
+    p_flow->low       = low;
+    p_flow->level     = 0;
+    p_flow->level_max = 0;
+    p_flow->paused    = false;
+}
+
+void flow_ctrl_add(flow_ctrl_t * p_flow, uint32_t bytes)
+{
+    p_flow->level += bytes;
+    if (p_flow->level > p_flow->level_max)
+    {
+        p_flow->level_max = p_flow->level;
+    }
+
+    if (p_flow->level >= p_flow->high)
+    {
+        state_set(p_flow, true);
+    }
+}
+
+void flow_ctrl_remove(flow_ctrl_t * p_flow, uint32_t bytes)
+{
+    p_flow->level = (bytes < p_flow->level) ? (p_flow->level - bytes) : 0;
+
+    if (p_flow->level <= p_flow->low)
+    {
+        state_set(p_flow, false);
+    }
+}
+
+void flow_ctrl_reset(flow_ctrl_t * p_flow)
+{
+    p_flow->level = 0;
+    state_set(p_flow, false);
+}
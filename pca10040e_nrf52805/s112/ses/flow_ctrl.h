@@ -0,0 +1,51 @@
+#ifndef FLOW_CTRL_H
+#define FLOW_CTRL_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Called when the producer must stop (@p paused true) or may continue (@p paused false). */
+typedef void (*flow_ctrl_handler_t)(bool paused, void * p_context);
+
+/**@brief High/low watermark state.
+ *
+ * @details The level is the number of bytes that have been accepted from the producer but not yet
+ *          drained by the consumer. The producer is paused when the level reaches the high
+ *          watermark and resumed once it has dropped to the low watermark. The module has no
+ *          hardware dependencies; callers that add and remove from different interrupt levels
+ *          must serialize the calls.
+ */
+typedef struct
+{
+    flow_ctrl_handler_t handler;
+    void *              p_context;
+    uint32_t            high;       /**< Pause at or above this level. */
+    uint32_t            low;        /**< Resume at or below this level. */
+    uint32_t            level;      /**< Bytes queued but not drained. */
+    uint32_t            level_max;  /**< Highest level seen since init. */
+    bool                paused;
+} flow_ctrl_t;
+
+/**@brief Initialize the watermark state, with the producer running.
+ *
+ * @param[out] p_flow     Watermark state.
+ * @param[in]  high       High watermark, in bytes.
+ * @param[in]  low        Low watermark, in bytes. Must be lower than @p high.
+ * @param[in]  handler    Called on every pause and resume.
+ * @param[in]  p_context  Passed to @p handler.
+ */
+void flow_ctrl_init(flow_ctrl_t *       p_flow,
+                    uint32_t            high,
+                    uint32_t            low,
+                    flow_ctrl_handler_t handler,
+                    void *              p_context);
+
+/**@brief Account for @p bytes handed to the consumer. May pause the producer. */
+void flow_ctrl_add(flow_ctrl_t * p_flow, uint32_t bytes);
+
+/**@brief Account for @p bytes drained by the consumer. May resume the producer. */
+void flow_ctrl_remove(flow_ctrl_t * p_flow, uint32_t bytes);
+
+/**@brief Drop everything queued, for example on disconnect. Resumes the producer if paused. */
+void flow_ctrl_reset(flow_ctrl_t * p_flow);
+
+#endif //FLOW_CTRL_H
@@ -0,0 +1,66 @@
+#include "frame_pool.h"
+
+#include "nordic_common.h"
+#include "nrf_atomic.h"
+#include "nrf_assert.h"
+
+STATIC_ASSERT(FRAME_POOL_BLOCK_COUNT <= 32);
+STATIC_ASSERT((FRAME_POOL_BLOCK_SIZE % sizeof(uint32_t)) == 0);
+
+#define ALL_BLOCKS_FREE     ((FRAME_POOL_BLOCK_COUNT == 32) ? UINT32_MAX : ((1uL << FRAME_POOL_BLOCK_COUNT) - 1))
+
+static uint32_t         m_blocks[FRAME_POOL_BLOCK_COUNT][FRAME_POOL_BLOCK_SIZE / sizeof(uint32_t)];
+static nrf_atomic_u32_t m_free_mask = ALL_BLOCKS_FREE;  /**< Bit n is set while block n is free. */
+static nrf_atomic_u32_t m_in_use;
+static nrf_atomic_u32_t m_in_use_max;
+static nrf_atomic_u32_t m_alloc_failed;
+
+uint8_t * frame_pool_alloc(void)
+{
+    uint32_t mask = m_free_mask;
+    uint32_t bit;
+
+    // Claim the lowest free block. If an interrupt claims or frees a block in between, the
+    // exchange fails, mask is reloaded and the claim is retried.
+    do
+    {
+        if (mask == 0)
+        {
+            UNUSED_RETURN_VALUE(nrf_atomic_u32_add(&m_alloc_failed, 1));
+            return NULL;
+        }
+
+        bit = mask & (0u - mask);
+    } while (!nrf_atomic_u32_cmp_exch(&m_free_mask, &mask, mask & ~bit));
+
+    uint32_t in_use = nrf_atomic_u32_add(&m_in_use, 1);
+    uint32_t max    = m_in_use_max;
+    while ((in_use > max) && !nrf_atomic_u32_cmp_exch(&m_in_use_max, &max, in_use))
+    {
+    }
+
+    return (uint8_t *)m_blocks[__builtin_ctz(bit)];
+}
+
+void frame_pool_free(uint8_t * p_block)
+{
+    // Any address inside the block identifies it.
+    size_t index = ((uint32_t *)p_block - m_blocks[0]) / ARRAY_SIZE(m_blocks[0]);
+
+    ASSERT(index < FRAME_POOL_BLOCK_COUNT);
+
+    UNUSED_RETURN_VALUE(nrf_atomic_u32_sub(&m_in_use, 1));
+
+    // The double free check uses the mask the block was freed into, so a free from an interrupt
+    // in between cannot hide it.
+    uint32_t mask = nrf_atomic_u32_fetch_or(&m_free_mask, 1uL << index);
+    ASSERT((mask & (1uL << index)) == 0);
+    UNUSED_VARIABLE(mask);
+}
+
+void frame_pool_stats_get(frame_pool_stats_t * p_stats)
+{
+    p_stats->in_use       = (uint8_t)m_in_use;
+    p_stats->in_use_max   = (uint8_t)m_in_use_max;
+    p_stats->alloc_failed = m_alloc_failed;
+}
@@ -0,0 +1,43 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+#define FRAME_POOL_BLOCK_SIZE   248     /**< A full NUS payload, or a full payload after COBS encoding. */
+#define FRAME_POOL_BLOCK_COUNT  8       /**< Size with the in_use_max statistic, see @ref frame_pool_stats_get. */
+
+/**@brief Pool statistics. */
+typedef struct
+{
+    uint8_t  in_use;        /**< Blocks allocated now. */
+    uint8_t  in_use_max;    /**< Most blocks allocated at once. */
+    uint32_t alloc_failed;  /**< Allocations refused because every block was in use. */
+} frame_pool_stats_t;
+
+/**@brief Take a block from the pool.
+ *
+ * @details Lock free and O(1), so it can be called from any interrupt level without masking
+ *          interrupts. Blocks pass between the UART and BLE interrupts and the main loop stages
+ *          without being copied. The caller owns the block until it hands it on, for example
+ *          to @ref uart_dma_send, or returns it with @ref frame_pool_free.
+ *
+ * @return A block of @ref FRAME_POOL_BLOCK_SIZE bytes, or NULL if every block is in use.
+ */
+uint8_t * frame_pool_alloc(void);
+
+/**@brief Return a block to the pool. Lock free, can be called from any interrupt level.
+ *
+ * @param[in] p_block  The block, or any address inside it.
+ */
+void frame_pool_free(uint8_t * p_block);
+
+/**@brief Read the pool statistics.
+ *
+ * @details The most blocks in use at once shows how far @ref FRAME_POOL_BLOCK_COUNT can be reduced
+ *          to free RAM, failed allocations show that it is too small.
+ */
+void frame_pool_stats_get(frame_pool_stats_t * p_stats);
+
+#endif //FRAME_POOL_H
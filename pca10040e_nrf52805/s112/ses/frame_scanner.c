@@ -0,0 +1,142 @@
+#include "frame_scanner.h"
+
+#include <string.h>
+
+#define TRAILER_0   0xA5
+#define TRAILER_1   0xA6
+#define TRAILER_2   0xA7
+
+/* Last trailer byte replicated into every byte lane of a word. */
+#define TRAILER_2_WORD  (0x01010101UL * TRAILER_2)
+
+/**@brief Check if any byte of @p word equals the last trailer byte. */
+static inline bool word_has_trailer_byte(uint32_t word)
+{
+    uint32_t x = word ^ TRAILER_2_WORD;
+    return ((x - 0x01010101UL) & ~x & 0x80808080UL) != 0;
+}
+
+/**@brief Byte at @p index - @p back, reaching into the previous chunk when needed. */
+static inline uint8_t byte_before(frame_scanner_t const * p_scanner,
+                                  uint8_t const *         p_chunk,
+                                  size_t                  index,
+                                  size_t                  back)
+{
+    if (index >= back)
+    {
+        return p_chunk[index - back];
+    }
+    return p_scanner->tail[sizeof(p_scanner->tail) - (back - index)];
+}
+
+static void frame_emit(frame_scanner_t * p_scanner,
+                       uint8_t const *   p_chunk,
+                       size_t            start,
+                       size_t            end,
+                       size_t            trim,
+                       bool              complete)
+{
+    frame_desc_t desc =
+    {
+        .offset   = (uint16_t)start,
+        .length   = (uint16_t)(end - start),
+        .trim     = (uint8_t)trim,
+        .complete = complete,
+    };
+
+    p_scanner->handler(p_chunk, &desc, p_scanner->p_context);
+}
+
+void frame_scanner_init(frame_scanner_t * p_scanner,
+                        uint16_t          max_len,
+                        frame_scanner_handler_t handler,
+                        void *            p_context)
+{
+    memset(p_scanner, 0, sizeof(*p_scanner));
+
+    p_scanner->handler   = handler;
+    p_scanner->p_context = p_context;
+    p_scanner->max_len   = max_len;
+}
+
+void frame_scanner_max_len_set(frame_scanner_t * p_scanner, uint16_t max_len)
+{
+    p_scanner->max_len = max_len;
+}
+
+void frame_scanner_reset(frame_scanner_t * p_scanner)
+{
+    p_scanner->frame_len = 0;
+    memset(p_scanner->tail, 0, sizeof(p_scanner->tail));
+}
+
+void frame_scanner_scan(frame_scanner_t * p_scanner, uint8_t const * p_chunk, size_t length)
+{
+    size_t start = 0;   // Start of the current frame's data in this chunk.
+    size_t i     = 0;
+
+    while (i < length)
+    {
+        // Skip whole words that cannot hold the end of a frame.
+        if ((((uintptr_t)(p_chunk + i) & (sizeof(uint32_t) - 1)) == 0) &&
+            (length - i >= sizeof(uint32_t)) &&
+            (p_scanner->frame_len + sizeof(uint32_t) < p_scanner->max_len))
+        {
+            uint32_t word;
+            memcpy(&word, p_chunk + i, sizeof(word));
+            if (!word_has_trailer_byte(word))
+            {
+                i                    += sizeof(uint32_t);
+                p_scanner->frame_len += sizeof(uint32_t);
+                continue;
+            }
+        }
+
+        p_scanner->frame_len++;
+
+        if ((p_chunk[i] == TRAILER_2) &&
+            (p_scanner->frame_len >= FRAME_SCANNER_TRAILER_LEN) &&
+            (byte_before(p_scanner, p_chunk, i, 1) == TRAILER_1) &&
+            (byte_before(p_scanner, p_chunk, i, 2) == TRAILER_0))
+        {
+            // The trailer may have started in an earlier chunk.
+            size_t trailer_start = i + 1;
+            size_t trim          = 0;
+
+            if (trailer_start - start >= FRAME_SCANNER_TRAILER_LEN)
+            {
+                trailer_start -= FRAME_SCANNER_TRAILER_LEN;
+            }
+            else
+            {
+                trim          = FRAME_SCANNER_TRAILER_LEN - (trailer_start - start);
+                trailer_start = start;
+            }
+
+            frame_emit(p_scanner, p_chunk, start, trailer_start, trim, true);
+
+            p_scanner->frame_len = 0;
+            start                = i + 1;
+        }
+        else if (p_scanner->frame_len >= p_scanner->max_len)
+        {
+            frame_emit(p_scanner, p_chunk, start, i + 1, 0, true);
+
+            p_scanner->frame_len = 0;
+            start                = i + 1;
+        }
+
+        i++;
+    }
+
+    if (start < length)
+    {
+        frame_emit(p_scanner, p_chunk, start, length, 0, false);
+    }
+
+    // Remember the end of the stream so a trailer split over two chunks is still found.
+    for (size_t k = sizeof(p_scanner->tail); k > 0; k--)
+    {
+        p_scanner->tail[sizeof(p_scanner->tail) - k] = byte_before(p_scanner, p_chunk, length, k);
+    }
+}
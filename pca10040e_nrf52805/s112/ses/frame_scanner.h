@@ -0,0 +1,62 @@
+#ifndef FRAME_SCANNER_H
+#define FRAME_SCANNER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_SCANNER_TRAILER_LEN   3       /**< Length of the 0xA5 0xA6 0xA7 frame trailer. */
+
+/**@brief Position of frame data inside the chunk that is being scanned.
+ *
+ * @details A frame that spans several chunks is reported as one or more partial descriptors
+ *          followed by a complete one. The trailer is never part of @p length. If the trailer
+ *          itself was split over two chunks, its first bytes were already reported as frame
+ *          data and @p trim tells how many bytes to drop from the end of the frame.
+ */
+typedef struct
+{
+    uint16_t offset;    /**< Offset of the frame data in the chunk. */
+    uint16_t length;    /**< Number of frame data bytes at @p offset. */
+    uint8_t  trim;      /**< Bytes to remove from data reported with earlier chunks. */
+    bool     complete;  /**< The frame ends in this chunk. */
+} frame_desc_t;
+
+typedef void (*frame_scanner_handler_t)(uint8_t const * p_chunk, frame_desc_t const * p_desc, void * p_context);
+
+/**@brief Streaming frame scanner state. */
+typedef struct
+{
+    frame_scanner_handler_t handler;
+    void *                  p_context;
+    uint16_t                max_len;    /**< Frames are cut at this length if no trailer is seen. */
+    uint16_t                frame_len;  /**< Bytes of the current frame seen so far. */
+    uint8_t                 tail[FRAME_SCANNER_TRAILER_LEN - 1]; /**< Last bytes of the previous chunk. */
+} frame_scanner_t;
+
+/**@brief Initialize a scanner.
+ *
+ * @param[out] p_scanner  Scanner state.
+ * @param[in]  max_len    Maximum frame length, trailer included.
+ * @param[in]  handler    Called for every frame descriptor.
+ * @param[in]  p_context  Passed to @p handler.
+ */
+void frame_scanner_init(frame_scanner_t * p_scanner,
+                        uint16_t          max_len,
+                        frame_scanner_handler_t handler,
+                        void *            p_context);
+
+/**@brief Change the maximum frame length. Takes effect for the frame in progress. */
+void frame_scanner_max_len_set(frame_scanner_t * p_scanner, uint16_t max_len);
+
+/**@brief Drop the frame in progress. */
+void frame_scanner_reset(frame_scanner_t * p_scanner);
+
+/**@brief Scan the next chunk of the byte stream.
+ *
+ * @details The chunk is searched a word at a time for the last trailer byte, so the per-byte
+ *          cost is only paid around candidate trailers. All descriptors reference @p p_chunk,
+ *          which is not copied.
+ */
+void frame_scanner_scan(frame_scanner_t * p_scanner, uint8_t const * p_chunk, size_t length);
+
+#endif //FRAME_SCANNER_H
@@ -0,0 +1,612 @@
+#include "key_exchange.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "app_timer.h"
+#include "nrf_crypto.h"
+#include "nrf_crypto_ecc.h"
+#include "nrf_crypto_ecdh.h"
+#include "nrf_crypto_hkdf.h"
+#include "nrf_crypto_rng.h"
+#include "crypto_session.h"
+#include "resume_cache.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+STATIC_ASSERT(sizeof(nrf_crypto_ecc_secp256r1_raw_public_key_t) == KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE);
+STATIC_ASSERT(sizeof(nrf_crypto_ecdh_secp256r1_shared_secret_t) == KEY_EXCHANGE_SECRET_SIZE);
+STATIC_ASSERT(sizeof(nrf_crypto_ecc_curve25519_raw_public_key_t) == KEY_EXCHANGE_X25519_PUBLIC_KEY_SIZE);
+STATIC_ASSERT(sizeof(nrf_crypto_ecdh_curve25519_shared_secret_t) == KEY_EXCHANGE_SECRET_SIZE);
+STATIC_ASSERT(sizeof(nrf_crypto_ecc_curve25519_raw_private_key_t) == sizeof(nrf_crypto_ecc_secp256r1_raw_private_key_t));
+STATIC_ASSERT(KEY_EXCHANGE_SECRET_SIZE == CRYPTO_SESSION_KEY_SIZE);
+
+#define HKDF_INFO_RESUMPTION    "MEGO resumption v1"
+#define HKDF_INFO_RESUME        "MEGO resume v1"
+#define HKDF_INFO_PSK           "MEGO psk v1"
+
+/**@brief Steps of a key exchange job, run in this order. */
+typedef enum
+{
+    KEY_EXCHANGE_IDLE,
+    KEY_EXCHANGE_PEER_KEY,      /**< Load and check the peer public key. */
+    KEY_EXCHANGE_SHARED_SECRET, /**< ECDH point multiplication. */
+    KEY_EXCHANGE_SESSION_KEYS,  /**< Expand the CBC receive key and derive the CTR/CCM keys. */
+} key_exchange_step_t;
+
+/**@brief Key pair as kept in the pool, the private key raw, the public key as sent on the air. */
+typedef struct
+{
+    nrf_crypto_ecc_secp256r1_raw_private_key_t private_key;
+    uint8_t                                    public_key[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];
+} key_pair_t;
+
+static key_pair_t                                 m_pool[KEY_EXCHANGE_POOL_SIZE];
+static uint8_t                                    m_pool_count;
+static key_exchange_curve_t                       m_pool_curve = KEY_EXCHANGE_CURVE_DEFAULT;
+
+static nrf_crypto_ecc_private_key_t               m_private_key;      /**< Key pair of the current session. */
+static uint8_t                                    m_raw_public_key[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];
+static key_exchange_curve_t                       m_session_curve;
+static bool                                       m_has_pair;
+
+static key_exchange_step_t                        m_step = KEY_EXCHANGE_IDLE;
+static key_exchange_done_t                        m_done;
+static uint32_t                                   m_start_ticks;
+static uint8_t                                    m_peer_raw_key[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];   /**< In nrf_crypto byte order. */
+static nrf_crypto_ecc_public_key_t                m_peer_public_key;
+static nrf_crypto_ecdh_secp256r1_shared_secret_t  m_shared_secret;
+static key_exchange_stats_t                       m_stats;
+static uint8_t                                    m_psk_nonce[KEY_EXCHANGE_NONCE_SIZE];   /**< Our nonce of a pre-shared key handshake we started. */
+static uint32_t                                   m_psk_start_ticks;
+static bool                                       m_psk_pending;
+
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000) / APP_TIMER_CLOCK_FREQ);
+}
+
+static uint32_t us_since(uint32_t ticks)
+{
+    return ticks_to_us(app_timer_cnt_diff_compute(app_timer_cnt_get(), ticks));
+}
+
+/**@brief Get the nrf_crypto curve, NULL if it is not compiled in. */
+static nrf_crypto_ecc_curve_info_t const * curve_info_get(key_exchange_curve_t curve)
+{
+    switch (curve)
+    {
+        case KEY_EXCHANGE_CURVE_SECP256R1:
+            return &g_nrf_crypto_ecc_secp256r1_curve_info;
+
+#if NRF_CRYPTO_ECC_CURVE25519_ENABLED
+        case KEY_EXCHANGE_CURVE_X25519:
+            return &g_nrf_crypto_ecc_curve25519_curve_info;
+#endif
+
+        default:
+            return NULL;
+    }
+}
+
+/**@brief Copy a key or secret between the nrf_crypto raw format and the air, in either direction.
+ *
+ * @details X25519 values are little endian on the air, as in RFC 7748. nrf_crypto keeps them in
+ *          the same order unless NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED is set. secp256r1 is big
+ *          endian on both sides.
+ */
+static ret_code_t air_order_copy(key_exchange_curve_t curve, uint8_t const * p_in, uint8_t * p_out, size_t size)
+{
+#if NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED
+    if (curve == KEY_EXCHANGE_CURVE_X25519)
+    {
+        return nrf_crypto_ecc_byte_order_invert(curve_info_get(curve), p_in, p_out, size);
+    }
+#else
+    UNUSED_PARAMETER(curve);
+#endif
+
+    memcpy(p_out, p_in, size);
+
+    return NRF_SUCCESS;
+}
+
+/**@brief HKDF-SHA256 extract and expand, with a context on the stack. */
+static ret_code_t hkdf(uint8_t * p_out, size_t out_size,
+                       uint8_t const * p_key, size_t key_size,
+                       uint8_t const * p_salt, size_t salt_size,
+                       char const * p_info)
+{
+    nrf_crypto_hmac_context_t hmac_ctx;
+    size_t                    size = out_size;
+
+    ret_code_t err_code = nrf_crypto_hkdf_calculate(&hmac_ctx,
+                                                    &g_nrf_crypto_hmac_sha256_info,
+                                                    p_out,
+                                                    &size,
+                                                    p_key,
+                                                    key_size,
+                                                    p_salt,
+                                                    salt_size,
+                                                    (uint8_t const *)p_info,
+                                                    strlen(p_info),
+                                                    NRF_CRYPTO_HKDF_EXTRACT_AND_EXPAND);
+    memset(&hmac_ctx, 0, sizeof(hmac_ctx));
+
+    return err_code;
+}
+
+/**@brief Set the session keys from a shared secret, the last step of a full or resumed key exchange. */
+static ret_code_t session_keys_set(uint8_t const * p_secret)
+{
+    // CBC receives with the raw secret as the android app does, CTR and CCM use keys derived from
+    // it once.
+    ret_code_t err_code = crypto_session_key_set(CRYPTO_SESSION_RX, p_secret);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = crypto_session_secret_set(p_secret, KEY_EXCHANGE_SECRET_SIZE);
+    }
+
+    return err_code;
+}
+
+/**@brief Remember the session of a full key exchange for resumption. */
+static void session_remember(uint8_t const * p_secret)
+{
+    uint8_t okm[RESUME_CACHE_ID_SIZE + RESUME_CACHE_SECRET_SIZE];
+
+    if (hkdf(okm, sizeof(okm), p_secret, KEY_EXCHANGE_SECRET_SIZE, NULL, 0, HKDF_INFO_RESUMPTION) == NRF_SUCCESS)
+    {
+        resume_cache_put(okm, okm + RESUME_CACHE_ID_SIZE);
+    }
+
+    memset(okm, 0, sizeof(okm));
+}
+
+/**@brief Derive the shared secret from the pre-shared key and both nonces, and set the session keys. */
+static ret_code_t psk_session_set(uint8_t const * p_psk,
+                                  uint8_t const * p_request_nonce,
+                                  uint8_t const * p_response_nonce,
+                                  uint32_t        start_ticks)
+{
+    uint8_t    salt[2 * KEY_EXCHANGE_NONCE_SIZE];
+    ret_code_t err_code;
+
+    memcpy(salt, p_request_nonce, KEY_EXCHANGE_NONCE_SIZE);
+    memcpy(salt + KEY_EXCHANGE_NONCE_SIZE, p_response_nonce, KEY_EXCHANGE_NONCE_SIZE);
+
+    err_code = hkdf(m_shared_secret, sizeof(m_shared_secret),
+                    p_psk, KEY_EXCHANGE_PSK_SIZE,
+                    salt, sizeof(salt), HKDF_INFO_PSK);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = session_keys_set(m_shared_secret);
+    }
+
+    memset(m_shared_secret, 0, sizeof(m_shared_secret));
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("key_exchange, psk failed. error: 0x%x.", err_code);
+        return err_code;
+    }
+
+    uint32_t latency = us_since(start_ticks);
+
+    m_stats.psk++;
+    m_stats.psk_last_us = latency;
+    if (latency > m_stats.psk_max_us)
+    {
+        m_stats.psk_max_us = latency;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Generate a key pair for the pool. */
+static ret_code_t pair_generate(key_exchange_curve_t curve, key_pair_t * p_pair)
+{
+    nrf_crypto_ecc_curve_info_t const * p_curve_info = curve_info_get(curve);
+    nrf_crypto_ecc_private_key_t        private_key;
+    nrf_crypto_ecc_public_key_t         public_key;
+    uint8_t                             raw_public_key[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];
+    size_t                              private_size = sizeof(p_pair->private_key);
+    size_t                              public_size  = key_exchange_public_key_size(curve);
+    ret_code_t                          err_code;
+
+    if (p_curve_info == NULL)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    err_code = nrf_crypto_ecc_key_pair_generate(NULL, p_curve_info, &private_key, &public_key);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = nrf_crypto_ecc_private_key_to_raw(&private_key, p_pair->private_key, &private_size);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = nrf_crypto_ecc_public_key_to_raw(&public_key, raw_public_key, &public_size);
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = air_order_copy(curve, raw_public_key, p_pair->public_key, public_size);
+    }
+
+    UNUSED_RETURN_VALUE(nrf_crypto_ecc_private_key_free(&private_key));
+    UNUSED_RETURN_VALUE(nrf_crypto_ecc_public_key_free(&public_key));
+
+    return err_code;
+}
+
+/**@brief Make sure the current session has a key pair, taking the next one from the pool. */
+static ret_code_t pair_take(key_exchange_curve_t curve)
+{
+    key_pair_t pair;
+    ret_code_t err_code = NRF_SUCCESS;
+
+    if (m_has_pair)
+    {
+        // Both sides sent a request, on different curves.
+        return (curve == m_session_curve) ? NRF_SUCCESS : NRF_ERROR_INVALID_PARAM;
+    }
+
+    if ((m_pool_count > 0) && (m_pool_curve == curve))
+    {
+        m_pool_count--;
+        pair = m_pool[m_pool_count];
+        memset(&m_pool[m_pool_count], 0, sizeof(m_pool[m_pool_count]));
+        m_stats.pool_hits++;
+    }
+    else
+    {
+        err_code = pair_generate(curve, &pair);
+        m_stats.pool_misses++;
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = nrf_crypto_ecc_private_key_from_raw(curve_info_get(curve),
+                                                       &m_private_key,
+                                                       pair.private_key,
+                                                       sizeof(pair.private_key));
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        memcpy(m_raw_public_key, pair.public_key, sizeof(m_raw_public_key));
+        m_session_curve = curve;
+        m_has_pair      = true;
+    }
+    else
+    {
+        NRF_LOG_ERROR("key_exchange, no key pair. error: 0x%x.", err_code);
+    }
+
+    memset(&pair, 0, sizeof(pair));
+
+    return err_code;
+}
+
+/**@brief End the job, wiping the secret and the peer key, and report the result. */
+static void job_end(ret_code_t result)
+{
+    uint32_t latency = us_since(m_start_ticks);
+
+    memset(m_shared_secret, 0, sizeof(m_shared_secret));
+    memset(m_peer_raw_key, 0, sizeof(m_peer_raw_key));
+    m_step = KEY_EXCHANGE_IDLE;
+
+    m_stats.completed++;
+    if (result != NRF_SUCCESS)
+    {
+        m_stats.failed++;
+    }
+    m_stats.latency_last_us = latency;
+    if (latency > m_stats.latency_max_us)
+    {
+        m_stats.latency_max_us = latency;
+    }
+
+    m_done(result, latency);
+}
+
+/**@brief Run the current step and move on to the next one. */
+static void step_run(void)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    size_t     size;
+    uint32_t   step_start = app_timer_cnt_get();
+
+    switch (m_step)
+    {
+        case KEY_EXCHANGE_PEER_KEY:
+            err_code = nrf_crypto_ecc_public_key_from_raw(curve_info_get(m_session_curve),
+                                                          &m_peer_public_key,
+                                                          m_peer_raw_key,
+                                                          key_exchange_public_key_size(m_session_curve));
+            m_step = KEY_EXCHANGE_SHARED_SECRET;
+            break;
+
+        case KEY_EXCHANGE_SHARED_SECRET:
+        {
+            uint8_t raw_secret[KEY_EXCHANGE_SECRET_SIZE];
+
+            size     = sizeof(raw_secret);
+            err_code = nrf_crypto_ecdh_compute(NULL,
+                                               &m_private_key,
+                                               &m_peer_public_key,
+                                               raw_secret,
+                                               &size);
+            if (err_code == NRF_SUCCESS)
+            {
+                err_code = air_order_copy(m_session_curve, raw_secret, m_shared_secret, sizeof(raw_secret));
+            }
+            memset(raw_secret, 0, sizeof(raw_secret));
+            UNUSED_RETURN_VALUE(nrf_crypto_ecc_public_key_free(&m_peer_public_key));
+            m_step = KEY_EXCHANGE_SESSION_KEYS;
+            break;
+        }
+
+        case KEY_EXCHANGE_SESSION_KEYS:
+            err_code = session_keys_set(m_shared_secret);
+            if (err_code == NRF_SUCCESS)
+            {
+                session_remember(m_shared_secret);
+            }
+            m_step = KEY_EXCHANGE_IDLE;
+            break;
+
+        default:
+            return;
+    }
+
+    uint32_t step_us = us_since(step_start);
+    if (step_us > m_stats.step_max_us)
+    {
+        m_stats.step_max_us = step_us;
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("key_exchange, step failed. error: 0x%x.", err_code);
+        job_end(err_code);
+    }
+    else if (m_step == KEY_EXCHANGE_IDLE)
+    {
+        job_end(NRF_SUCCESS);
+    }
+}
+
+size_t key_exchange_public_key_size(key_exchange_curve_t curve)
+{
+    switch (curve)
+    {
+        case KEY_EXCHANGE_CURVE_SECP256R1:
+            return KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE;
+
+        case KEY_EXCHANGE_CURVE_X25519:
+            return KEY_EXCHANGE_X25519_PUBLIC_KEY_SIZE;
+
+        default:
+            return 0;
+    }
+}
+
+ret_code_t key_exchange_curve_from_size(size_t key_size, key_exchange_curve_t * p_curve)
+{
+    switch (key_size)
+    {
+        case KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE:
+            *p_curve = KEY_EXCHANGE_CURVE_SECP256R1;
+            return NRF_SUCCESS;
+
+        case KEY_EXCHANGE_X25519_PUBLIC_KEY_SIZE:
+            *p_curve = KEY_EXCHANGE_CURVE_X25519;
+            return NRF_SUCCESS;
+
+        default:
+            return NRF_ERROR_INVALID_LENGTH;
+    }
+}
+
+uint8_t const * key_exchange_public_key_get(key_exchange_curve_t curve)
+{
+    return (pair_take(curve) == NRF_SUCCESS) ? m_raw_public_key : NULL;
+}
+
+bool key_exchange_pool_fill(key_exchange_curve_t curve)
+{
+    if (curve != m_pool_curve)
+    {
+        memset(m_pool, 0, sizeof(m_pool));
+        m_pool_count = 0;
+        m_pool_curve = curve;
+    }
+
+    if ((m_step != KEY_EXCHANGE_IDLE) || (m_pool_count >= KEY_EXCHANGE_POOL_SIZE))
+    {
+        return false;
+    }
+
+    key_pair_t pair;
+    ret_code_t err_code = pair_generate(curve, &pair);
+    if (err_code != NRF_SUCCESS)
+    {
+        // Retried on the next call, a session generates its own pair meanwhile.
+        NRF_LOG_ERROR("key_exchange, pool fill failed. error: 0x%x.", err_code);
+        return false;
+    }
+
+    m_pool[m_pool_count++] = pair;
+    memset(&pair, 0, sizeof(pair));
+
+    return (m_pool_count < KEY_EXCHANGE_POOL_SIZE);
+}
+
+void key_exchange_session_end(void)
+{
+    if (m_step == KEY_EXCHANGE_SHARED_SECRET)
+    {
+        UNUSED_RETURN_VALUE(nrf_crypto_ecc_public_key_free(&m_peer_public_key));
+    }
+    m_step = KEY_EXCHANGE_IDLE;
+    memset(m_shared_secret, 0, sizeof(m_shared_secret));
+    memset(m_peer_raw_key, 0, sizeof(m_peer_raw_key));
+
+    m_psk_pending = false;
+    memset(m_psk_nonce, 0, sizeof(m_psk_nonce));
+
+    if (m_has_pair)
+    {
+        UNUSED_RETURN_VALUE(nrf_crypto_ecc_private_key_free(&m_private_key));
+        memset(m_raw_public_key, 0, sizeof(m_raw_public_key));
+        m_has_pair = false;
+    }
+}
+
+ret_code_t key_exchange_start(key_exchange_curve_t curve, uint8_t const * p_peer_key, key_exchange_done_t done)
+{
+    if (m_step != KEY_EXCHANGE_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    ret_code_t err_code = pair_take(curve);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = air_order_copy(curve, p_peer_key, m_peer_raw_key, key_exchange_public_key_size(curve));
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_done        = done;
+    m_start_ticks = app_timer_cnt_get();
+    m_step        = KEY_EXCHANGE_PEER_KEY;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t key_exchange_resume(uint8_t const * p_session_id, uint8_t const * p_peer_nonce, uint8_t * p_nonce)
+{
+    uint8_t    resumption_secret[RESUME_CACHE_SECRET_SIZE];
+    uint8_t    salt[2 * KEY_EXCHANGE_NONCE_SIZE];
+    uint32_t   start_ticks = app_timer_cnt_get();
+    ret_code_t err_code;
+
+    if (m_step != KEY_EXCHANGE_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    err_code = resume_cache_get(p_session_id, resumption_secret);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_stats.resume_misses++;
+        return err_code;
+    }
+
+    err_code = nrf_crypto_rng_vector_generate(p_nonce, KEY_EXCHANGE_NONCE_SIZE);
+    if (err_code == NRF_SUCCESS)
+    {
+        memcpy(salt, p_peer_nonce, KEY_EXCHANGE_NONCE_SIZE);
+        memcpy(salt + KEY_EXCHANGE_NONCE_SIZE, p_nonce, KEY_EXCHANGE_NONCE_SIZE);
+
+        err_code = hkdf(m_shared_secret, sizeof(m_shared_secret),
+                        resumption_secret, sizeof(resumption_secret),
+                        salt, sizeof(salt), HKDF_INFO_RESUME);
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = session_keys_set(m_shared_secret);
+    }
+
+    memset(resumption_secret, 0, sizeof(resumption_secret));
+    memset(m_shared_secret, 0, sizeof(m_shared_secret));
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("key_exchange, resume failed. error: 0x%x.", err_code);
+        return err_code;
+    }
+
+    uint32_t latency = us_since(start_ticks);
+
+    m_stats.resumed++;
+    m_stats.resume_last_us = latency;
+    if (latency > m_stats.resume_max_us)
+    {
+        m_stats.resume_max_us = latency;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t key_exchange_psk_respond(uint8_t const * p_psk, uint8_t const * p_peer_nonce, uint8_t * p_nonce)
+{
+    uint32_t   start_ticks = app_timer_cnt_get();
+    ret_code_t err_code;
+
+    if (m_step != KEY_EXCHANGE_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    err_code = nrf_crypto_rng_vector_generate(p_nonce, KEY_EXCHANGE_NONCE_SIZE);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return psk_session_set(p_psk, p_peer_nonce, p_nonce, start_ticks);
+}
+
+ret_code_t key_exchange_psk_request(uint8_t * p_nonce)
+{
+    ret_code_t err_code = nrf_crypto_rng_vector_generate(m_psk_nonce, sizeof(m_psk_nonce));
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    memcpy(p_nonce, m_psk_nonce, sizeof(m_psk_nonce));
+    m_psk_start_ticks = app_timer_cnt_get();
+    m_psk_pending     = true;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t key_exchange_psk_complete(uint8_t const * p_psk, uint8_t const * p_peer_nonce)
+{
+    if (!m_psk_pending)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_psk_pending = false;
+
+    ret_code_t err_code = psk_session_set(p_psk, m_psk_nonce, p_peer_nonce, m_psk_start_ticks);
+    memset(m_psk_nonce, 0, sizeof(m_psk_nonce));
+
+    return err_code;
+}
+
+void key_exchange_process(void)
+{
+    step_run();
+}
+
+bool key_exchange_is_busy(void)
+{
+    return (m_step != KEY_EXCHANGE_IDLE);
+}
+
+void key_exchange_stats_get(key_exchange_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
@@ -0,0 +1,183 @@
+#ifndef KEY_EXCHANGE_H
+#define KEY_EXCHANGE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "sdk_config.h"
+
+#define KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE   64  /**< Raw secp256r1 public key, X and Y big endian. */
+#define KEY_EXCHANGE_X25519_PUBLIC_KEY_SIZE 32  /**< X25519 public key, little endian as in RFC 7748. */
+#define KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE    KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE
+#define KEY_EXCHANGE_SECRET_SIZE        32      /**< ECDH shared secret, the X coordinate for secp256r1, RFC 7748 byte order for X25519. */
+#define KEY_EXCHANGE_NONCE_SIZE         16      /**< Nonce of each side in a resumption or a pre-shared key handshake. */
+#define KEY_EXCHANGE_PSK_SIZE           32      /**< Pre-shared key, the key stored in flash. */
+
+/**@brief Curves of the ECDH key exchange, told apart on the air by the size of the public key. */
+typedef enum
+{
+    KEY_EXCHANGE_CURVE_SECP256R1 = 0,
+    KEY_EXCHANGE_CURVE_X25519    = 1,
+} key_exchange_curve_t;
+
+/* CC310 does secp256r1 in hardware. Elsewhere a freshly provisioned device offers X25519, one
+ * configured before the curve could be chosen keeps secp256r1, see flash_mgr_flash_mgr_init. */
+#ifndef KEY_EXCHANGE_CURVE_DEFAULT
+#if NRF_CRYPTO_BACKEND_CC310_ENABLED
+#define KEY_EXCHANGE_CURVE_DEFAULT      KEY_EXCHANGE_CURVE_SECP256R1
+#else
+#define KEY_EXCHANGE_CURVE_DEFAULT      KEY_EXCHANGE_CURVE_X25519
+#endif
+#endif
+
+#ifndef KEY_EXCHANGE_POOL_SIZE
+#define KEY_EXCHANGE_POOL_SIZE          2       /**< Key pairs generated ahead, 96 bytes each. */
+#endif
+
+/**@brief Handshake statistics, all times from @ref key_exchange_start to the end of the job. */
+typedef struct
+{
+    uint32_t completed;         /**< Key exchanges finished, successful or not. */
+    uint32_t failed;            /**< Key exchanges that ended with an error. */
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint32_t step_max_us;       /**< Longest single step, the longest the main loop was held. */
+    uint32_t pool_hits;         /**< Sessions that took a key pair generated ahead. */
+    uint32_t pool_misses;       /**< Sessions that had to generate their key pair on the spot. */
+    uint32_t resumed;           /**< Sessions resumed without ECDH. */
+    uint32_t resume_misses;     /**< Resumptions refused, the session was not in the cache. */
+    uint32_t resume_last_us;
+    uint32_t resume_max_us;
+    uint32_t psk;               /**< Sessions set up with the pre-shared key. */
+    uint32_t psk_last_us;       /**< From the request, or from our nonce to the end of the derivation. */
+    uint32_t psk_max_us;
+} key_exchange_stats_t;
+
+/**@brief Called in the main loop when a key exchange job has ended.
+ *
+ * @param[in] result      NRF_SUCCESS if the session keys are set, otherwise the error of the
+ *                        failing step. The previous session keys are kept then.
+ * @param[in] latency_us  Time since @ref key_exchange_start.
+ */
+typedef void (*key_exchange_done_t)(ret_code_t result, uint32_t latency_us);
+
+/**@brief Get the size of a public key on the air, 0 for an unknown curve. */
+size_t key_exchange_public_key_size(key_exchange_curve_t curve);
+
+/**@brief Find the curve of a public key from its size.
+ *
+ * @retval NRF_SUCCESS              @p p_curve set.
+ * @retval NRF_ERROR_INVALID_LENGTH No curve has keys of this size.
+ */
+ret_code_t key_exchange_curve_from_size(size_t key_size, key_exchange_curve_t * p_curve);
+
+/**@brief Get the public key of the current session, @ref key_exchange_public_key_size bytes.
+ *
+ * @details The first call of a session takes a fresh key pair from the pool, or generates one if
+ *          the pool is empty or holds pairs of the other curve. The pair is kept until
+ *          @ref key_exchange_session_end.
+ *
+ * @return The public key, or NULL if no key pair could be generated or the session already has a
+ *         pair of the other curve.
+ */
+uint8_t const * key_exchange_public_key_get(key_exchange_curve_t curve);
+
+/**@brief Generate one key pair for the pool if it is not full. Call from the main loop while idle.
+ *
+ * @details Key generation takes as long as an ECDH computation, so one pair is made per call and
+ *          none while a key exchange is running. The pool holds pairs of one curve, asking for the
+ *          other one empties it first. nrf_crypto must be initialized first.
+ *
+ * @return true while the pool is still not full.
+ */
+bool key_exchange_pool_fill(key_exchange_curve_t curve);
+
+/**@brief End the session, for example on disconnect.
+ *
+ * @details A running key exchange is dropped without calling its handler, as is a pre-shared key
+ *          handshake waiting for its answer. The key pair of the session is wiped, so the next
+ *          session takes a new one.
+ */
+void key_exchange_session_end(void);
+
+/**@brief Start computing the session keys from the public key of the peer.
+ *
+ * @details The work is split into steps that @ref key_exchange_process runs one at a time, so the
+ *          main loop keeps draining the UART and BLE queues between them. The steps are loading
+ *          the peer key, the ECDH point multiplication and the key derivation of
+ *          @ref crypto_session_secret_set. The point multiplication is one nrf_crypto call and
+ *          cannot be split further, it is the step reported in @ref key_exchange_stats_t::step_max_us.
+ *
+ * @param[in] curve       Curve of the peer key, the session key pair must be on the same one.
+ * @param[in] p_peer_key  Public key of the peer, @ref key_exchange_public_key_size bytes, copied.
+ * @param[in] done        Called when the job has ended.
+ *
+ * @retval NRF_SUCCESS              Job started.
+ * @retval NRF_ERROR_BUSY           A key exchange is already running.
+ * @retval NRF_ERROR_INVALID_PARAM  The session already has a key pair of the other curve.
+ * @return Otherwise the error from generating the key pair of the session.
+ */
+ret_code_t key_exchange_start(key_exchange_curve_t curve, uint8_t const * p_peer_key, key_exchange_done_t done);
+
+/**@brief Resume a session of a full key exchange, with symmetric crypto only.
+ *
+ * @details Every full key exchange leaves a session in @ref resume_cache: HKDF-SHA256 of the
+ *          shared secret, no salt, info "MEGO resumption v1", gives [session ID][resumption secret],
+ *          which the central derives as well. Resuming derives a new shared secret, HKDF-SHA256 of
+ *          the resumption secret with [peer nonce][own nonce] as salt and info "MEGO resume v1",
+ *          and sets the session keys from it as a full key exchange does. The resumption secret
+ *          is kept, so a session can be resumed again.
+ *
+ * @param[in]  p_session_id  @ref RESUME_CACHE_ID_SIZE bytes.
+ * @param[in]  p_peer_nonce  @ref KEY_EXCHANGE_NONCE_SIZE random bytes of the central.
+ * @param[out] p_nonce       @ref KEY_EXCHANGE_NONCE_SIZE random bytes to send back.
+ *
+ * @retval NRF_SUCCESS          Session keys set.
+ * @retval NRF_ERROR_BUSY       A full key exchange is running.
+ * @retval NRF_ERROR_NOT_FOUND  Unknown session, a full key exchange is needed.
+ * @return Otherwise the error from the RNG or the key derivation.
+ */
+ret_code_t key_exchange_resume(uint8_t const * p_session_id, uint8_t const * p_peer_nonce, uint8_t * p_nonce);
+
+/**@brief Answer a pre-shared key handshake of the peer.
+ *
+ * @details The shared secret is HKDF-SHA256 of the pre-shared key with [requester nonce]
+ *          [responder nonce] as salt and info "MEGO psk v1", the session keys are set from it as a
+ *          full key exchange does. There is no public key math, and no forward secrecy either: the
+ *          sessions are only as safe as the pre-shared key.
+ *
+ * @param[in]  p_psk         @ref KEY_EXCHANGE_PSK_SIZE bytes.
+ * @param[in]  p_peer_nonce  @ref KEY_EXCHANGE_NONCE_SIZE random bytes of the peer.
+ * @param[out] p_nonce       @ref KEY_EXCHANGE_NONCE_SIZE random bytes to send back.
+ *
+ * @retval NRF_SUCCESS      Session keys set.
+ * @retval NRF_ERROR_BUSY   A full key exchange is running.
+ * @return Otherwise the error from the RNG or the key derivation.
+ */
+ret_code_t key_exchange_psk_respond(uint8_t const * p_psk, uint8_t const * p_peer_nonce, uint8_t * p_nonce);
+
+/**@brief Start a pre-shared key handshake, see @ref key_exchange_psk_respond.
+ *
+ * @param[out] p_nonce  @ref KEY_EXCHANGE_NONCE_SIZE random bytes to send, kept until
+ *                      @ref key_exchange_psk_complete.
+ */
+ret_code_t key_exchange_psk_request(uint8_t * p_nonce);
+
+/**@brief Complete a pre-shared key handshake started with @ref key_exchange_psk_request.
+ *
+ * @retval NRF_SUCCESS              Session keys set.
+ * @retval NRF_ERROR_INVALID_STATE  No handshake was started.
+ * @return Otherwise the error from the key derivation.
+ */
+ret_code_t key_exchange_psk_complete(uint8_t const * p_psk, uint8_t const * p_peer_nonce);
+
+/**@brief Run the next step of a running key exchange. Call from the main loop. */
+void key_exchange_process(void);
+
+/**@brief Check if a key exchange is running. */
+bool key_exchange_is_busy(void);
+
+/**@brief Read the handshake statistics. */
+void key_exchange_stats_get(key_exchange_stats_t * p_stats);
+
+#endif //KEY_EXCHANGE_H
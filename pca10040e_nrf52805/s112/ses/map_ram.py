@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""RAM use of one or more builds, read from the linker map files SEGGER Embedded Studio writes.
+
+    python3 map_ram.py Output/Release/Exe/*.map Output/Bench/Exe/*.map
+
+For every build it prints the .data and .bss totals, the heap, the stack, the RAM reserved for
+the SoftDevice and what is left free, and the objects with the most .data and .bss. With more
+than one map it also prints the totals side by side, and per object what each build adds to or
+takes from the first one, for example what the Bench build costs over Release.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+OUTPUT_SECTION = re.compile(r'^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(.*))?$')
+INPUT_SECTION  = re.compile(r'^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*))?$')
+CONTINUATION   = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*?))?\s*$')
+MEMORY_REGION  = re.compile(r'^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)')
+
+# Sections placed in RAM without initial data that are reported on their own, not as .bss.
+SOFTDEVICE = ('.reserved_ram',)
+HEAP       = ('.heap',)
+STACK      = ('.stack', '.stack_process')
+
+
+class Build:
+    def __init__(self, path):
+        self.path     = path
+        self.name     = build_name(path)
+        self.regions  = {}  # RAM region name: (origin, length)
+        self.sections = {}  # Output section in RAM: (size, initialized)
+        self.objects  = {}  # Object file: {'data': bytes, 'bss': bytes}
+
+    def in_ram(self, address):
+        return any(origin <= address < origin + length for origin, length in self.regions.values())
+
+    def kind(self, section):
+        size, initialized = self.sections[section]
+        if section in SOFTDEVICE:
+            return 'softdevice'
+        if section in HEAP:
+            return 'heap'
+        if section in STACK:
+            return 'stack'
+        return 'data' if initialized else 'bss'
+
+    def total(self, kind):
+        return sum(size for section, (size, _) in self.sections.items() if self.kind(section) == kind)
+
+    def ram_size(self):
+        return sum(length for _, length in self.regions.values())
+
+
+def build_name(path):
+    """The configuration directory under Output, as SES lays out its builds, or the file name."""
+    parts = os.path.normpath(path).split(os.sep)
+    if 'Output' in parts and parts.index('Output') + 1 < len(parts) - 1:
+        return parts[parts.index('Output') + 1]
+    return os.path.splitext(os.path.basename(path))[0]
+
+
+def object_name(path):
+    """main.o for a path, libc.a(memcpy.o) for an archive member."""
+    match = re.match(r'^(.*?)(\([^)]*\))?$', path.strip())
+    return os.path.basename(match.group(1)) + (match.group(2) or '')
+
+
+def parse(path):
+    build = Build(path)
+
+    with open(path, encoding='utf-8', errors='replace') as f:
+        lines = f.read().splitlines()
+
+    try:
+        memory = lines.index('Memory Configuration')
+        script = lines.index('Linker script and memory map')
+    except ValueError:
+        sys.exit('%s: not a GNU ld map file' % path)
+
+    for line in lines[memory:script]:
+        match = MEMORY_REGION.match(line)
+        if match and 'RAM' in match.group(1).upper():
+            build.regions[match.group(1)] = (int(match.group(2), 16), int(match.group(3), 16))
+
+    section = None          # Output section the input sections belong to, None if not in RAM.
+    pending_output = None   # Output section name on a line of its own, address on the next.
+    pending_input  = None   # The same for an input section.
+
+    for line in lines[script:]:
+        if pending_output is not None:
+            match = CONTINUATION.match(line)
+            name, pending_output = pending_output, None
+            if match:
+                section = add_section(build, name, match.group(1), match.group(2), match.group(3) or '')
+            continue
+
+        if pending_input is not None:
+            match = CONTINUATION.match(line)
+            name, pending_input = pending_input, None
+            if match and match.group(3) and (section is not None):
+                add_input(build, section, match.group(2), match.group(3))
+            continue
+
+        match = OUTPUT_SECTION.match(line)
+        if match:
+            if match.group(2) is None:
+                pending_output = match.group(1)
+            else:
+                section = add_section(build, match.group(1), match.group(2), match.group(3), match.group(4))
+            continue
+
+        if section is None:
+            continue
+
+        if line.startswith(' *fill*'):
+            match = CONTINUATION.match(line[len(' *fill*'):])
+            if match:
+                add_input(build, section, match.group(2), '(fill)')
+            continue
+
+        match = INPUT_SECTION.match(line)
+        if match and not match.group(1).startswith('*'):
+            if match.group(2) is None:
+                pending_input = match.group(1)
+            else:
+                add_input(build, section, match.group(3), match.group(4))
+
+    return build
+
+
+def add_section(build, name, address, size, rest):
+    address = int(address, 16)
+    size    = int(size, 16)
+    if not build.in_ram(address):
+        return None
+    build.sections[name] = (size, 'load address' in rest)
+    return name
+
+
+def add_input(build, section, size, path):
+    kind = build.kind(section)
+    if kind not in ('data', 'bss'):
+        return
+    counts = build.objects.setdefault(object_name(path), {'data': 0, 'bss': 0})
+    counts[kind] += int(size, 16)
+
+
+def report(build, top):
+    data       = build.total('data')
+    bss        = build.total('bss')
+    heap       = build.total('heap')
+    stack      = build.total('stack')
+    softdevice = build.total('softdevice')
+    ram        = build.ram_size()
+
+    print('%s (%s)' % (build.name, build.path))
+    for kind, total in (('data', data), ('bss', bss)):
+        parts = ', '.join('%s %d' % (section, size) for section, (size, _) in sorted(build.sections.items())
+                          if size and build.kind(section) == kind)
+        print('  .%-10s %6d  %s' % (kind, total, parts))
+    print('  %-11s %6d' % ('heap', heap))
+    print('  %-11s %6d' % ('stack', stack))
+    print('  %-11s %6d  below the application RAM start' % ('softdevice', softdevice))
+    print('  %-11s %6d  of %d, %d free' % ('total', data + bss + heap + stack + softdevice, ram,
+                                           ram - (data + bss + heap + stack + softdevice)))
+
+    print('  largest .data + .bss:')
+    largest = sorted(build.objects.items(), key=lambda item: -(item[1]['data'] + item[1]['bss']))
+    for name, counts in largest[:top]:
+        print('    %6d  %-32s .data %d, .bss %d' % (counts['data'] + counts['bss'], name, counts['data'], counts['bss']))
+    print()
+
+
+def compare(builds):
+    base = builds[0]
+    kinds = ('data', 'bss', 'heap', 'stack')
+
+    print('%-12s %8s %8s %8s %8s %8s' % (('build',) + tuple('.' + kind if kind in ('data', 'bss') else kind
+                                                            for kind in kinds) + ('total',)))
+    for build in builds:
+        totals = [build.total(kind) for kind in kinds]
+        print('%-12s %8d %8d %8d %8d %8d' % ((build.name,) + tuple(totals) + (sum(totals),)))
+    print()
+
+    for build in builds[1:]:
+        names = sorted(set(base.objects) | set(build.objects))
+        changes = []
+        for name in names:
+            before = base.objects.get(name, {'data': 0, 'bss': 0})
+            after  = build.objects.get(name, {'data': 0, 'bss': 0})
+            delta  = (after['data'] - before['data'], after['bss'] - before['bss'])
+            if delta != (0, 0):
+                changes.append((name, delta))
+
+        print('%s over %s, .data + .bss per object:' % (build.name, base.name))
+        if not changes:
+            print('    no change')
+        for name, (data, bss) in sorted(changes, key=lambda change: -abs(sum(change[1]))):
+            print('    %+6d  %-32s .data %+d, .bss %+d' % (data + bss, name, data, bss))
+        print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('maps', nargs='+', help='linker map files, the first is the base of the comparison')
+    parser.add_argument('-n', '--top', type=int, default=10, help='objects listed per build (default 10)')
+    args = parser.parse_args()
+
+    builds = [parse(path) for path in args.maps]
+    for build in builds:
+        report(build, args.top)
+    if len(builds) > 1:
+        compare(builds)
+
+
+if __name__ == '__main__':
+    main()
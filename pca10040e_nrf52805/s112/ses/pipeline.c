@@ -0,0 +1,136 @@
+#include "pipeline.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+typedef struct
+{
+    pipeline_handler_t handler;
+    uint8_t            depth_limit; /**< Most blocks the stage may hold. */
+    pipeline_stats_t   stats;
+} pipeline_stage_cb_t;
+
+static pipeline_stage_cb_t m_stages[PIPELINE_STAGE_COUNT] =
+{
+    [PIPELINE_STAGE_UART_RX] = {.depth_limit = PIPELINE_UART_RX_DEPTH},
+    [PIPELINE_STAGE_BLE_RX]  = {.depth_limit = PIPELINE_BLE_RX_DEPTH},
+};
+
+STATIC_ASSERT(PIPELINE_SLOT_SIZE <= FRAME_POOL_BLOCK_SIZE);
+
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000) / APP_TIMER_CLOCK_FREQ);
+}
+
+/**@brief Scheduler handler, runs one queued item in the main loop. */
+static void pipeline_sched_handler(void * p_event_data, uint16_t event_size)
+{
+    pipeline_desc_t const * p_desc  = p_event_data;
+    pipeline_stage_cb_t *   p_stage = &m_stages[p_desc->stage];
+
+    UNUSED_PARAMETER(event_size);
+
+    uint32_t latency = ticks_to_us(app_timer_cnt_diff_compute(app_timer_cnt_get(), p_desc->timestamp));
+
+    p_stage->handler(p_desc->p_data, p_desc->length);
+
+    CRITICAL_REGION_ENTER();
+
+    p_stage->stats.depth--;
+    p_stage->stats.processed++;
+    p_stage->stats.latency_last_us = latency;
+    if (latency > p_stage->stats.latency_max_us)
+    {
+        p_stage->stats.latency_max_us = latency;
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+void pipeline_stage_init(pipeline_stage_t stage, pipeline_handler_t handler)
+{
+    m_stages[stage].handler = handler;
+}
+
+ret_code_t pipeline_put(pipeline_stage_t stage, uint8_t const * p_data, size_t length)
+{
+    pipeline_stage_cb_t * p_stage = &m_stages[stage];
+    pipeline_desc_t       desc;
+    ret_code_t            err_code = NRF_ERROR_NO_MEM;
+
+    if (length > PIPELINE_SLOT_SIZE)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    desc.p_data = NULL;
+
+    CRITICAL_REGION_ENTER();
+
+    if (p_stage->stats.depth < p_stage->depth_limit)
+    {
+        desc.p_data = frame_pool_alloc();
+    }
+
+    if (desc.p_data != NULL)
+    {
+        p_stage->stats.depth++;
+        if (p_stage->stats.depth > p_stage->stats.depth_max)
+        {
+            p_stage->stats.depth_max = p_stage->stats.depth;
+        }
+        err_code = NRF_SUCCESS;
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        p_stage->stats.dropped++;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // The block is owned by this call until it is queued, so it is filled outside the critical region.
+    memcpy(desc.p_data, p_data, length);
+
+    desc.stage     = (uint8_t)stage;
+    desc.length    = (uint16_t)length;
+    desc.timestamp = app_timer_cnt_get();
+
+    // The queue has room for every stage at its depth, so this cannot fail.
+    err_code = app_sched_event_put(&desc, sizeof(desc), pipeline_sched_handler);
+    APP_ERROR_CHECK(err_code);
+
+    return NRF_SUCCESS;
+}
+
+void pipeline_pause(void)
+{
+    // The scheduler only carries pipeline items, and checks for a pause before every item.
+    app_sched_pause();
+}
+
+void pipeline_resume(void)
+{
+    app_sched_resume();
+}
+
+void pipeline_stats_get(pipeline_stage_t stage, pipeline_stats_t * p_stats)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stats = m_stages[stage].stats;
+    CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,79 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "frame_pool.h"
+
+#define PIPELINE_SLOT_SIZE          244     /**< Largest payload a stage can carry, the maximum NUS payload. */
+#define PIPELINE_UART_RX_DEPTH      3       /**< Frames received over UART waiting to be encrypted and sent. */
+#define PIPELINE_BLE_RX_DEPTH       3       /**< BLE packets waiting to be decrypted and written to UART. */
+
+/* Scheduler sizing, for APP_SCHED_INIT. Every queued block needs one scheduler event. */
+#define PIPELINE_SCHED_EVENT_SIZE   sizeof(pipeline_desc_t)
+#define PIPELINE_SCHED_QUEUE_SIZE   (PIPELINE_UART_RX_DEPTH + PIPELINE_BLE_RX_DEPTH)
+
+/**@brief Pipeline stages. Interrupt handlers put work in, the main loop processes it.
+ *
+ * @details Every stage carries its data in frame pool blocks, which its handler owns and must hand
+ *          on or free. The depth of a stage limits how many blocks it may hold, so one direction
+ *          cannot take the whole pool.
+ */
+typedef enum
+{
+    PIPELINE_STAGE_UART_RX,     /**< UART frame to encrypt and send over BLE. */
+    PIPELINE_STAGE_BLE_RX,      /**< BLE packet to decrypt and write to UART. */
+    PIPELINE_STAGE_COUNT
+} pipeline_stage_t;
+
+/**@brief Descriptor passed through the scheduler queue. */
+typedef struct
+{
+    uint8_t   stage;
+    uint16_t  length;
+    uint32_t  timestamp;    /**< app_timer counter when the work was queued. */
+    uint8_t * p_data;
+} pipeline_desc_t;
+
+/**@brief Per-stage statistics. */
+typedef struct
+{
+    uint16_t depth;             /**< Items queued now. */
+    uint16_t depth_max;         /**< Most items queued at once. */
+    uint32_t processed;         /**< Items processed. */
+    uint32_t dropped;           /**< Items dropped because the stage or the pool was full. */
+    uint32_t latency_last_us;   /**< Time from queuing to processing for the last item. */
+    uint32_t latency_max_us;    /**< Longest time from queuing to processing. */
+} pipeline_stats_t;
+
+/**@brief Stage handler, runs in the main loop.
+ *
+ * @details @p p_data is a frame pool block of @ref FRAME_POOL_BLOCK_SIZE bytes that the handler
+ *          now owns, so it can be worked on in place and handed on without a copy.
+ */
+typedef void (*pipeline_handler_t)(uint8_t * p_data, size_t length);
+
+/**@brief Set the handler of a stage. The scheduler must be initialized first. */
+void pipeline_stage_init(pipeline_stage_t stage, pipeline_handler_t handler);
+
+/**@brief Copy data into a pool block and queue it on @p stage. Can be called from any interrupt level.
+ *
+ * @retval NRF_SUCCESS              Queued.
+ * @retval NRF_ERROR_INVALID_LENGTH @p length is larger than @ref PIPELINE_SLOT_SIZE.
+ * @retval NRF_ERROR_NO_MEM         The stage is at its depth or the pool is empty, the data was dropped.
+ */
+ret_code_t pipeline_put(pipeline_stage_t stage, uint8_t const * p_data, size_t length);
+
+/**@brief Hold every stage. Items keep being queued, up to the stage depths, and wait in order
+ *        until @ref pipeline_resume. Call from the main loop, once per @ref pipeline_resume.
+ */
+void pipeline_pause(void);
+
+/**@brief Process the items held by @ref pipeline_pause again. */
+void pipeline_resume(void);
+
+/**@brief Read the statistics of a stage. */
+void pipeline_stats_get(pipeline_stage_t stage, pipeline_stats_t * p_stats);
+
+#endif //PIPELINE_H
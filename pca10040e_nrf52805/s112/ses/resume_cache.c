@@ -0,0 +1,168 @@
+#include "resume_cache.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "flash_manager.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+typedef struct
+{
+    uint8_t id[RESUME_CACHE_ID_SIZE];
+    uint8_t secret[RESUME_CACHE_SECRET_SIZE];
+} resume_cache_entry_t;
+
+/* Word aligned, it is also the flash record. */
+typedef struct
+{
+    uint32_t             count;
+    resume_cache_entry_t entries[RESUME_CACHE_SIZE];    /**< Most recently used first. */
+} resume_cache_t;
+
+static resume_cache_t m_cache;
+
+#if RESUME_CACHE_FLASH
+/* The cache as last handed to fds. fds writes from it later, so it is only changed once the write
+ * has completed. */
+static resume_cache_t m_saved;
+static bool           m_saved_valid;    /**< m_saved is what flash holds, or is being written. */
+static bool           m_saving;         /**< fds is writing m_saved. */
+static bool           m_save_again;     /**< The cache changed while m_saved was written. */
+
+static void cache_save(void);
+
+static void cache_saved(ret_code_t result)
+{
+    m_saving = false;
+    if (result != NRF_SUCCESS)
+    {
+        m_saved_valid = false;
+        NRF_LOG_WARNING("resume_cache, save failed. error: 0x%x.", result);
+    }
+
+    if (m_save_again)
+    {
+        m_save_again = false;
+        cache_save();
+    }
+}
+#endif
+
+/**@brief Write the cache to flash, if enabled and it differs from what flash holds. */
+static void cache_save(void)
+{
+#if RESUME_CACHE_FLASH
+    if (m_saving)
+    {
+        m_save_again = true;
+        return;
+    }
+
+    // Putting the most recent session again, or clearing an empty cache, writes nothing.
+    if (m_saved_valid && (memcmp(&m_saved, &m_cache, sizeof(m_cache)) == 0))
+    {
+        return;
+    }
+
+    m_saved       = m_cache;
+    m_saved_valid = true;
+    m_saving      = true;
+
+    ret_code_t err_code = flash_mgr_set_resumption(&m_saved, sizeof(m_saved), cache_saved);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_saving      = false;
+        m_saved_valid = false;
+        NRF_LOG_WARNING("resume_cache, save failed. error: 0x%x.", err_code);
+    }
+#endif
+}
+
+/**@brief Find an entry by ID. */
+static int cache_find(uint8_t const * p_id)
+{
+    for (uint32_t i = 0; i < m_cache.count; i++)
+    {
+        if (memcmp(m_cache.entries[i].id, p_id, RESUME_CACHE_ID_SIZE) == 0)
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/**@brief Move entry @p index to the front, shifting the more recent ones back by one. */
+static void cache_touch(uint32_t index)
+{
+    resume_cache_entry_t entry = m_cache.entries[index];
+
+    memmove(&m_cache.entries[1], &m_cache.entries[0], index * sizeof(entry));
+    m_cache.entries[0] = entry;
+    memset(&entry, 0, sizeof(entry));
+}
+
+void resume_cache_init(void)
+{
+#if RESUME_CACHE_FLASH
+    if ((flash_mgr_get_resumption(&m_cache, sizeof(m_cache)) != NRF_SUCCESS) ||
+        (m_cache.count > RESUME_CACHE_SIZE))
+    {
+        memset(&m_cache, 0, sizeof(m_cache));
+        return;
+    }
+
+    m_saved       = m_cache;
+    m_saved_valid = true;
+#endif
+}
+
+void resume_cache_put(uint8_t const * p_id, uint8_t const * p_secret)
+{
+    int index = cache_find(p_id);
+
+    if (index < 0)
+    {
+        // The least recently used entry is overwritten when the cache is full.
+        if (m_cache.count < RESUME_CACHE_SIZE)
+        {
+            m_cache.count++;
+        }
+        index = m_cache.count - 1;
+    }
+
+    memcpy(m_cache.entries[index].id, p_id, RESUME_CACHE_ID_SIZE);
+    memcpy(m_cache.entries[index].secret, p_secret, RESUME_CACHE_SECRET_SIZE);
+    cache_touch(index);
+
+    cache_save();
+}
+
+ret_code_t resume_cache_get(uint8_t const * p_id, uint8_t * p_secret)
+{
+    int index = cache_find(p_id);
+
+    if (index < 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    if (index > 0)
+    {
+        cache_touch(index);
+        cache_save();
+    }
+    memcpy(p_secret, m_cache.entries[0].secret, RESUME_CACHE_SECRET_SIZE);
+
+    return NRF_SUCCESS;
+}
+
+void resume_cache_clear(void)
+{
+    memset(&m_cache, 0, sizeof(m_cache));
+
+    cache_save();
+}
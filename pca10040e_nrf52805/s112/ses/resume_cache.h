@@ -0,0 +1,52 @@
+#ifndef RESUME_CACHE_H
+#define RESUME_CACHE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+#define RESUME_CACHE_ID_SIZE        8       /**< Session ID a central resumes with. */
+#define RESUME_CACHE_SECRET_SIZE    32      /**< Resumption secret, never sent. */
+
+#ifndef RESUME_CACHE_SIZE
+#define RESUME_CACHE_SIZE           2       /**< Sessions kept, 40 bytes each. */
+#endif
+
+/* The resumption secrets are written to flash in plaintext, like the AES key of flash_manager.
+ * Anyone who can read the flash, over SWD without APPROTECT for example, can resume the cached
+ * sessions and derive their keys. */
+#ifndef RESUME_CACHE_FLASH
+#define RESUME_CACHE_FLASH          0       /**< 1 to keep the cache in flash, so sessions survive a reset. */
+#endif
+
+/**@brief Load the cache from flash if @ref RESUME_CACHE_FLASH is set. Call after flash_mgr_flash_mgr_init. */
+void resume_cache_init(void);
+
+/**@brief Remember a session, as the most recently used one.
+ *
+ * @details An entry with the same ID is replaced, otherwise the least recently used entry is
+ *          dropped when the cache is full. With @ref RESUME_CACHE_FLASH the cache is written to
+ *          flash if that changed it.
+ *
+ * @param[in] p_id      @ref RESUME_CACHE_ID_SIZE bytes.
+ * @param[in] p_secret  @ref RESUME_CACHE_SECRET_SIZE bytes.
+ */
+void resume_cache_put(uint8_t const * p_id, uint8_t const * p_secret);
+
+/**@brief Look up a session and make it the most recently used one.
+ *
+ * @details With @ref RESUME_CACHE_FLASH the new order is written to flash if it changed, so the
+ *          session last resumed is still kept after a reset.
+ *
+ * @param[in]  p_id      @ref RESUME_CACHE_ID_SIZE bytes.
+ * @param[out] p_secret  Its resumption secret, @ref RESUME_CACHE_SECRET_SIZE bytes.
+ *
+ * @retval NRF_SUCCESS          Found.
+ * @retval NRF_ERROR_NOT_FOUND  Unknown or dropped session.
+ */
+ret_code_t resume_cache_get(uint8_t const * p_id, uint8_t * p_secret);
+
+/**@brief Forget every session, also in flash. */
+void resume_cache_clear(void);
+
+#endif //RESUME_CACHE_H
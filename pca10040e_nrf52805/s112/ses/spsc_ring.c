@@ -0,0 +1,129 @@
+#include "spsc_ring.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+#include "nrf_assert.h"
+#include "app_util_platform.h"
+
+ret_code_t spsc_ring_init(spsc_ring_t * p_ring, uint8_t * p_buf, size_t size)
+{
+    if ((size == 0) || ((size & (size - 1)) != 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_ring->p_buf = p_buf;
+    p_ring->mask  = size - 1;
+    p_ring->write = 0;
+    p_ring->read  = 0;
+
+    return NRF_SUCCESS;
+}
+
+void spsc_ring_reset(spsc_ring_t * p_ring)
+{
+    p_ring->read = p_ring->write;
+}
+
+size_t spsc_ring_level(spsc_ring_t const * p_ring)
+{
+    return p_ring->write - p_ring->read;
+}
+
+size_t spsc_ring_free(spsc_ring_t const * p_ring)
+{
+    return (p_ring->mask + 1) - spsc_ring_level(p_ring);
+}
+
+size_t spsc_ring_write_span(spsc_ring_t const * p_ring, uint8_t ** pp_span)
+{
+    uint32_t write  = p_ring->write;
+    uint32_t offset = write & p_ring->mask;
+    size_t   free   = (p_ring->mask + 1) - (write - p_ring->read);
+
+    // The consumer has finished with every byte up to the read index it has published.
+    __DMB();
+
+    *pp_span = &p_ring->p_buf[offset];
+    return MIN(free, (p_ring->mask + 1) - offset);
+}
+
+void spsc_ring_write_commit(spsc_ring_t * p_ring, size_t length)
+{
+    ASSERT(length <= spsc_ring_free(p_ring));
+
+    // The bytes must be in memory before the consumer sees the index move.
+    __DMB();
+    p_ring->write += length;
+}
+
+size_t spsc_ring_write(spsc_ring_t * p_ring, uint8_t const * p_data, size_t length)
+{
+    size_t written = 0;
+
+    while (written < length)
+    {
+        uint8_t * p_span;
+        size_t    span_len = spsc_ring_write_span(p_ring, &p_span);
+
+        // Not inside MIN, which evaluates it twice: the consumer may have freed more in between.
+        span_len = MIN(span_len, length - written);
+        if (span_len == 0)
+        {
+            break;
+        }
+
+        memcpy(p_span, p_data + written, span_len);
+        spsc_ring_write_commit(p_ring, span_len);
+        written += span_len;
+    }
+
+    return written;
+}
+
+size_t spsc_ring_read_span(spsc_ring_t const * p_ring, uint8_t const ** pp_span)
+{
+    uint32_t read   = p_ring->read;
+    uint32_t offset = read & p_ring->mask;
+    size_t   level  = p_ring->write - read;
+
+    // Every byte up to the write index the producer has published is in memory.
+    __DMB();
+
+    *pp_span = &p_ring->p_buf[offset];
+    return MIN(level, (p_ring->mask + 1) - offset);
+}
+
+void spsc_ring_read_commit(spsc_ring_t * p_ring, size_t length)
+{
+    ASSERT(length <= spsc_ring_level(p_ring));
+
+    // The bytes must be read before the producer may overwrite them.
+    __DMB();
+    p_ring->read += length;
+}
+
+size_t spsc_ring_read(spsc_ring_t * p_ring, uint8_t * p_data, size_t length)
+{
+    size_t read = 0;
+
+    while (read < length)
+    {
+        uint8_t const * p_span;
+        size_t          span_len = spsc_ring_read_span(p_ring, &p_span);
+
+        // Not inside MIN, the producer may have written more in between.
+        span_len = MIN(span_len, length - read);
+        if (span_len == 0)
+        {
+            break;
+        }
+
+        memcpy(p_data + read, p_span, span_len);
+        spsc_ring_read_commit(p_ring, span_len);
+        read += span_len;
+    }
+
+    return read;
+}
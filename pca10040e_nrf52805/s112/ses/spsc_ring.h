@@ -0,0 +1,86 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "nordic_common.h"
+#include "nrf_atomic.h"
+
+/**@brief Single producer, single consumer byte ring.
+ *
+ * @details One context writes and one other context reads, typically an interrupt handler and
+ *          the main loop, without a critical region on either side. Each side only stores its
+ *          own index and publishes it after a memory barrier, so the other side sees the bytes
+ *          before it sees the index move. The indices run freely and wrap at 2^32, the size must
+ *          be a power of two.
+ *
+ *          Both sides work on whole contiguous spans: @ref spsc_ring_write_span and
+ *          @ref spsc_ring_read_span return the largest region that does not wrap, and the
+ *          matching commit hands the bytes over in one step.
+ */
+typedef struct
+{
+    uint8_t *        p_buf;
+    uint32_t         mask;      /**< Size minus one. */
+    nrf_atomic_u32_t write;     /**< Bytes written since init. Only stored by the producer. */
+    nrf_atomic_u32_t read;      /**< Bytes read since init. Only stored by the consumer. */
+} spsc_ring_t;
+
+/**@brief Define a ring with a buffer of @p _size bytes, a power of two. */
+#define SPSC_RING_DEF(_name, _size)                                         \
+    STATIC_ASSERT(((_size) & ((_size) - 1)) == 0);                          \
+    static uint8_t     CONCAT_2(_name, _buf)[_size];                        \
+    static spsc_ring_t _name = {.p_buf = CONCAT_2(_name, _buf), .mask = (_size) - 1}
+
+/**@brief Initialize an empty ring. Neither side may be using it.
+ *
+ * @retval NRF_SUCCESS              Initialized.
+ * @retval NRF_ERROR_INVALID_PARAM  @p size is not a power of two.
+ */
+ret_code_t spsc_ring_init(spsc_ring_t * p_ring, uint8_t * p_buf, size_t size);
+
+/**@brief Empty the ring. Only the consumer may be using it. */
+void spsc_ring_reset(spsc_ring_t * p_ring);
+
+/**@brief Number of bytes written and not yet read. Either side. */
+size_t spsc_ring_level(spsc_ring_t const * p_ring);
+
+/**@brief Number of bytes that can be written. Either side. */
+size_t spsc_ring_free(spsc_ring_t const * p_ring);
+
+/**@brief Producer: get the largest contiguous free region.
+ *
+ * @param[out] pp_span  Start of the region.
+ *
+ * @return Length of the region, 0 if the ring is full.
+ */
+size_t spsc_ring_write_span(spsc_ring_t const * p_ring, uint8_t ** pp_span);
+
+/**@brief Producer: hand @p length bytes written to the span over to the consumer. */
+void spsc_ring_write_commit(spsc_ring_t * p_ring, size_t length);
+
+/**@brief Producer: copy up to @p length bytes in, in at most two spans.
+ *
+ * @return Number of bytes written, less than @p length if the ring filled up.
+ */
+size_t spsc_ring_write(spsc_ring_t * p_ring, uint8_t const * p_data, size_t length);
+
+/**@brief Consumer: get the largest contiguous region of written bytes.
+ *
+ * @param[out] pp_span  Start of the region.
+ *
+ * @return Length of the region, 0 if the ring is empty.
+ */
+size_t spsc_ring_read_span(spsc_ring_t const * p_ring, uint8_t const ** pp_span);
+
+/**@brief Consumer: release @p length bytes of the span back to the producer. */
+void spsc_ring_read_commit(spsc_ring_t * p_ring, size_t length);
+
+/**@brief Consumer: copy up to @p length bytes out, in at most two spans.
+ *
+ * @return Number of bytes read, less than @p length if the ring ran empty.
+ */
+size_t spsc_ring_read(spsc_ring_t * p_ring, uint8_t * p_data, size_t length);
+
+#endif //SPSC_RING_H
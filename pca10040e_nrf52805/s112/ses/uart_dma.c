@@ -0,0 +1,351 @@
+#include "uart_dma.h"
+
+#include <string.h>
+
+#include "frame_pool.h"
+#include "uart_rx_chunk.h"
+#include "nordic_common.h"
+#include "sdk_macros.h"
+#include "nrfx_uarte.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+static nrfx_uarte_t const m_uarte = NRFX_UARTE_INSTANCE(0);
+
+APP_TIMER_DEF(m_rx_timeout_timer);
+
+static uart_dma_config_t      m_config;             /**< Settings the UARTE is running with. */
+static uart_dma_config_t      m_config_next;        /**< Settings to switch to once the line is quiet. */
+static volatile bool          m_config_pending;
+
+static struct
+{
+    uint32_t             bps;
+    nrf_uarte_baudrate_t baud_rate;
+} const m_baud_rates[] =
+{
+    {1200,    NRF_UARTE_BAUDRATE_1200},
+    {2400,    NRF_UARTE_BAUDRATE_2400},
+    {4800,    NRF_UARTE_BAUDRATE_4800},
+    {9600,    NRF_UARTE_BAUDRATE_9600},
+    {14400,   NRF_UARTE_BAUDRATE_14400},
+    {19200,   NRF_UARTE_BAUDRATE_19200},
+    {28800,   NRF_UARTE_BAUDRATE_28800},
+    {31250,   NRF_UARTE_BAUDRATE_31250},
+    {38400,   NRF_UARTE_BAUDRATE_38400},
+    {56000,   NRF_UARTE_BAUDRATE_56000},
+    {57600,   NRF_UARTE_BAUDRATE_57600},
+    {76800,   NRF_UARTE_BAUDRATE_76800},
+    {115200,  NRF_UARTE_BAUDRATE_115200},
+    {230400,  NRF_UARTE_BAUDRATE_230400},
+    {250000,  NRF_UARTE_BAUDRATE_250000},
+    {460800,  NRF_UARTE_BAUDRATE_460800},
+    {921600,  NRF_UARTE_BAUDRATE_921600},
+    {1000000, NRF_UARTE_BAUDRATE_1000000},
+};
+
+static uart_rx_chunk_t m_rx;
+static uint32_t        m_rx_timeout_ms = UART_DMA_RX_TIMEOUT_MS;
+
+/* Transmit queue. Every frame is a frame pool block, or part of one, that the UARTE sends in
+ * a single transfer and that is freed once the transfer has ended. */
+static struct
+{
+    uint8_t * p_data;
+    uint16_t  length;
+} m_tx_queue[UART_DMA_TX_QUEUE_SIZE];
+static uint8_t m_tx_head;           /**< Index of the oldest frame, the one being sent. */
+static uint8_t m_tx_count;          /**< Number of frames in the queue. */
+
+/**@brief Hand one chunk to the driver. */
+static ret_code_t rx_chunk_arm(uint8_t * p_buf, size_t length)
+{
+    nrfx_err_t err_code = nrfx_uarte_rx(&m_uarte, p_buf, length);
+    if (err_code != NRFX_SUCCESS)
+    {
+        NRF_LOG_ERROR("uart_dma, nrfx_uarte_rx failed. error: 0x%x.", err_code);
+    }
+
+    return err_code;
+}
+
+/**@brief Free the frame that has been sent. Runs in the UARTE interrupt. */
+static void tx_frame_pop(void)
+{
+    frame_pool_free(m_tx_queue[m_tx_head].p_data);
+
+    m_tx_head = (m_tx_head + 1) % UART_DMA_TX_QUEUE_SIZE;
+    m_tx_count--;
+}
+
+/**@brief Send the oldest frame straight from its block if the transmitter is free. */
+static void tx_kick(void)
+{
+    CRITICAL_REGION_ENTER();
+
+    if ((m_tx_count > 0) && !nrfx_uarte_tx_in_progress(&m_uarte))
+    {
+        UNUSED_RETURN_VALUE(nrfx_uarte_tx(&m_uarte,
+                                          m_tx_queue[m_tx_head].p_data,
+                                          m_tx_queue[m_tx_head].length));
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+/**@brief Check if every queued byte has been sent. */
+static bool tx_idle(void)
+{
+    return (m_tx_count == 0) && !nrfx_uarte_tx_in_progress(&m_uarte);
+}
+
+/**@brief Deliver a partially filled chunk once the line has gone quiet.
+ *
+ * @details The UARTE has no receive timeout, so the RXDRDY event register is sampled instead.
+ *          It is set for every received byte even though its interrupt is left disabled.
+ */
+static void rx_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    bool byte_seen = nrf_uarte_event_check(m_uarte.p_reg, NRF_UARTE_EVENT_RXDRDY);
+    if (byte_seen)
+    {
+        nrf_uarte_event_clear(m_uarte.p_reg, NRF_UARTE_EVENT_RXDRDY);
+    }
+
+    if (uart_rx_chunk_idle_check(&m_rx, byte_seen))
+    {
+        nrfx_uarte_rx_abort(&m_uarte);
+    }
+}
+
+static void uarte_evt_handler(nrfx_uarte_event_t const * p_event, void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_event->type)
+    {
+        case NRFX_UARTE_EVT_RX_DONE:
+            uart_rx_chunk_done(&m_rx, p_event->data.rxtx.p_data, p_event->data.rxtx.bytes);
+            break;
+
+        case NRFX_UARTE_EVT_TX_DONE:
+            // Raised on ENDTX, the next frame is started right away.
+            tx_frame_pop();
+            tx_kick();
+            break;
+
+        case NRFX_UARTE_EVT_ERROR:
+            uart_rx_chunk_error(&m_rx, p_event->data.error.error_mask);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**@brief Initialize the UARTE driver with @p p_config and start reception. */
+static ret_code_t uarte_start(uart_dma_config_t const * p_config)
+{
+    ret_code_t err_code;
+
+    uart_rx_chunk_reset(&m_rx);
+
+    nrfx_uarte_config_t config = NRFX_UARTE_DEFAULT_CONFIG;
+    config.pselrxd            = p_config->rx_pin_no;
+    config.pseltxd            = p_config->tx_pin_no;
+    config.pselrts            = p_config->flow_control ? p_config->rts_pin_no : NRF_UARTE_PSEL_DISCONNECTED;
+    config.pselcts            = p_config->flow_control ? p_config->cts_pin_no : NRF_UARTE_PSEL_DISCONNECTED;
+    config.hwfc               = p_config->flow_control ? NRF_UARTE_HWFC_ENABLED : NRF_UARTE_HWFC_DISABLED;
+    config.parity             = p_config->use_parity ? NRF_UARTE_PARITY_INCLUDED : NRF_UARTE_PARITY_EXCLUDED;
+    config.baudrate           = p_config->baud_rate;
+    config.interrupt_priority = p_config->irq_priority;
+
+    err_code = nrfx_uarte_init(&m_uarte, &config, uarte_evt_handler);
+    VERIFY_SUCCESS(err_code);
+
+    m_config = *p_config;
+
+    err_code = app_timer_start(m_rx_timeout_timer, APP_TIMER_TICKS(m_rx_timeout_ms), NULL);
+    VERIFY_SUCCESS(err_code);
+
+    CRITICAL_REGION_ENTER();
+    uart_rx_chunk_arm(&m_rx);
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t uart_dma_init(uart_dma_config_t const * p_config, uart_dma_evt_handler_t evt_handler)
+{
+    ret_code_t err_code;
+
+    if ((p_config == NULL) || (evt_handler == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_config_pending = false;
+
+    m_tx_count = 0;
+
+    uart_rx_chunk_init(&m_rx, rx_chunk_arm, evt_handler);
+
+    err_code = app_timer_create(&m_rx_timeout_timer, APP_TIMER_MODE_REPEATED, rx_timeout_handler);
+    VERIFY_SUCCESS(err_code);
+
+    return uarte_start(p_config);
+}
+
+ret_code_t uart_dma_baud_rate_get(uint32_t bps, nrf_uarte_baudrate_t * p_baud_rate)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(m_baud_rates); i++)
+    {
+        if (m_baud_rates[i].bps == bps)
+        {
+            *p_baud_rate = m_baud_rates[i].baud_rate;
+            return NRF_SUCCESS;
+        }
+    }
+
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+ret_code_t uart_dma_rx_timeout_set(uint32_t timeout_ms)
+{
+    ret_code_t err_code;
+
+    if (timeout_ms == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_rx_timeout_ms = timeout_ms;
+
+    err_code = app_timer_stop(m_rx_timeout_timer);
+    VERIFY_SUCCESS(err_code);
+
+    return app_timer_start(m_rx_timeout_timer, APP_TIMER_TICKS(m_rx_timeout_ms), NULL);
+}
+
+void uart_dma_line_config_set(nrf_uarte_baudrate_t baud_rate, bool use_parity)
+{
+    CRITICAL_REGION_ENTER();
+
+    m_config_next            = m_config;
+    m_config_next.baud_rate  = baud_rate;
+    m_config_next.use_parity = use_parity;
+    m_config_pending         = true;
+
+    CRITICAL_REGION_EXIT();
+}
+
+void uart_dma_process(void)
+{
+    ret_code_t err_code;
+
+    if (!m_config_pending || !tx_idle())
+    {
+        return;
+    }
+
+    // Stop reception first, the chunk in progress is still delivered with the old settings.
+    CRITICAL_REGION_ENTER();
+    if (uart_rx_chunk_stop(&m_rx))
+    {
+        nrfx_uarte_rx_abort(&m_uarte);
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (uart_rx_chunk_is_armed(&m_rx))
+    {
+        // Try again once the aborted chunk has been handed over.
+        return;
+    }
+
+    err_code = app_timer_stop(m_rx_timeout_timer);
+    APP_ERROR_CHECK(err_code);
+
+    nrfx_uarte_uninit(&m_uarte);
+
+    m_config_pending = false;
+
+    err_code = uarte_start(&m_config_next);
+    APP_ERROR_CHECK(err_code);
+
+    NRF_LOG_INFO("uart_dma, line settings changed.");
+}
+
+ret_code_t uart_dma_send(uint8_t * p_block, size_t length)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+
+    if ((length == 0) || (length > FRAME_POOL_BLOCK_SIZE))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    if (m_tx_count == UART_DMA_TX_QUEUE_SIZE)
+    {
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        uint8_t index = (m_tx_head + m_tx_count) % UART_DMA_TX_QUEUE_SIZE;
+
+        m_tx_queue[index].p_data = p_block;
+        m_tx_queue[index].length = (uint16_t)length;
+        m_tx_count++;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    if (err_code == NRF_SUCCESS)
+    {
+        tx_kick();
+    }
+
+    return err_code;
+}
+
+ret_code_t uart_dma_write(uint8_t const * p_data, size_t length)
+{
+    ret_code_t err_code;
+
+    if ((length == 0) || (length > FRAME_POOL_BLOCK_SIZE))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint8_t * p_block = frame_pool_alloc();
+    if (p_block == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memcpy(p_block, p_data, length);
+
+    err_code = uart_dma_send(p_block, length);
+    if (err_code != NRF_SUCCESS)
+    {
+        frame_pool_free(p_block);
+    }
+
+    return err_code;
+}
+
+void uart_dma_rx_pause(bool pause)
+{
+    CRITICAL_REGION_ENTER();
+
+    uart_rx_chunk_pause(&m_rx, pause);
+
+    CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,126 @@
+#ifndef UART_DMA_H
+#define UART_DMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_uarte.h"
+#include "frame_pool.h"
+
+#define UART_DMA_RX_CHUNK_SIZE      64      /**< Size of one EasyDMA receive chunk. */
+#define UART_DMA_RX_CHUNK_COUNT     2       /**< Number of receive chunks (double buffering). */
+#define UART_DMA_RX_TIMEOUT_MS      2       /**< Default line idle time after which a partially filled chunk is delivered. */
+#define UART_DMA_TX_QUEUE_SIZE      FRAME_POOL_BLOCK_COUNT  /**< Frames queued for transmission, one per pool block. */
+
+/**@brief UART DMA event types. */
+typedef enum
+{
+    UART_DMA_EVT_RX_DATA,           /**< A chunk of received bytes is available. */
+    UART_DMA_EVT_RX_IDLE,           /**< The line has gone idle, every received byte has been delivered. */
+    UART_DMA_EVT_COMM_ERROR,        /**< A line error (framing, parity, overrun, break) occurred. */
+} uart_dma_evt_type_t;
+
+/**@brief UART DMA event. */
+typedef struct
+{
+    uart_dma_evt_type_t type;
+    union
+    {
+        struct
+        {
+            uint8_t const * p_data; /**< Received bytes. Only valid inside the event handler. */
+            size_t          length; /**< Number of received bytes. */
+        } rx;
+        uint32_t error_mask;        /**< Content of the UARTE ERRORSRC register. */
+    } data;
+} uart_dma_evt_t;
+
+typedef void (*uart_dma_evt_handler_t)(uart_dma_evt_t const * p_evt);
+
+/**@brief UART DMA configuration. */
+typedef struct
+{
+    uint32_t             rx_pin_no;
+    uint32_t             tx_pin_no;
+    uint32_t             rts_pin_no;
+    uint32_t             cts_pin_no;
+    bool                 flow_control;
+    bool                 use_parity;
+    nrf_uarte_baudrate_t baud_rate;
+    uint8_t              irq_priority;
+} uart_dma_config_t;
+
+/**@brief Initialize the UARTE and start chunked, double buffered reception.
+ *
+ * @details Received bytes are delivered to @p evt_handler a chunk at a time, either when a chunk
+ *          is full or when the line has been idle for @ref UART_DMA_RX_TIMEOUT_MS.
+ */
+ret_code_t uart_dma_init(uart_dma_config_t const * p_config, uart_dma_evt_handler_t evt_handler);
+
+/**@brief Convert a baud rate in bits per second to the UARTE register value.
+ *
+ * @retval NRF_SUCCESS              @p p_baud_rate is set.
+ * @retval NRF_ERROR_INVALID_PARAM  The UARTE does not support @p bps.
+ */
+ret_code_t uart_dma_baud_rate_get(uint32_t bps, nrf_uarte_baudrate_t * p_baud_rate);
+
+/**@brief Request new line settings.
+ *
+ * @details The change is made by @ref uart_dma_process once every queued byte has been sent and
+ *          the chunk being received has been delivered, so no byte straddles the switch. Bytes
+ *          arriving while the UARTE is restarted are lost, the peer should wait for the command
+ *          response before it switches too. Can be called from any interrupt level.
+ */
+void uart_dma_line_config_set(nrf_uarte_baudrate_t baud_rate, bool use_parity);
+
+/**@brief Carry out a pending settings change when the line allows it.
+ *
+ * @details Must be called from the main loop, never from an interrupt handler, as it waits for the
+ *          UARTE to stop.
+ */
+void uart_dma_process(void);
+
+/**@brief Queue a frame pool block for transmission, without copying it.
+ *
+ * @details The block is sent in one EasyDMA transfer and freed once the transfer has ended.
+ *          Queued frames are started one after the other from the ENDTX interrupt, so the caller
+ *          never waits for the UART. Can be called from any interrupt level.
+ *
+ * @param[in] p_block  Frame, in a block from @ref frame_pool_alloc. It may start anywhere inside
+ *                     the block. The UART owns the block if the call succeeds.
+ * @param[in] length   Frame length.
+ *
+ * @retval NRF_SUCCESS              The frame was queued.
+ * @retval NRF_ERROR_INVALID_LENGTH @p length is 0 or above @ref FRAME_POOL_BLOCK_SIZE.
+ * @retval NRF_ERROR_NO_MEM         The transmit queue is full, the caller keeps the block.
+ */
+ret_code_t uart_dma_send(uint8_t * p_block, size_t length);
+
+/**@brief Copy a frame into a frame pool block and queue it for transmission.
+ *
+ * @retval NRF_SUCCESS              The frame was queued.
+ * @retval NRF_ERROR_INVALID_LENGTH @p length is 0 or above @ref FRAME_POOL_BLOCK_SIZE.
+ * @retval NRF_ERROR_NO_MEM         No free block, nothing was queued.
+ */
+ret_code_t uart_dma_write(uint8_t const * p_data, size_t length);
+
+/**@brief Set the line idle time after which received bytes are delivered.
+ *
+ * @details The line is sampled once every @p timeout_ms, so it is found idle after one to two
+ *          periods without a byte. Every idle detection is followed by @ref UART_DMA_EVT_RX_IDLE.
+ */
+ret_code_t uart_dma_rx_timeout_set(uint32_t timeout_ms);
+
+/**@brief Stop or restart handing receive buffers to the UARTE.
+ *
+ * @details With flow control enabled the UARTE deasserts RTS by itself once it has no buffer to
+ *          receive into and its internal FIFO is almost full, so pausing throttles the sender
+ *          without losing bytes. Chunks that are already armed are still filled and delivered,
+ *          so up to @ref UART_DMA_RX_CHUNK_COUNT chunks can arrive after a pause.
+ *
+ * @note    Can be called from any interrupt level.
+ */
+void uart_dma_rx_pause(bool pause);
+
+#endif //UART_DMA_H
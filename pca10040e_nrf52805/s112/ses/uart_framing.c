@@ -0,0 +1,376 @@
+#include "uart_framing.h"
+
+#include <string.h>
+
+#include "nordic_common.h"
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+static uart_framing_handler_t m_handler;
+static uart_framing_mode_t    m_mode;
+static uart_framing_mode_t    m_mode_next;
+static uint16_t               m_max_len;
+static frame_scanner_t        m_scanner;
+
+static uint8_t m_buf[UART_FRAMING_BUF_SIZE];   /**< Frames that span several chunks are assembled here. */
+static size_t  m_buf_len;
+
+static uint8_t  m_len_header_bytes;             /**< Length header bytes received so far. */
+static uint16_t m_len_left;                     /**< Payload bytes of the current frame still to come. */
+
+static uint8_t  m_cobs_code;                    /**< Code byte of the current COBS group, 0 at frame start. */
+static uint8_t  m_cobs_left;                    /**< Data bytes left in the current COBS group. */
+static bool     m_cobs_discard;                 /**< Skip to the next delimiter after an error. */
+
+static void state_reset(void)
+{
+    m_buf_len          = 0;
+    m_len_header_bytes = 0;
+    m_len_left         = 0;
+    m_cobs_code        = 0;
+    m_cobs_left        = 0;
+    m_cobs_discard     = false;
+    frame_scanner_reset(&m_scanner);
+}
+
+/**@brief Append decoded bytes, handing the frame over whenever it reaches the maximum length. */
+static void buf_append(uint8_t const * p_data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t count = (m_buf_len < m_max_len) ? MIN(length, (size_t)(m_max_len - m_buf_len)) : 0;
+        memcpy(&m_buf[m_buf_len], p_data, count);
+        m_buf_len += count;
+        p_data    += count;
+        length    -= count;
+
+        if (m_buf_len >= m_max_len)
+        {
+            m_handler(m_buf, m_buf_len);
+            m_buf_len = 0;
+        }
+    }
+}
+
+/**@brief Apply a mode change requested with @ref uart_framing_mode_set. */
+static void mode_update(void)
+{
+    if (m_mode_next != m_mode)
+    {
+        m_mode = m_mode_next;
+        state_reset();
+    }
+}
+
+/**@brief Handle frame descriptors from the trailer scanner.
+ *
+ * @details A frame that lies entirely inside one received chunk is handled in place. Only frames
+ *          spanning several chunks are assembled in the local buffer.
+ */
+static void trailer_desc_handle(uint8_t const * p_chunk, frame_desc_t const * p_desc, void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (p_desc->complete && (m_buf_len == 0))
+    {
+        m_handler(p_chunk + p_desc->offset, p_desc->length);
+        return;
+    }
+
+    memcpy(&m_buf[m_buf_len], p_chunk + p_desc->offset, p_desc->length);
+    m_buf_len += p_desc->length;
+
+    if (p_desc->complete)
+    {
+        m_buf_len -= p_desc->trim;
+        m_handler(m_buf, m_buf_len);
+        m_buf_len = 0;
+    }
+}
+
+/**@brief Collect bytes until the frame is full. Full frames are handed over in place. */
+static void transparent_rx(uint8_t const * p_data, size_t length)
+{
+    while (length > 0)
+    {
+        if ((m_buf_len == 0) && (length >= m_max_len))
+        {
+            m_handler(p_data, m_max_len);
+            p_data += m_max_len;
+            length -= m_max_len;
+            continue;
+        }
+
+        // The maximum length may have shrunk below what is already collected.
+        size_t count = (m_buf_len < m_max_len) ? MIN(length, (size_t)(m_max_len - m_buf_len)) : 0;
+        memcpy(&m_buf[m_buf_len], p_data, count);
+        m_buf_len += count;
+        p_data    += count;
+        length    -= count;
+
+        if (m_buf_len >= m_max_len)
+        {
+            m_handler(m_buf, m_buf_len);
+            m_buf_len = 0;
+        }
+    }
+}
+
+/**@brief Decode length prefixed frames.
+ *
+ * @details A frame that lies entirely inside the chunk is handed over in place. Frames longer
+ *          than the maximum length are handed over in pieces.
+ */
+static void length_rx(uint8_t const * p_data, size_t length)
+{
+    while (length > 0)
+    {
+        if (m_len_header_bytes < UART_FRAMING_LEN_SIZE)
+        {
+            m_len_left = (uint16_t)((m_len_left << 8) | *p_data);
+            m_len_header_bytes++;
+            p_data++;
+            length--;
+
+            if ((m_len_header_bytes == UART_FRAMING_LEN_SIZE) && (m_len_left == 0))
+            {
+                // Empty frame, nothing to hand over.
+                m_len_header_bytes = 0;
+            }
+            continue;
+        }
+
+        size_t count = MIN(length, (size_t)m_len_left);
+
+        if ((m_buf_len == 0) && (count == m_len_left) && (count <= m_max_len))
+        {
+            m_handler(p_data, count);
+        }
+        else
+        {
+            buf_append(p_data, count);
+            if ((count == m_len_left) && (m_buf_len > 0))
+            {
+                m_handler(m_buf, m_buf_len);
+                m_buf_len = 0;
+            }
+        }
+
+        m_len_left -= count;
+        p_data     += count;
+        length     -= count;
+
+        if (m_len_left == 0)
+        {
+            m_len_header_bytes = 0;
+        }
+    }
+}
+
+/**@brief Decode COBS frames straight into the frame buffer.
+ *
+ * @details Runs of data bytes are copied a group at a time. The zero that ends every group except
+ *          the last is only written once the next group starts, so nothing has to be removed
+ *          when the delimiter arrives.
+ */
+static void cobs_rx(uint8_t const * p_data, size_t length)
+{
+    while (length > 0)
+    {
+        if (*p_data == 0x00)
+        {
+            // Delimiter. A frame that ends inside a group is corrupt and dropped.
+            if (!m_cobs_discard && (m_cobs_left == 0) && (m_buf_len > 0))
+            {
+                m_handler(m_buf, m_buf_len);
+            }
+            else if (m_cobs_left != 0)
+            {
+                NRF_LOG_WARNING("uart_framing, truncated COBS frame dropped.");
+            }
+            m_buf_len      = 0;
+            m_cobs_code    = 0;
+            m_cobs_left    = 0;
+            m_cobs_discard = false;
+            p_data++;
+            length--;
+            continue;
+        }
+
+        if (m_cobs_discard)
+        {
+            p_data++;
+            length--;
+            continue;
+        }
+
+        if (m_cobs_left == 0)
+        {
+            // Code byte, which also closes the previous group.
+            if ((m_cobs_code != 0) && (m_cobs_code != 0xFF))
+            {
+                uint8_t const zero = 0;
+                buf_append(&zero, 1);
+            }
+            m_cobs_code = *p_data;
+            m_cobs_left = *p_data - 1;
+            p_data++;
+            length--;
+            continue;
+        }
+
+        // Copy the rest of the group, stopping early at a delimiter.
+        size_t          count  = MIN(length, (size_t)m_cobs_left);
+        uint8_t const * p_zero = memchr(p_data, 0x00, count);
+        if (p_zero != NULL)
+        {
+            count = p_zero - p_data;
+        }
+
+        buf_append(p_data, count);
+        m_cobs_left -= count;
+        p_data      += count;
+        length      -= count;
+    }
+}
+
+void uart_framing_init(uart_framing_mode_t mode, uint16_t max_len, uart_framing_handler_t handler)
+{
+    m_handler   = handler;
+    m_mode      = (mode < UART_FRAMING_MODE_COUNT) ? mode : UART_FRAMING_TRAILER;
+    m_mode_next = m_mode;
+    m_max_len   = MIN(max_len, UART_FRAMING_BUF_SIZE);
+    m_buf_len   = 0;
+
+    frame_scanner_init(&m_scanner, m_max_len, trailer_desc_handle, NULL);
+}
+
+ret_code_t uart_framing_mode_set(uart_framing_mode_t mode)
+{
+    if (mode >= UART_FRAMING_MODE_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_mode_next = mode;
+
+    return NRF_SUCCESS;
+}
+
+uart_framing_mode_t uart_framing_mode_get(void)
+{
+    return m_mode_next;
+}
+
+bool uart_framing_is_binary(uart_framing_mode_t mode)
+{
+    return (mode == UART_FRAMING_LENGTH) || (mode == UART_FRAMING_COBS);
+}
+
+ret_code_t uart_framing_encode(uint8_t const * p_data, size_t length, uint8_t * p_out, size_t * p_out_len)
+{
+    size_t out_len = 0;
+
+    switch (m_mode_next)
+    {
+        case UART_FRAMING_LENGTH:
+            if ((length > UINT16_MAX) || (*p_out_len < length + UART_FRAMING_LEN_SIZE))
+            {
+                return NRF_ERROR_NO_MEM;
+            }
+            p_out[0] = (uint8_t)(length >> 8);
+            p_out[1] = (uint8_t)length;
+            memcpy(&p_out[UART_FRAMING_LEN_SIZE], p_data, length);
+            out_len = length + UART_FRAMING_LEN_SIZE;
+            break;
+
+        case UART_FRAMING_COBS:
+        {
+            if (*p_out_len < UART_FRAMING_ENCODED_SIZE(length))
+            {
+                return NRF_ERROR_NO_MEM;
+            }
+
+            size_t code_pos = out_len++;
+            uint8_t code    = 1;
+
+            for (size_t i = 0; i < length; i++)
+            {
+                if (p_data[i] != 0x00)
+                {
+                    p_out[out_len++] = p_data[i];
+                    code++;
+                }
+
+                if ((p_data[i] == 0x00) || (code == 0xFF))
+                {
+                    p_out[code_pos] = code;
+                    code_pos        = out_len++;
+                    code            = 1;
+                }
+            }
+
+            p_out[code_pos]  = code;
+            p_out[out_len++] = 0x00;
+        } break;
+
+        default:
+            if (*p_out_len < length)
+            {
+                return NRF_ERROR_NO_MEM;
+            }
+            memcpy(p_out, p_data, length);
+            out_len = length;
+            break;
+    }
+
+    *p_out_len = out_len;
+
+    return NRF_SUCCESS;
+}
+
+void uart_framing_max_len_set(uint16_t max_len)
+{
+    m_max_len = MIN(max_len, UART_FRAMING_BUF_SIZE);
+    frame_scanner_max_len_set(&m_scanner, m_max_len);
+}
+
+void uart_framing_rx(uint8_t const * p_data, size_t length)
+{
+    mode_update();
+
+    switch (m_mode)
+    {
+        case UART_FRAMING_TRAILER:
+            frame_scanner_scan(&m_scanner, p_data, length);
+            break;
+
+        case UART_FRAMING_TRANSPARENT:
+            transparent_rx(p_data, length);
+            break;
+
+        case UART_FRAMING_LENGTH:
+            length_rx(p_data, length);
+            break;
+
+        case UART_FRAMING_COBS:
+            cobs_rx(p_data, length);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void uart_framing_idle(void)
+{
+    mode_update();
+
+    if ((m_mode == UART_FRAMING_TRANSPARENT) && (m_buf_len > 0))
+    {
+        m_handler(m_buf, m_buf_len);
+        m_buf_len = 0;
+    }
+}
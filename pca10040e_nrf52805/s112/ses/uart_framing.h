@@ -0,0 +1,75 @@
+#ifndef UART_FRAMING_H
+#define UART_FRAMING_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "frame_scanner.h"
+
+#define UART_FRAMING_BUF_SIZE   244     /**< Largest frame, the maximum NUS payload. */
+#define UART_FRAMING_LEN_SIZE   2       /**< Size of the big endian length header. */
+
+/**@brief Worst case size of @ref uart_framing_encode output for @p len payload bytes. */
+#define UART_FRAMING_ENCODED_SIZE(len)  ((len) + ((len) / 254) + 2)
+
+/**@brief How the received UART byte stream is split into frames. */
+typedef enum
+{
+    UART_FRAMING_TRAILER     = 0,   /**< Frames end with 0xA5 0xA6 0xA7 or at the maximum length. */
+    UART_FRAMING_TRANSPARENT = 1,   /**< Frames end when the line goes idle or at the maximum length. */
+    UART_FRAMING_LENGTH      = 2,   /**< Every frame starts with a 16 bit big endian length. */
+    UART_FRAMING_COBS        = 3,   /**< Frames are COBS encoded and end with a 0x00 byte. */
+    UART_FRAMING_MODE_COUNT
+} uart_framing_mode_t;
+
+typedef void (*uart_framing_handler_t)(uint8_t const * p_frame, size_t length);
+
+/**@brief Initialize framing.
+ *
+ * @param[in] mode     Initial framing mode.
+ * @param[in] max_len  Maximum frame length, at most @ref UART_FRAMING_BUF_SIZE.
+ * @param[in] handler  Called with every complete frame. The frame is only valid inside the call.
+ */
+void uart_framing_init(uart_framing_mode_t mode, uint16_t max_len, uart_framing_handler_t handler);
+
+/**@brief Select the framing mode.
+ *
+ * @details The switch is made before the next received chunk is processed and drops any partly
+ *          received frame, so it is safe to call from inside the frame handler.
+ *
+ * @retval NRF_SUCCESS              The mode will be switched.
+ * @retval NRF_ERROR_INVALID_PARAM  Unknown mode.
+ */
+ret_code_t uart_framing_mode_set(uart_framing_mode_t mode);
+
+/**@brief Get the framing mode in use. */
+uart_framing_mode_t uart_framing_mode_get(void);
+
+/**@brief Check if the framing mode carries arbitrary binary payloads. */
+bool uart_framing_is_binary(uart_framing_mode_t mode);
+
+/**@brief Frame a payload for transmission over UART in the current mode.
+ *
+ * @details The binary modes add their length header or COBS encoding. The text modes send the
+ *          payload as it is.
+ *
+ * @param[in]     p_data     Payload.
+ * @param[in]     length     Payload length.
+ * @param[out]    p_out      Encoded frame.
+ * @param[in,out] p_out_len  Size of @p p_out in, encoded length out.
+ *
+ * @retval NRF_SUCCESS          The frame was encoded.
+ * @retval NRF_ERROR_NO_MEM     @p p_out is too small, see @ref UART_FRAMING_ENCODED_SIZE.
+ */
+ret_code_t uart_framing_encode(uint8_t const * p_data, size_t length, uint8_t * p_out, size_t * p_out_len);
+
+/**@brief Change the maximum frame length, for example after an ATT MTU exchange. */
+void uart_framing_max_len_set(uint16_t max_len);
+
+/**@brief Process a chunk of received bytes. */
+void uart_framing_rx(uint8_t const * p_data, size_t length);
+
+/**@brief Tell the framing that the line has gone idle. */
+void uart_framing_idle(void);
+
+#endif //UART_FRAMING_H
@@ -0,0 +1,112 @@
+#include "uart_rx_chunk.h"
+
+#include <string.h>
+
+void uart_rx_chunk_init(uart_rx_chunk_t * p_rx, uart_rx_chunk_arm_t arm, uart_dma_evt_handler_t evt_handler)
+{
+    memset(p_rx, 0, sizeof(*p_rx));
+
+    p_rx->arm         = arm;
+    p_rx->evt_handler = evt_handler;
+}
+
+void uart_rx_chunk_reset(uart_rx_chunk_t * p_rx)
+{
+    p_rx->next    = 0;
+    p_rx->armed   = 0;
+    p_rx->active  = false;
+    p_rx->stopped = false;
+}
+
+void uart_rx_chunk_arm(uart_rx_chunk_t * p_rx)
+{
+    while (!p_rx->paused && !p_rx->stopped && (p_rx->armed < 2))
+    {
+        if (p_rx->arm(p_rx->buf[p_rx->next], UART_DMA_RX_CHUNK_SIZE) != NRF_SUCCESS)
+        {
+            return;
+        }
+
+        p_rx->next = (p_rx->next + 1) % UART_DMA_RX_CHUNK_COUNT;
+        p_rx->armed++;
+    }
+}
+
+void uart_rx_chunk_pause(uart_rx_chunk_t * p_rx, bool pause)
+{
+    p_rx->paused = pause;
+    uart_rx_chunk_arm(p_rx);
+}
+
+bool uart_rx_chunk_stop(uart_rx_chunk_t * p_rx)
+{
+    p_rx->stopped = true;
+    return uart_rx_chunk_is_armed(p_rx);
+}
+
+bool uart_rx_chunk_is_armed(uart_rx_chunk_t const * p_rx)
+{
+    return p_rx->armed > 0;
+}
+
+bool uart_rx_chunk_idle_check(uart_rx_chunk_t * p_rx, bool byte_seen)
+{
+    if (byte_seen)
+    {
+        p_rx->active = true;
+    }
+    else if (p_rx->active && (p_rx->armed > 0))
+    {
+        p_rx->active = false;
+        return true;
+    }
+
+    return false;
+}
+
+void uart_rx_chunk_done(uart_rx_chunk_t * p_rx, uint8_t const * p_data, size_t bytes)
+{
+    uart_dma_evt_t evt;
+
+    // A short transfer is the result of an abort, which also releases the secondary buffer.
+    bool aborted = (bytes < UART_DMA_RX_CHUNK_SIZE);
+    if (aborted)
+    {
+        p_rx->armed = 0;
+    }
+    else if (p_rx->armed > 0)
+    {
+        p_rx->armed--;
+    }
+
+    if (bytes > 0)
+    {
+        evt.type           = UART_DMA_EVT_RX_DATA;
+        evt.data.rx.p_data = p_data;
+        evt.data.rx.length = bytes;
+        p_rx->evt_handler(&evt);
+    }
+
+    if (aborted)
+    {
+        // Reception is only aborted once the line has gone quiet.
+        evt.type = UART_DMA_EVT_RX_IDLE;
+        p_rx->evt_handler(&evt);
+    }
+
+    uart_rx_chunk_arm(p_rx);
+}
+
+void uart_rx_chunk_error(uart_rx_chunk_t * p_rx, uint32_t error_mask)
+{
+    uart_dma_evt_t evt;
+
+    // The driver drops both receive buffers on error.
+    p_rx->armed = 0;
+
+    evt.type            = UART_DMA_EVT_COMM_ERROR;
+    evt.data.error_mask = error_mask;
+    p_rx->evt_handler(&evt);
+
+    uart_rx_chunk_arm(p_rx);
+}
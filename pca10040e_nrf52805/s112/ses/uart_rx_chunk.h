@@ -0,0 +1,78 @@
+#ifndef UART_RX_CHUNK_H
+#define UART_RX_CHUNK_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "uart_dma.h"
+
+/**@brief Function that hands one receive buffer to the UART driver, usually wraps nrfx_uarte_rx. */
+typedef ret_code_t (*uart_rx_chunk_arm_t)(uint8_t * p_buf, size_t length);
+
+/**@brief Chunked, double buffered reception, without the driver calls.
+ *
+ * @details Keeps track of which chunks the driver owns and turns its RX_DONE and ERROR events into
+ *          @ref uart_dma_evt_t events. A chunk that ends short of @ref UART_DMA_RX_CHUNK_SIZE is the
+ *          result of an abort, which releases the secondary buffer as well, and is followed by
+ *          @ref UART_DMA_EVT_RX_IDLE. The caller serializes the calls.
+ */
+typedef struct
+{
+    uart_rx_chunk_arm_t    arm;
+    uart_dma_evt_handler_t evt_handler;
+    uint8_t                buf[UART_DMA_RX_CHUNK_COUNT][UART_DMA_RX_CHUNK_SIZE];
+    uint8_t                next;        /**< Index of the next chunk to hand to the driver. */
+    uint8_t                armed;       /**< Number of chunks currently owned by the driver. */
+    bool                   active;      /**< Bytes have arrived since the last idle check. */
+    bool                   paused;      /**< Receive buffers are withheld so that RTS is deasserted. */
+    bool                   stopped;     /**< Reception is being shut down for a settings change. */
+} uart_rx_chunk_t;
+
+/**@brief Initialize the chunk state, not paused and with nothing armed.
+ *
+ * @param[out] p_rx         Chunk state.
+ * @param[in]  arm          Hands a chunk to the driver.
+ * @param[in]  evt_handler  Receives the data, idle and error events.
+ */
+void uart_rx_chunk_init(uart_rx_chunk_t * p_rx, uart_rx_chunk_arm_t arm, uart_dma_evt_handler_t evt_handler);
+
+/**@brief Forget the chunks of a driver that has been uninitialized. The pause state is kept. */
+void uart_rx_chunk_reset(uart_rx_chunk_t * p_rx);
+
+/**@brief Hand free chunks to the driver until both the primary and secondary buffer are set. */
+void uart_rx_chunk_arm(uart_rx_chunk_t * p_rx);
+
+/**@brief Stop or restart handing chunks to the driver. */
+void uart_rx_chunk_pause(uart_rx_chunk_t * p_rx, bool pause);
+
+/**@brief Stop handing chunks to the driver for good, until @ref uart_rx_chunk_reset.
+ *
+ * @return True if the driver still owns a chunk, which must be aborted.
+ */
+bool uart_rx_chunk_stop(uart_rx_chunk_t * p_rx);
+
+/**@brief Check if the driver owns a chunk. */
+bool uart_rx_chunk_is_armed(uart_rx_chunk_t const * p_rx);
+
+/**@brief Handle a tick of the idle timer.
+ *
+ * @param[in] p_rx       Chunk state.
+ * @param[in] byte_seen  A byte arrived since the previous tick, for example RXDRDY was set.
+ *
+ * @return True if the line has gone quiet with a chunk armed, reception must be aborted to
+ *         deliver it.
+ */
+bool uart_rx_chunk_idle_check(uart_rx_chunk_t * p_rx, bool byte_seen);
+
+/**@brief Handle a chunk the driver has handed back and arm the next ones.
+ *
+ * @param[in] p_rx    Chunk state.
+ * @param[in] p_data  Received bytes.
+ * @param[in] bytes   Number of received bytes, fewer than a chunk after an abort.
+ */
+void uart_rx_chunk_done(uart_rx_chunk_t * p_rx, uint8_t const * p_data, size_t bytes);
+
+/**@brief Handle a line error, after which the driver has dropped both chunks, and re-arm. */
+void uart_rx_chunk_error(uart_rx_chunk_t * p_rx, uint32_t error_mask);
+
+#endif //UART_RX_CHUNK_H
@@ -0,0 +1,191 @@
+/* AES-128-CTR with the software block cipher: the FIPS-197 example vectors, the SP 800-38A CTR
+ * vectors whole, block by block and cut short, and the 32 bit block counter wrapping. */
+#include <string.h>
+
+#include "aes_ctr.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#if AES_CTR_ECB
+#error "The host test needs the software cipher, build it with AES_CTR_SOFTWARE."
+#endif
+
+typedef struct
+{
+    uint8_t key[AES_CTR_KEY_SIZE];
+    uint8_t plain[AES_CTR_BLOCK_SIZE];
+    uint8_t cipher[AES_CTR_BLOCK_SIZE];
+} block_vector_t;
+
+/* FIPS-197, appendix B (cipher example) and appendix C.1 (AES-128). */
+static block_vector_t const m_fips197[] =
+{
+    {
+        .key    = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+        .plain  = {0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34},
+        .cipher = {0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32},
+    },
+    {
+        .key    = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+        .plain  = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff},
+        .cipher = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a},
+    },
+};
+
+/* SP 800-38A, F.5.1 CTR-AES128.Encrypt. */
+static uint8_t const m_ctr_key[AES_CTR_KEY_SIZE] =
+{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static uint8_t const m_ctr_counter[AES_CTR_BLOCK_SIZE] =
+{
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+};
+
+static uint8_t const m_ctr_plain[4 * AES_CTR_BLOCK_SIZE] =
+{
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+
+static uint8_t const m_ctr_cipher[4 * AES_CTR_BLOCK_SIZE] =
+{
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee,
+};
+
+static void test_fips197(void)
+{
+    aes_ctr_key_t key;
+    uint8_t       out[AES_CTR_BLOCK_SIZE];
+
+    for (size_t i = 0; i < ARRAY_SIZE(m_fips197); i++)
+    {
+        aes_ctr_key_set(&key, m_fips197[i].key);
+        CHECK(aes_ctr_block_encrypt(&key, m_fips197[i].plain, out) == NRF_SUCCESS);
+        CHECK(memcmp(out, m_fips197[i].cipher, sizeof(out)) == 0);
+    }
+
+    // Cleared, the key no longer gives the same block.
+    aes_ctr_key_clear(&key);
+    CHECK(aes_ctr_block_encrypt(&key, m_fips197[1].plain, out) == NRF_SUCCESS);
+    CHECK(memcmp(out, m_fips197[1].cipher, sizeof(out)) != 0);
+}
+
+static void test_sp800_38a(void)
+{
+    aes_ctr_key_t key;
+    uint8_t       counter[AES_CTR_BLOCK_SIZE];
+    uint8_t       data[sizeof(m_ctr_plain)];
+
+    aes_ctr_key_set(&key, m_ctr_key);
+
+    // All four blocks in one call. The counter ends four blocks on, carried out of the last byte.
+    static uint8_t const counter_end[AES_CTR_BLOCK_SIZE] =
+    {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xff, 0x03,
+    };
+    memcpy(counter, m_ctr_counter, sizeof(counter));
+    memcpy(data, m_ctr_plain, sizeof(data));
+    CHECK(aes_ctr_crypt(&key, counter, data, sizeof(data)) == NRF_SUCCESS);
+    CHECK(memcmp(data, m_ctr_cipher, sizeof(data)) == 0);
+    CHECK(memcmp(counter, counter_end, sizeof(counter)) == 0);
+
+    // Decryption is the same operation, here one block per call (F.5.2).
+    memcpy(counter, m_ctr_counter, sizeof(counter));
+    for (size_t pos = 0; pos < sizeof(data); pos += AES_CTR_BLOCK_SIZE)
+    {
+        CHECK(aes_ctr_crypt(&key, counter, data + pos, AES_CTR_BLOCK_SIZE) == NRF_SUCCESS);
+    }
+    CHECK(memcmp(data, m_ctr_plain, sizeof(data)) == 0);
+    CHECK(memcmp(counter, counter_end, sizeof(counter)) == 0);
+
+    // A partly used last block: the output is as long as the input, the rest of the block is
+    // thrown away and the next call starts on a new one.
+    memcpy(counter, m_ctr_counter, sizeof(counter));
+    memcpy(data, m_ctr_plain, sizeof(data));
+    CHECK(aes_ctr_crypt(&key, counter, data, 20) == NRF_SUCCESS);
+    CHECK(memcmp(data, m_ctr_cipher, 20) == 0);
+    CHECK(memcmp(data + 20, m_ctr_plain + 20, sizeof(data) - 20) == 0);
+    CHECK(aes_ctr_crypt(&key, counter, data + 32, 32) == NRF_SUCCESS);
+    CHECK(memcmp(data + 32, m_ctr_cipher + 32, 32) == 0);
+
+    // Nothing to do leaves the counter alone.
+    memcpy(counter, m_ctr_counter, sizeof(counter));
+    CHECK(aes_ctr_crypt(&key, counter, data, 0) == NRF_SUCCESS);
+    CHECK(memcmp(counter, m_ctr_counter, sizeof(counter)) == 0);
+}
+
+static void test_counter_wrap(void)
+{
+    typedef struct
+    {
+        uint8_t before[AES_CTR_BLOCK_SIZE];
+        uint8_t after[AES_CTR_BLOCK_SIZE];
+    } inc_vector_t;
+
+    // Only the last 32 bits count, big endian. They wrap to zero without carrying into the nonce.
+    static inc_vector_t const vectors[] =
+    {
+        {
+            .before = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x00, 0x00, 0x00, 0x00},
+            .after  = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x00, 0x00, 0x00, 0x01},
+        },
+        {
+            .before = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x00, 0x00, 0x00, 0xff},
+            .after  = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x00, 0x00, 0x01, 0x00},
+        },
+        {
+            .before = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x12, 0xff, 0xff, 0xff},
+            .after  = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x13, 0x00, 0x00, 0x00},
+        },
+        {
+            .before = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0xff, 0xff, 0xff, 0xff},
+            .after  = {0xa5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11, 0x00, 0x00, 0x00, 0x00},
+        },
+        {
+            .before = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+            .after  = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00},
+        },
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(vectors); i++)
+    {
+        uint8_t counter[AES_CTR_BLOCK_SIZE];
+
+        memcpy(counter, vectors[i].before, sizeof(counter));
+        aes_ctr_counter_inc(counter);
+        CHECK(memcmp(counter, vectors[i].after, sizeof(counter)) == 0);
+    }
+
+    // Across the wrap in one call: the second block is keyed by the wrapped counter.
+    aes_ctr_key_t key;
+    uint8_t       counter[AES_CTR_BLOCK_SIZE];
+    uint8_t       block[AES_CTR_BLOCK_SIZE];
+    uint8_t       keystream[2 * AES_CTR_BLOCK_SIZE] = {0};
+
+    aes_ctr_key_set(&key, m_ctr_key);
+    memcpy(counter, vectors[3].before, sizeof(counter));
+    CHECK(aes_ctr_crypt(&key, counter, keystream, sizeof(keystream)) == NRF_SUCCESS);
+
+    CHECK(aes_ctr_block_encrypt(&key, vectors[3].before, block) == NRF_SUCCESS);
+    CHECK(memcmp(keystream, block, AES_CTR_BLOCK_SIZE) == 0);
+    CHECK(aes_ctr_block_encrypt(&key, vectors[3].after, block) == NRF_SUCCESS);
+    CHECK(memcmp(keystream + AES_CTR_BLOCK_SIZE, block, AES_CTR_BLOCK_SIZE) == 0);
+    CHECK(memcmp(counter, vectors[3].after, AES_CTR_BLOCK_SIZE - 1) == 0);
+    CHECK(counter[AES_CTR_BLOCK_SIZE - 1] == 0x01);
+}
+
+int main(void)
+{
+    test_fips197();
+    test_sp800_38a();
+    test_counter_wrap();
+
+    return test_result("aes_ctr_test");
+}
@@ -0,0 +1,556 @@
+/* BLE receive stage against stub key exchange, decryption and UART. Checks what reaches the UART
+ * in every framing mode and that every frame pool block comes back, on every error branch and
+ * over a long random run. The benchmark counts the bytes copied per received byte against the
+ * path it replaced, which decrypted into a static buffer and queued the result byte by byte
+ * into the app_uart FIFO. */
+#include <string.h>
+
+#include "ble_coalesce.h"
+#include "ble_rx.h"
+#include "crypto_session.h"
+#include "frame_pool.h"
+#include "nordic_common.h"
+#include "test_util.h"
+#include "uart_framing.h"
+
+#define KEY             0x5A    /* The stub cipher XORs every byte with it. */
+#define HELD_MAX        64
+#define UART_MAX        4096
+
+/* Copies are counted by wrapping memcpy and memmove at link time, see the Makefile. */
+void * __real_memcpy(void * p_dst, void const * p_src, size_t length);
+void * __real_memmove(void * p_dst, void const * p_src, size_t length);
+
+static bool   m_counting;
+static size_t m_copied;
+
+void * __wrap_memcpy(void * p_dst, void const * p_src, size_t length)
+{
+    m_copied += m_counting ? length : 0;
+    return __real_memcpy(p_dst, p_src, length);
+}
+
+void * __wrap_memmove(void * p_dst, void const * p_src, size_t length)
+{
+    m_copied += m_counting ? length : 0;
+    return __real_memmove(p_dst, p_src, length);
+}
+
+/* Stubs of the application. */
+static struct
+{
+    ret_code_t key_exchange_ret;
+    uint32_t   key_exchange_calls;
+    ret_code_t decrypt_ret;
+    uint32_t   decrypt_calls;
+    size_t     decrypt_cut;         /* Bytes the decryption drops, like a CCM tag. */
+    ret_code_t send_ret;
+    bool       hold;                /* Sent blocks stay with the UART until released. */
+    uint8_t *  p_held[HELD_MAX];
+    size_t     held_count;
+    uint8_t *  p_received;          /* Block handed to ble_rx_process. */
+    uint32_t   sends;
+    uint32_t   sends_in_place;      /* Sends from the received block. */
+    size_t     new_block_bytes;     /* Bytes sent from other blocks, written by the encoder. */
+    uint8_t    uart[UART_MAX];      /* What the UART sent, concatenated. */
+    size_t     uart_len;
+} m_app;
+
+static crypto_session_cipher_t m_cipher;
+
+crypto_session_cipher_t crypto_session_cipher_get(void)
+{
+    return m_cipher;
+}
+
+static ret_code_t stub_key_exchange(uint8_t const * p_data, uint16_t length)
+{
+    m_app.key_exchange_calls++;
+    return m_app.key_exchange_ret;
+}
+
+static ret_code_t stub_decrypt(uint8_t * p_data, size_t length, size_t * p_length)
+{
+    m_app.decrypt_calls++;
+    if (m_app.decrypt_ret != NRF_SUCCESS)
+    {
+        return m_app.decrypt_ret;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        p_data[i] ^= KEY;
+    }
+    *p_length = length - MIN(m_app.decrypt_cut, length);
+    return NRF_SUCCESS;
+}
+
+static void uart_release(void)
+{
+    for (size_t i = 0; i < m_app.held_count; i++)
+    {
+        frame_pool_free(m_app.p_held[i]);
+    }
+    m_app.held_count = 0;
+}
+
+static ret_code_t stub_send(uint8_t * p_block, size_t length)
+{
+    if (m_app.send_ret != NRF_SUCCESS)
+    {
+        return m_app.send_ret;
+    }
+
+    CHECK(length > 0);
+    CHECK(length <= FRAME_POOL_BLOCK_SIZE);
+    if (m_app.uart_len + length <= sizeof(m_app.uart))
+    {
+        __real_memcpy(m_app.uart + m_app.uart_len, p_block, length);
+    }
+    m_app.uart_len += length;
+    m_app.sends++;
+    if (p_block == m_app.p_received)
+    {
+        m_app.sends_in_place++;
+    }
+    else
+    {
+        m_app.new_block_bytes += length;
+    }
+
+    // The UART frees the block once it is sent.
+    if (m_app.hold && (m_app.held_count < HELD_MAX))
+    {
+        m_app.p_held[m_app.held_count++] = p_block;
+    }
+    else
+    {
+        frame_pool_free(p_block);
+    }
+    return NRF_SUCCESS;
+}
+
+static ble_rx_ops_t const m_ops =
+{
+    .key_exchange = stub_key_exchange,
+    .decrypt      = stub_decrypt,
+    .send         = stub_send,
+};
+
+static uint8_t m_decoded[UART_MAX];
+static size_t  m_decoded_len;
+
+static void decoded_handler(uint8_t const * p_frame, size_t length)
+{
+    if (m_decoded_len + length <= sizeof(m_decoded))
+    {
+        __real_memcpy(m_decoded + m_decoded_len, p_frame, length);
+    }
+    m_decoded_len += length;
+}
+
+/* A session past its key exchange, with everything succeeding. */
+static void setup(uart_framing_mode_t mode, ble_coalesce_policy_t policy, crypto_session_cipher_t cipher)
+{
+    uart_release();
+    memset(&m_app, 0, sizeof(m_app));
+    m_app.key_exchange_ret = NRF_ERROR_INVALID_DATA;
+    m_cipher               = cipher;
+    m_decoded_len          = 0;
+
+    uart_framing_init(mode, UART_FRAMING_BUF_SIZE, decoded_handler);
+    CHECK(ble_coalesce_policy_set(policy, BLE_COALESCE_DELAY_MS) == NRF_SUCCESS);
+    ble_rx_init(&m_ops);
+}
+
+static uint32_t pool_in_use(void)
+{
+    frame_pool_stats_t stats;
+
+    frame_pool_stats_get(&stats);
+    return stats.in_use;
+}
+
+/* Receive a packet the way the pipeline hands it over, in a pool block. */
+static void receive(uint8_t const * p_plain, size_t length)
+{
+    uint8_t * p_block = frame_pool_alloc();
+
+    CHECK(p_block != NULL);
+    if (p_block == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        p_block[i] = p_plain[i] ^ KEY;
+    }
+    m_app.p_received = p_block;
+    ble_rx_process(p_block, length);
+}
+
+/* Receive, let the UART finish, and check that every block came back. */
+static void receive_check(uint8_t const * p_plain, size_t length)
+{
+    receive(p_plain, length);
+    uart_release();
+    CHECK(pool_in_use() == 0);
+}
+
+/* Build a record of tagged frames, each filled with its index. */
+static size_t record_build(uint8_t * p_record, size_t const * p_lengths, size_t count)
+{
+    size_t pos = 0;
+
+    for (size_t f = 0; f < count; f++)
+    {
+        p_record[pos++] = (uint8_t)(p_lengths[f] >> 8);
+        p_record[pos++] = (uint8_t)p_lengths[f];
+        memset(p_record + pos, 'a' + (int)f, p_lengths[f]);
+        pos += p_lengths[f];
+    }
+    return pos;
+}
+
+static void test_key_exchange(void)
+{
+    static uint8_t const packet[] = "hello";
+
+    // A key exchange message is consumed.
+    setup(UART_FRAMING_TRANSPARENT, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR);
+    m_app.key_exchange_ret = NRF_SUCCESS;
+    receive_check(packet, 5);
+    CHECK(m_app.key_exchange_calls == 1);
+    CHECK(m_app.decrypt_calls == 0);
+    CHECK(m_app.sends == 0);
+
+    // Once it is done, packets are data without asking the key exchange again.
+    receive_check(packet, 5);
+    CHECK(m_app.key_exchange_calls == 1);
+    CHECK(m_app.sends == 1);
+
+    // A failed key exchange drops the packet, and the next packet is tried again.
+    ble_rx_session_reset();
+    m_app.key_exchange_ret = NRF_ERROR_INVALID_LENGTH;
+    receive_check(packet, 5);
+    CHECK(m_app.key_exchange_calls == 2);
+    CHECK(m_app.decrypt_calls == 1);
+    CHECK(m_app.sends == 1);
+
+    // Not a key exchange message: processed as data, the key exchange is still pending.
+    m_app.key_exchange_ret = NRF_ERROR_INVALID_DATA;
+    receive_check(packet, 5);
+    receive_check(packet, 5);
+    CHECK(m_app.key_exchange_calls == 4);
+    CHECK(m_app.sends == 3);
+    CHECK((m_app.uart_len == 15) && (memcmp(m_app.uart, "hellohellohello", 15) == 0));
+}
+
+static void test_text(void)
+{
+    static uint8_t const padded[] = "abc=\x04\x04\x04\x04";
+    static uint8_t const padding[] = "\x04\x04\x04\x04";
+
+    // Decryption failure drops the record.
+    setup(UART_FRAMING_TRANSPARENT, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR);
+    m_app.decrypt_ret = NRF_ERROR_INVALID_DATA;
+    receive_check(padded, 8);
+    CHECK(m_app.sends == 0);
+
+    // CTR and CCM records go out as decrypted, from the block they came in.
+    setup(UART_FRAMING_TRANSPARENT, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CCM);
+    m_app.decrypt_cut = 4;
+    receive_check(padded, 8);
+    CHECK(m_app.sends_in_place == 1);
+    CHECK((m_app.uart_len == 4) && (memcmp(m_app.uart, "abc=", 4) == 0));
+
+    // CBC padding is trimmed, in place.
+    setup(UART_FRAMING_TRAILER, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CBC);
+    receive_check(padded, 8);
+    CHECK(m_app.sends_in_place == 1);
+    CHECK((m_app.uart_len == 4) && (memcmp(m_app.uart, "abc=", 4) == 0));
+
+    // Nothing left after the trim.
+    receive_check(padding, 4);
+    CHECK(m_app.sends == 1);
+
+    // The UART refuses: the block is freed, for both ciphers.
+    m_app.send_ret = NRF_ERROR_NO_MEM;
+    receive_check(padded, 8);
+    m_cipher = CRYPTO_SESSION_CIPHER_CTR;
+    receive_check(padded, 8);
+    CHECK(m_app.sends == 1);
+}
+
+static void test_records(void)
+{
+    static size_t const lengths[] = {3, 1, 200};
+    uint8_t             record[FRAME_POOL_BLOCK_SIZE];
+    size_t              length = record_build(record, lengths, ARRAY_SIZE(lengths));
+
+    // Length mode: the tags are the UART length headers, the record goes out as it is.
+    setup(UART_FRAMING_LENGTH, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CBC);
+    record[length] = 0x04;
+    receive_check(record, length + 1);
+    CHECK(m_app.sends_in_place == 1);
+    CHECK((m_app.uart_len == length) && (memcmp(m_app.uart, record, length) == 0));
+
+    // Coalesced text: the tags are dropped, the frames go out back to back.
+    setup(UART_FRAMING_TRANSPARENT, BLE_COALESCE_THROUGHPUT, CRYPTO_SESSION_CIPHER_CTR);
+    receive_check(record, length);
+    CHECK(m_app.sends_in_place == 1);
+    CHECK(m_app.uart_len == 204);
+    CHECK((m_app.uart[0] == 'a') && (m_app.uart[3] == 'b') && (m_app.uart[4] == 'c') && (m_app.uart[203] == 'c'));
+
+    // A record without a valid first tag is dropped.
+    uint8_t bad[8] = {0x00, 0x00, 1, 2, 3, 4, 5, 6};
+    receive_check(bad, sizeof(bad));
+    bad[1] = 100;
+    receive_check(bad, sizeof(bad));
+    receive_check(bad, 1);
+    CHECK(m_app.sends == 1);
+
+    // The UART refuses.
+    m_app.send_ret = NRF_ERROR_BUSY;
+    receive_check(record, length);
+    CHECK(m_app.sends == 1);
+}
+
+static void test_cobs(void)
+{
+    static size_t const lengths[] = {3, 1, 100, 60};
+    uint8_t             record[FRAME_POOL_BLOCK_SIZE];
+    size_t              length = record_build(record, lengths, ARRAY_SIZE(lengths));
+
+    // Every frame is encoded into a block of its own, the record block is freed.
+    setup(UART_FRAMING_COBS, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR);
+    m_app.hold = true;
+    receive(record, length);
+    CHECK(m_app.sends == ARRAY_SIZE(lengths));
+    CHECK(m_app.sends_in_place == 0);
+    CHECK(pool_in_use() == ARRAY_SIZE(lengths));
+    uart_release();
+    CHECK(pool_in_use() == 0);
+
+    uart_framing_rx(m_app.uart, m_app.uart_len);
+    CHECK(m_decoded_len == 164);
+    CHECK((m_decoded[0] == 'a') && (m_decoded[3] == 'b') && (m_decoded[4] == 'c') && (m_decoded[163] == 'd'));
+
+    // One byte frames, more than the pool holds while the UART keeps them: the rest are dropped.
+    size_t many[FRAME_POOL_BLOCK_COUNT + 4];
+    for (size_t f = 0; f < ARRAY_SIZE(many); f++)
+    {
+        many[f] = 1;
+    }
+    length = record_build(record, many, ARRAY_SIZE(many));
+    m_app.sends = 0;
+    receive_check(record, length);
+    CHECK(m_app.sends == FRAME_POOL_BLOCK_COUNT - 1);
+
+    // The UART refuses every frame.
+    m_app.hold     = false;
+    m_app.send_ret = NRF_ERROR_NO_MEM;
+    m_app.sends    = 0;
+    receive_check(record, length);
+    CHECK(m_app.sends == 0);
+
+    // Invalid record.
+    m_app.send_ret = NRF_SUCCESS;
+    record[0] = 0xFF;
+    receive_check(record, length);
+    CHECK(m_app.sends == 0);
+}
+
+/* Random packets in random configurations with random failures. */
+static void test_random(void)
+{
+    uint32_t seed = 0xB1E5;
+    uint8_t  packet[FRAME_POOL_BLOCK_SIZE];
+
+    for (uint32_t n = 0; n < 200000; n++)
+    {
+        uint32_t r = test_rand(&seed);
+
+        if ((n % 64) == 0)
+        {
+            setup((uart_framing_mode_t)(r % UART_FRAMING_MODE_COUNT),
+                  (ble_coalesce_policy_t)((r >> 4) % BLE_COALESCE_POLICY_COUNT),
+                  (crypto_session_cipher_t)((r >> 8) % CRYPTO_SESSION_CIPHER_COUNT));
+            m_app.hold = (r >> 12) & 1;
+            if ((r >> 13) & 1)
+            {
+                ble_rx_session_reset();
+            }
+        }
+
+        static ret_code_t const key_exchange_rets[] = {NRF_SUCCESS, NRF_ERROR_INVALID_DATA, NRF_ERROR_INVALID_LENGTH};
+        m_app.key_exchange_ret = key_exchange_rets[(r >> 16) % 3];
+        m_app.decrypt_ret      = ((r >> 18) % 8 == 0) ? NRF_ERROR_INVALID_DATA : NRF_SUCCESS;
+        m_app.send_ret         = ((r >> 21) % 8 == 0) ? NRF_ERROR_NO_MEM : NRF_SUCCESS;
+        m_app.decrypt_cut      = (r >> 24) % 3;
+        m_app.uart_len         = 0;
+
+        size_t length = 1 + test_rand(&seed) % sizeof(packet);
+        if ((r >> 27) & 1)
+        {
+            // A valid record, possibly with padding.
+            size_t lengths[8];
+            size_t count = 0;
+            size_t room  = length;
+
+            while ((count < ARRAY_SIZE(lengths)) && (room > BLE_COALESCE_TAG_SIZE))
+            {
+                size_t frame_len = 1 + test_rand(&seed) % (room - BLE_COALESCE_TAG_SIZE);
+
+                lengths[count++] = frame_len;
+                room -= BLE_COALESCE_TAG_SIZE + frame_len;
+            }
+            memset(packet, 0x04, sizeof(packet));
+            record_build(packet, lengths, count);
+        }
+        else
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                packet[i] = (uint8_t)test_rand(&seed);
+            }
+        }
+
+        // The UART gives blocks back before the pool runs dry, the stage needs one to receive.
+        if (m_app.held_count >= FRAME_POOL_BLOCK_COUNT - 1)
+        {
+            uart_release();
+        }
+        receive(packet, length);
+        if ((test_rand(&seed) % 4) == 0)
+        {
+            uart_release();
+            CHECK(pool_in_use() == 0);
+        }
+        else
+        {
+            CHECK(pool_in_use() == m_app.held_count);
+        }
+    }
+    uart_release();
+    CHECK(pool_in_use() == 0);
+}
+
+/* The path this stage replaced: decrypt from the SoftDevice buffer into a cleared static buffer,
+ * trim, then app_uart_put every byte into the app_uart FIFO, from which the UART driver takes one
+ * byte at a time. */
+#define BASELINE_BUF_SIZE   256
+#define BASELINE_FIFO_SIZE  256
+
+static struct
+{
+    uint8_t           decrypted[BASELINE_BUF_SIZE];
+    uint8_t           fifo[BASELINE_FIFO_SIZE];
+    uint32_t          read;
+    uint32_t          write;
+    volatile uint8_t  txd;
+    size_t            copied;
+    size_t            cleared;
+} m_baseline;
+
+static void baseline_process(uint8_t const * p_data, size_t length)
+{
+    memset(m_baseline.decrypted, 0, sizeof(m_baseline.decrypted));
+    m_baseline.cleared += sizeof(m_baseline.decrypted);
+    for (size_t i = 0; i < length; i++)
+    {
+        m_baseline.decrypted[i] = p_data[i] ^ KEY;
+    }
+    for (; (length > 0) && (m_baseline.decrypted[length - 1] < ' '); length--);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // app_uart_put, the driver drains the FIFO as fast as it is filled.
+        m_baseline.fifo[m_baseline.write++ % BASELINE_FIFO_SIZE] = m_baseline.decrypted[i];
+        m_baseline.txd = m_baseline.fifo[m_baseline.read++ % BASELINE_FIFO_SIZE];
+    }
+    m_baseline.copied += 2 * length;
+}
+
+static void bench_mode(uart_framing_mode_t mode, ble_coalesce_policy_t policy, crypto_session_cipher_t cipher,
+                       char const * p_name)
+{
+    enum { PACKETS = 200000 };
+
+    static size_t const lengths[] = {60, 60, 60, 54};
+    uint8_t             packet[FRAME_POOL_BLOCK_SIZE];
+    size_t              length;
+
+    setup(mode, policy, cipher);
+    if (uart_framing_is_binary(mode) || (policy != BLE_COALESCE_OFF))
+    {
+        length = record_build(packet, lengths, ARRAY_SIZE(lengths));
+    }
+    else
+    {
+        length = 240;
+        memset(packet, 'x', length);
+    }
+
+    // In both paths the decryption works on the packet as received.
+    uint8_t encrypted[FRAME_POOL_BLOCK_SIZE];
+    for (size_t i = 0; i < length; i++)
+    {
+        encrypted[i] = packet[i] ^ KEY;
+    }
+
+    m_copied = 0;
+    uint64_t start = test_cycles();
+    for (uint32_t n = 0; n < PACKETS; n++)
+    {
+        uint8_t * p_block = frame_pool_alloc();
+
+        // pipeline_put copies the SoftDevice buffer into the block.
+        memcpy(p_block, encrypted, length);
+        m_app.p_received = p_block;
+        m_app.uart_len   = 0;
+
+        m_counting = true;
+        ble_rx_process(p_block, length);
+        m_counting = false;
+    }
+    uint64_t cycles = test_cycles() - start;
+
+    CHECK(pool_in_use() == 0);
+    double stage_copies = (double)(m_copied + m_app.new_block_bytes) / ((double)PACKETS * length);
+
+    memset(&m_baseline, 0, sizeof(m_baseline));
+    start = test_cycles();
+    for (uint32_t n = 0; n < PACKETS; n++)
+    {
+        baseline_process(encrypted, length);
+    }
+    uint64_t baseline_cycles = test_cycles() - start;
+    double   baseline_copies = (double)(m_baseline.copied + m_baseline.cleared) / ((double)PACKETS * length);
+    double   baseline_clears = (double)m_baseline.cleared / ((double)PACKETS * length);
+
+    // At most one pass over the data besides the copy into the pool block, and less than before.
+    CHECK(stage_copies <= 1.02);
+    CHECK(1.0 + stage_copies < baseline_copies);
+
+    printf("ble_rx, %-16s: %.2f copies/byte (+1 pipeline_put), %.1f cycles/byte;"
+           " replaced path %.2f copies/byte (%.2f clearing), %.1f cycles/byte\n",
+           p_name, stage_copies, (double)cycles / ((double)PACKETS * length),
+           baseline_copies, baseline_clears, (double)baseline_cycles / ((double)PACKETS * length));
+}
+
+int main(void)
+{
+    test_key_exchange();
+    test_text();
+    test_records();
+    test_cobs();
+    test_random();
+
+    bench_mode(UART_FRAMING_TRANSPARENT, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR, "text, CTR");
+    bench_mode(UART_FRAMING_TRAILER, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CBC, "text, CBC");
+    bench_mode(UART_FRAMING_LENGTH, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR, "length records");
+    bench_mode(UART_FRAMING_TRANSPARENT, BLE_COALESCE_THROUGHPUT, CRYPTO_SESSION_CIPHER_CTR, "coalesced text");
+    bench_mode(UART_FRAMING_COBS, BLE_COALESCE_OFF, CRYPTO_SESSION_CIPHER_CTR, "COBS records");
+
+    return test_result("ble_rx_test");
+}
@@ -0,0 +1,331 @@
+/* BLE transmit queue against a stub SoftDevice whose send returns NRF_ERROR_RESOURCES, or another
+ * error, on a configurable schedule. Checks the order of what is sent, retries on
+ * BLE_GATTS_EVT_HVN_TX_COMPLETE, overflow, the flow control bytes of dropped notifications, and
+ * that every frame pool block comes back, also from reset. */
+#include <string.h>
+
+#include "ble_tx_queue.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#define SCHEDULE_MAX    64
+
+/* Stub SoftDevice. Call n returns schedule[n] if set, NRF_SUCCESS after the schedule ends. */
+static struct
+{
+    uint32_t schedule[SCHEDULE_MAX];
+    uint32_t schedule_len;
+    uint32_t calls;
+    uint32_t buffers;       /* Free notification buffers, RESOURCES once they run out. */
+    uint8_t  sent_id[1024]; /* First byte of the last accepted notifications, in order. */
+    uint32_t sent_count;
+} m_sd;
+
+static flow_ctrl_t m_flow;
+static uint32_t    m_flow_pauses;
+
+static uint32_t stub_send(uint8_t * p_data, uint16_t * p_length, void * p_context)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    CHECK(p_context == &m_sd);
+    if (m_sd.calls < m_sd.schedule_len)
+    {
+        err_code = m_sd.schedule[m_sd.calls];
+    }
+    else if (m_sd.buffers == 0)
+    {
+        err_code = NRF_ERROR_RESOURCES;
+    }
+    m_sd.calls++;
+
+    if (err_code == NRF_SUCCESS)
+    {
+        if (m_sd.buffers > 0)
+        {
+            m_sd.buffers--;
+        }
+        m_sd.sent_id[m_sd.sent_count++ % sizeof(m_sd.sent_id)] = p_data[0];
+    }
+
+    return err_code;
+}
+
+static void flow_handler(bool paused, void * p_context)
+{
+    m_flow_pauses += paused;
+}
+
+static void stub_reset(uint32_t buffers, uint32_t const * p_schedule, uint32_t schedule_len)
+{
+    memset(&m_sd, 0, sizeof(m_sd));
+    m_sd.buffers      = buffers;
+    m_sd.schedule_len = schedule_len;
+    memcpy(m_sd.schedule, p_schedule, schedule_len * sizeof(p_schedule[0]));
+}
+
+static uint8_t pool_in_use(void)
+{
+    frame_pool_stats_t stats;
+
+    frame_pool_stats_get(&stats);
+    return stats.in_use;
+}
+
+/* Queue a notification of @p length bytes tagged with @p id. */
+static ret_code_t push(ble_tx_queue_t * p_queue, uint8_t id, uint16_t length)
+{
+    uint8_t * p_block = frame_pool_alloc();
+
+    CHECK(p_block != NULL);
+    if (p_block == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    memset(p_block, id, length);
+
+    return ble_tx_queue_push(p_queue, p_block, length);
+}
+
+static void test_resources_then_complete(void)
+{
+    static uint32_t const schedule[] = {NRF_SUCCESS, NRF_ERROR_RESOURCES};
+    ble_tx_queue_t        queue;
+    ble_tx_queue_stats_t  stats;
+
+    stub_reset(UINT32_MAX, schedule, ARRAY_SIZE(schedule));
+    flow_ctrl_init(&m_flow, 10000, 0, flow_handler, NULL);
+    ble_tx_queue_init(&queue, stub_send, &m_sd, &m_flow);
+
+    // The first goes straight out, the second meets RESOURCES and waits with the rest.
+    CHECK(push(&queue, 1, 100) == NRF_SUCCESS);
+    CHECK(push(&queue, 2, 100) == NRF_SUCCESS);
+    CHECK(push(&queue, 3, 100) == NRF_SUCCESS);
+    CHECK(m_sd.sent_count == 3);    // RESOURCES only once, the push of 3 retried 2 first.
+
+    stub_reset(0, NULL, 0);
+    CHECK(push(&queue, 4, 100) == NRF_SUCCESS);
+    CHECK(push(&queue, 5, 100) == NRF_SUCCESS);
+    CHECK(m_sd.sent_count == 0);
+    CHECK(pool_in_use() == 2);
+    CHECK(m_flow.level == 500);
+
+    // A completed notification frees a SoftDevice buffer and the queue sends the next.
+    m_sd.buffers = 1;
+    ble_tx_queue_tx_complete(&queue, 1);
+    CHECK(m_sd.sent_count == 1);
+    CHECK(m_sd.sent_id[0] == 4);
+    CHECK(pool_in_use() == 1);
+    CHECK(m_flow.level == 400);
+
+    m_sd.buffers = 8;
+    ble_tx_queue_tx_complete(&queue, 2);
+    CHECK(m_sd.sent_count == 2);
+    CHECK(m_sd.sent_id[1] == 5);
+    CHECK(pool_in_use() == 0);
+
+    ble_tx_queue_tx_complete(&queue, 10);
+    CHECK(ble_tx_queue_is_idle(&queue));
+    CHECK(m_flow.level == 0);
+
+    ble_tx_queue_stats_get(&queue, &stats);
+    CHECK(stats.queued == 5);
+    CHECK(stats.sent == 5);
+    CHECK(stats.completed == 5);
+    CHECK(stats.dropped == 0);
+    CHECK(stats.overflow == 0);
+}
+
+static void test_overflow(void)
+{
+    ble_tx_queue_t       queue;
+    ble_tx_queue_stats_t stats;
+
+    stub_reset(0, NULL, 0);
+    flow_ctrl_init(&m_flow, 10000, 0, flow_handler, NULL);
+    ble_tx_queue_init(&queue, stub_send, &m_sd, &m_flow);
+
+    for (uint8_t i = 0; i < BLE_TX_QUEUE_SIZE; i++)
+    {
+        CHECK(push(&queue, i, 10) == NRF_SUCCESS);
+    }
+    CHECK(push(&queue, 99, 10) == NRF_ERROR_NO_MEM);
+    CHECK(pool_in_use() == BLE_TX_QUEUE_SIZE);
+    CHECK(m_flow.level == 10 * BLE_TX_QUEUE_SIZE);
+
+    // Too long is refused before it is queued, and the block is freed too.
+    CHECK(push(&queue, 98, BLE_TX_QUEUE_ENTRY_SIZE + 1) == NRF_ERROR_INVALID_LENGTH);
+    CHECK(pool_in_use() == BLE_TX_QUEUE_SIZE);
+
+    ble_tx_queue_stats_get(&queue, &stats);
+    CHECK(stats.overflow == 1);
+    CHECK(stats.depth_max == BLE_TX_QUEUE_SIZE);
+
+    // Everything queued goes out in order once there is room.
+    m_sd.buffers = UINT32_MAX;
+    ble_tx_queue_drain(&queue);
+    CHECK(m_sd.sent_count == BLE_TX_QUEUE_SIZE);
+    for (uint8_t i = 0; i < BLE_TX_QUEUE_SIZE; i++)
+    {
+        CHECK(m_sd.sent_id[i] == i);
+    }
+    CHECK(pool_in_use() == 0);
+
+    // No more than BLE_TX_QUEUE_INFLIGHT_MAX are handed over before they complete.
+    ble_tx_queue_tx_complete(&queue, BLE_TX_QUEUE_SIZE);
+    stub_reset(UINT32_MAX, NULL, 0);
+    for (uint8_t i = 0; i < BLE_TX_QUEUE_INFLIGHT_MAX + 2; i++)
+    {
+        CHECK(push(&queue, i, 10) == NRF_SUCCESS);
+    }
+    CHECK(m_sd.sent_count == BLE_TX_QUEUE_INFLIGHT_MAX);
+    CHECK(pool_in_use() == 2);
+    ble_tx_queue_tx_complete(&queue, 2);
+    CHECK(m_sd.sent_count == BLE_TX_QUEUE_INFLIGHT_MAX + 2);
+    CHECK(pool_in_use() == 0);
+    ble_tx_queue_tx_complete(&queue, BLE_TX_QUEUE_INFLIGHT_MAX);
+    CHECK(ble_tx_queue_is_idle(&queue));
+    CHECK(m_flow.level == 0);
+}
+
+static void test_dropped_release_flow(void)
+{
+    static uint32_t const schedule[] = {NRF_ERROR_INVALID_STATE, NRF_SUCCESS, NRF_ERROR_RESOURCES,
+                                        NRF_ERROR_NOT_FOUND, NRF_SUCCESS};
+    ble_tx_queue_t        queue;
+    ble_tx_queue_stats_t  stats;
+
+    stub_reset(UINT32_MAX, schedule, ARRAY_SIZE(schedule));
+    m_flow_pauses = 0;
+    flow_ctrl_init(&m_flow, 150, 50, flow_handler, NULL);
+    ble_tx_queue_init(&queue, stub_send, &m_sd, &m_flow);
+
+    CHECK(push(&queue, 1, 100) == NRF_SUCCESS);     // Refused, its bytes leave the level.
+    CHECK(m_flow.level == 0);
+    CHECK(push(&queue, 2, 100) == NRF_SUCCESS);     // Sent, waiting for completion.
+    CHECK(push(&queue, 3, 100) == NRF_SUCCESS);     // RESOURCES.
+    CHECK(m_flow.level == 200);
+    CHECK(m_flow.paused);
+    CHECK(m_flow_pauses == 1);
+
+    ble_tx_queue_drain(&queue);                     // Refused, dropped.
+    CHECK(m_flow.level == 100);
+    CHECK(m_flow.paused);
+    ble_tx_queue_tx_complete(&queue, 1);
+    CHECK(m_flow.level == 0);
+    CHECK(!m_flow.paused);
+    CHECK(pool_in_use() == 0);
+
+    ble_tx_queue_stats_get(&queue, &stats);
+    CHECK(stats.dropped == 2);
+    CHECK(stats.sent == 1);
+    CHECK(m_sd.sent_id[0] == 2);
+}
+
+static void test_reset_frees_blocks(void)
+{
+    static uint32_t const schedule[] = {NRF_SUCCESS, NRF_SUCCESS, NRF_ERROR_RESOURCES};
+    ble_tx_queue_t        queue;
+    ble_tx_queue_stats_t  stats;
+
+    stub_reset(0, schedule, ARRAY_SIZE(schedule));
+    flow_ctrl_init(&m_flow, 300, 100, flow_handler, NULL);
+    ble_tx_queue_init(&queue, stub_send, &m_sd, &m_flow);
+
+    // Two sent, the rest waits for RESOURCES and two overflow.
+    for (uint8_t i = 0; i < BLE_TX_QUEUE_SIZE + 4; i++)
+    {
+        push(&queue, i, 100);
+    }
+    CHECK(pool_in_use() == BLE_TX_QUEUE_SIZE);
+    CHECK(m_flow.paused);
+
+    ble_tx_queue_reset(&queue);
+    CHECK(pool_in_use() == 0);
+    CHECK(ble_tx_queue_is_idle(&queue));
+    CHECK(m_flow.level == 0);
+    CHECK(!m_flow.paused);
+
+    // Completions for the notifications of the old connection are ignored.
+    ble_tx_queue_tx_complete(&queue, 2);
+    CHECK(m_flow.level == 0);
+
+    // Statistics are kept, the queue works as before.
+    ble_tx_queue_stats_get(&queue, &stats);
+    CHECK(stats.sent == 2);
+    CHECK(stats.overflow == 2);
+    m_sd.buffers = 1;
+    CHECK(push(&queue, 42, 10) == NRF_SUCCESS);
+    CHECK(m_sd.sent_id[m_sd.sent_count - 1] == 42);
+    ble_tx_queue_tx_complete(&queue, 1);
+    CHECK(ble_tx_queue_is_idle(&queue));
+}
+
+/* Random pushes, RESOURCES, errors and completions, checked against a model of the SoftDevice. */
+static void test_random(void)
+{
+    ble_tx_queue_t queue;
+    uint32_t       seed     = 0xBEEF;
+    uint32_t       inflight = 0;
+    uint8_t        next_id  = 0;
+    uint32_t       pushed   = 0;
+
+    stub_reset(4, NULL, 0);
+    flow_ctrl_init(&m_flow, 600, 200, flow_handler, NULL);
+    ble_tx_queue_init(&queue, stub_send, &m_sd, &m_flow);
+
+    for (int step = 0; step < 200000; step++)
+    {
+        uint32_t before = m_sd.sent_count;
+        uint32_t action = test_rand(&seed) % 8;
+
+        if (action < 5)
+        {
+            uint16_t length = 1 + test_rand(&seed) % BLE_TX_QUEUE_ENTRY_SIZE;
+            if (push(&queue, next_id, length) == NRF_SUCCESS)
+            {
+                next_id++;
+                pushed++;
+            }
+        }
+        else if ((action < 7) && (inflight > 0))
+        {
+            uint8_t count = 1 + test_rand(&seed) % inflight;
+            m_sd.buffers += count;
+            inflight     -= count;
+            ble_tx_queue_tx_complete(&queue, count);
+        }
+        else if (action == 7)
+        {
+            ble_tx_queue_drain(&queue);
+        }
+
+        inflight += m_sd.sent_count - before;
+        CHECK(inflight <= BLE_TX_QUEUE_INFLIGHT_MAX);
+        CHECK(pool_in_use() == queue.count);
+    }
+
+    // Everything accepted goes out, once, in order.
+    m_sd.buffers = UINT32_MAX;
+    ble_tx_queue_tx_complete(&queue, (uint8_t)inflight);
+    ble_tx_queue_tx_complete(&queue, BLE_TX_QUEUE_INFLIGHT_MAX);
+    CHECK(ble_tx_queue_is_idle(&queue));
+    CHECK(m_sd.sent_count == pushed);
+    for (uint32_t i = pushed - MIN(pushed, sizeof(m_sd.sent_id)); i < pushed; i++)
+    {
+        CHECK(m_sd.sent_id[i % sizeof(m_sd.sent_id)] == (uint8_t)i);
+    }
+    CHECK(pool_in_use() == 0);
+    CHECK(m_flow.level == 0);
+}
+
+int main(void)
+{
+    test_resources_then_complete();
+    test_overflow();
+    test_dropped_release_flow();
+    test_reset_frees_blocks();
+    test_random();
+
+    return test_result("ble_tx_queue_test");
+}
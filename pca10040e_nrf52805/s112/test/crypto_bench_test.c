@@ -0,0 +1,125 @@
+/* The Bench build on the host: crypto_bench_run against nrf_crypto on OpenSSL, see
+ * stub/nrf_crypto_openssl.c and stub/nrf_crypto_ecc_openssl.c, with AES-NI masked off. Cycles are
+ * host cycles and SystemCoreClock is their measured rate, so the figures compare the modes, the
+ * record ciphers and the curves with each other on one backend. They are not nRF52805 figures,
+ * those come from the Bench build on the target. The output is checked for errors and for a line
+ * per cipher, size and curve. */
+#include <string.h>
+#include <unistd.h>
+
+#include "crypto_bench.h"
+#include "crypto_session.h"
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_crypto.h"
+#include "nrf_crypto_aead.h"
+#include "test_util.h"
+
+#define BENCH_LINES     (7 * 4 + 2 * 2)     /**< 4 AES modes and 3 record ciphers at 4 sizes, 2 curves. */
+
+uint32_t SystemCoreClock;
+
+/**@brief Rate of the DWT stand-in over 100 ms, see stub/nrf.h. */
+static uint32_t cycle_rate_measure(void)
+{
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 100000000};
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t cycles = test_cycles();
+    nanosleep(&delay, NULL);
+    cycles = test_cycles() - cycles;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint64_t ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u + (uint64_t)end.tv_nsec -
+                  (uint64_t)start.tv_nsec;
+
+    return (uint32_t)((cycles * 1000000000u) / ns);
+}
+
+/**@brief One operation per cipher, OpenSSL fetches each on first use where the target has no such
+ *        cost. */
+static void ciphers_warm_up(void)
+{
+    nrf_crypto_aes_context_t  aes_ctx;
+    nrf_crypto_aead_context_t aead_ctx;
+    uint8_t                   key[32] = {0};
+    uint8_t                   iv[16]  = {0};
+    uint8_t                   data[16];
+    uint8_t                   mac[16];
+    size_t                    size    = sizeof(data);
+
+    static struct
+    {
+        nrf_crypto_aead_info_t const * p_info;
+        size_t                         nonce_size;
+        size_t                         mac_size;
+    } const aeads[] =
+    {
+        {&g_nrf_crypto_aes_ccm_128_info, 13, 8},
+        {&g_nrf_crypto_aes_gcm_128_info, 12, 16},
+    };
+
+    CHECK(nrf_crypto_aes_crypt(&aes_ctx, &g_nrf_crypto_aes_cbc_256_info, NRF_CRYPTO_ENCRYPT,
+                               key, iv, iv, sizeof(iv), data, &size) == NRF_SUCCESS);
+    size = sizeof(data);
+    CHECK(nrf_crypto_aes_crypt(&aes_ctx, &g_nrf_crypto_aes_ctr_128_info, NRF_CRYPTO_ENCRYPT,
+                               key, iv, iv, sizeof(iv), data, &size) == NRF_SUCCESS);
+
+    // The AEAD stand-in round trips and rejects a forged tag.
+    for (uint32_t i = 0; i < ARRAY_SIZE(aeads); i++)
+    {
+        uint8_t plain[16];
+
+        CHECK(nrf_crypto_aead_init(&aead_ctx, aeads[i].p_info, key) == NRF_SUCCESS);
+        CHECK(nrf_crypto_aead_crypt(&aead_ctx, NRF_CRYPTO_ENCRYPT, iv, aeads[i].nonce_size, NULL, 0,
+                                    iv, sizeof(iv), data, mac, aeads[i].mac_size) == NRF_SUCCESS);
+        CHECK(nrf_crypto_aead_crypt(&aead_ctx, NRF_CRYPTO_DECRYPT, iv, aeads[i].nonce_size, NULL, 0,
+                                    data, sizeof(data), plain, mac, aeads[i].mac_size) == NRF_SUCCESS);
+        CHECK(memcmp(plain, iv, sizeof(plain)) == 0);
+        mac[0] ^= 1;
+        CHECK(nrf_crypto_aead_crypt(&aead_ctx, NRF_CRYPTO_DECRYPT, iv, aeads[i].nonce_size, NULL, 0,
+                                    data, sizeof(data), plain, mac, aeads[i].mac_size) != NRF_SUCCESS);
+        CHECK(nrf_crypto_aead_uninit(&aead_ctx) == NRF_SUCCESS);
+    }
+}
+
+int main(void)
+{
+    FILE * p_out     = tmpfile();
+    int    stdout_fd = dup(STDOUT_FILENO);
+    char   line[128];
+    int    lines     = 0;
+
+    SystemCoreClock = cycle_rate_measure();
+    ciphers_warm_up();
+
+    // crypto_bench_run prints to RTT on the target, stdout here: capture it to check it.
+    fflush(stdout);
+    dup2(fileno(p_out), STDOUT_FILENO);
+    crypto_bench_run();
+    fflush(stdout);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+
+    rewind(p_out);
+    while (fgets(line, sizeof(line), p_out) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        printf("%s\n", line);
+        if (strncmp(line, "BENCH:", 6) == 0)
+        {
+            CHECK(strstr(line, "ERROR") == NULL);
+            lines++;
+        }
+    }
+    fclose(p_out);
+    CHECK(lines == BENCH_LINES);
+
+    // The session keys are cleared and the cipher restored afterwards.
+    CHECK(crypto_session_cipher_get() == CRYPTO_SESSION_CIPHER_CBC);
+    CHECK(!crypto_session_is_keyed(CRYPTO_SESSION_TX));
+
+    return test_result("crypto_bench_test");
+}
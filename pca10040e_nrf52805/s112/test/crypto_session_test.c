@@ -0,0 +1,319 @@
+/* CBC records of the crypto session against a one-shot AES-256-CBC reference, with the key
+ * schedule kept across records and with the key set again before every record, as encrypt_data
+ * did before. CTR and CCM records against OpenSSL playing the central, with records lost on the
+ * way. The benchmark compares the cost per CBC record of the two. nrf_crypto is stood in for
+ * by OpenSSL, see stub/nrf_crypto_openssl.c. The Makefile runs it with AES-NI masked off, so the
+ * key expansion is done in software as by the mbedTLS backend on the nRF52805. */
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "crypto_session.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#define RECORD_MAX      240
+#define RECORD_SIZE     (RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE)    /* Room for the padding, or the tag and the record number. */
+#define SESSION_KEY_SIZE 16
+
+static uint8_t m_key[CRYPTO_SESSION_KEY_SIZE];
+
+/* AES-256-CBC with a zero IV, padded with CRYPTO_SESSION_PAD_BYTE to the next whole block. */
+static size_t reference_encrypt(uint8_t const * p_in, size_t length, uint8_t * p_out)
+{
+    static uint8_t const iv[CRYPTO_SESSION_BLOCK_SIZE];
+    uint8_t              padded[RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE];
+    size_t               padded_len = (length / CRYPTO_SESSION_BLOCK_SIZE + 1) * CRYPTO_SESSION_BLOCK_SIZE;
+    int                  out_len    = 0;
+    int                  final_len  = 0;
+    EVP_CIPHER_CTX *     p_ctx      = EVP_CIPHER_CTX_new();
+
+    memcpy(padded, p_in, length);
+    memset(padded + length, CRYPTO_SESSION_PAD_BYTE, padded_len - length);
+
+    CHECK(EVP_EncryptInit_ex(p_ctx, EVP_aes_256_cbc(), NULL, m_key, iv));
+    CHECK(EVP_CIPHER_CTX_set_padding(p_ctx, 0));
+    CHECK(EVP_EncryptUpdate(p_ctx, p_out, &out_len, padded, (int)padded_len));
+    CHECK(EVP_EncryptFinal_ex(p_ctx, p_out + out_len, &final_len));
+    EVP_CIPHER_CTX_free(p_ctx);
+
+    CHECK((size_t)(out_len + final_len) == padded_len);
+    return padded_len;
+}
+
+static void test_cbc(void)
+{
+    uint32_t seed = 0xCBC;
+    uint8_t  plain[RECORD_MAX];
+    uint8_t  record[RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE];
+    uint8_t  rekeyed[RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE];
+    uint8_t  expected[RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE];
+
+    for (size_t i = 0; i < sizeof(m_key); i++)
+    {
+        m_key[i] = (uint8_t)test_rand(&seed);
+    }
+
+    CHECK(crypto_session_cipher_set(CRYPTO_SESSION_CIPHER_CBC) == NRF_SUCCESS);
+    CHECK(!crypto_session_is_keyed(CRYPTO_SESSION_TX));
+    size_t out_len;
+    CHECK(crypto_session_encrypt(record, 1, sizeof(record), &out_len) == NRF_ERROR_INVALID_STATE);
+
+    CHECK(crypto_session_key_set(CRYPTO_SESSION_TX, m_key) == NRF_SUCCESS);
+    CHECK(crypto_session_key_set(CRYPTO_SESSION_RX, m_key) == NRF_SUCCESS);
+    CHECK(crypto_session_is_keyed(CRYPTO_SESSION_TX) && crypto_session_is_keyed(CRYPTO_SESSION_RX));
+
+    for (uint32_t n = 0; n < 2000; n++)
+    {
+        size_t length = test_rand(&seed) % RECORD_MAX;
+        for (size_t i = 0; i < length; i++)
+        {
+            plain[i] = (uint8_t)test_rand(&seed);
+        }
+        size_t expected_len = reference_encrypt(plain, length, expected);
+
+        // Kept key schedule: every record starts again from the zero IV.
+        memcpy(record, plain, length);
+        CHECK(crypto_session_encrypt(record, length, sizeof(record), &out_len) == NRF_SUCCESS);
+        CHECK((out_len == expected_len) && (memcmp(record, expected, out_len) == 0));
+
+        // The key set again before the record, the old way, gives the same record.
+        memcpy(rekeyed, plain, length);
+        CHECK(crypto_session_key_set(CRYPTO_SESSION_TX, m_key) == NRF_SUCCESS);
+        CHECK(crypto_session_encrypt(rekeyed, length, sizeof(rekeyed), &out_len) == NRF_SUCCESS);
+        CHECK(memcmp(rekeyed, expected, out_len) == 0);
+
+        // And it decrypts with the kept receive schedule, padding included.
+        size_t plain_len;
+        CHECK(crypto_session_decrypt(record, expected_len, &plain_len) == NRF_SUCCESS);
+        CHECK(plain_len == expected_len);
+        CHECK(memcmp(record, plain, length) == 0);
+        for (size_t i = length; i < expected_len; i++)
+        {
+            CHECK(record[i] == CRYPTO_SESSION_PAD_BYTE);
+        }
+    }
+
+    // No room for the padding, or a record that is not whole blocks.
+    CHECK(crypto_session_encrypt(record, 16, 16, &out_len) == NRF_ERROR_NO_MEM);
+    CHECK(crypto_session_decrypt(record, 17, &out_len) == NRF_ERROR_INVALID_LENGTH);
+}
+
+/* The central's view of the session keys, RFC 5869 HKDF-SHA256 as crypto_session_secret_set
+ * documents it. Index CRYPTO_SESSION_TX is what the peripheral sends. */
+static void central_keys(uint8_t const * p_secret, size_t secret_size,
+                         uint8_t keys[CRYPTO_SESSION_DIR_COUNT][SESSION_KEY_SIZE],
+                         uint8_t nonce_bases[CRYPTO_SESSION_DIR_COUNT][CRYPTO_SESSION_NONCE_BASE_SIZE])
+{
+    static uint8_t const salt[32];
+    static char const    info[] = "MEGO session keys v1";
+    uint8_t              prk[32];
+    uint8_t              okm[64];
+    uint8_t              msg[32 + sizeof(info)];
+    unsigned int         len;
+
+    HMAC(EVP_sha256(), salt, sizeof(salt), p_secret, secret_size, prk, &len);
+
+    memcpy(msg, info, sizeof(info) - 1);
+    msg[sizeof(info) - 1] = 1;
+    HMAC(EVP_sha256(), prk, sizeof(prk), msg, sizeof(info), okm, &len);
+    memcpy(msg, okm, 32);
+    memcpy(msg + 32, info, sizeof(info) - 1);
+    msg[32 + sizeof(info) - 1] = 2;
+    HMAC(EVP_sha256(), prk, sizeof(prk), msg, sizeof(msg), okm + 32, &len);
+
+    for (int dir = 0; dir < CRYPTO_SESSION_DIR_COUNT; dir++)
+    {
+        uint8_t const * p_okm = &okm[((dir == CRYPTO_SESSION_TX) ? 0 : 1) * (SESSION_KEY_SIZE + CRYPTO_SESSION_NONCE_BASE_SIZE)];
+
+        memcpy(keys[dir], p_okm, SESSION_KEY_SIZE);
+        memcpy(nonce_bases[dir], p_okm + SESSION_KEY_SIZE, CRYPTO_SESSION_NONCE_BASE_SIZE);
+    }
+}
+
+/* A CTR or CCM record as the central builds it: AES-128-CTR from counter block
+ * [nonce, first bit set][0], or AES-128-CCM with the nonce [nonce][0], then the low 16 bits of the
+ * record number, big endian. */
+static size_t reference_seal(crypto_session_cipher_t cipher, uint8_t const * p_key, uint8_t const * p_nonce_base,
+                             uint32_t record, uint8_t const * p_in, size_t length, uint8_t * p_out)
+{
+    uint8_t          iv[16] = {0};
+    int              out_len = 0;
+    int              final_len = 0;
+    size_t           tag_len = (cipher == CRYPTO_SESSION_CIPHER_CCM) ? CRYPTO_SESSION_TAG_SIZE : 0;
+    EVP_CIPHER_CTX * p_ctx   = EVP_CIPHER_CTX_new();
+
+    memcpy(iv, p_nonce_base, CRYPTO_SESSION_NONCE_BASE_SIZE);
+    iv[8]  ^= (uint8_t)(record >> 24);
+    iv[9]  ^= (uint8_t)(record >> 16);
+    iv[10] ^= (uint8_t)(record >> 8);
+    iv[11] ^= (uint8_t)record;
+
+    if (cipher == CRYPTO_SESSION_CIPHER_CTR)
+    {
+        iv[0] |= 0x80;
+        CHECK(EVP_EncryptInit_ex(p_ctx, EVP_aes_128_ctr(), NULL, p_key, iv));
+    }
+    else
+    {
+        CHECK(EVP_EncryptInit_ex(p_ctx, EVP_aes_128_ccm(), NULL, NULL, NULL));
+        CHECK(EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_SET_IVLEN, CRYPTO_SESSION_NONCE_SIZE, NULL));
+        CHECK(EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_SET_TAG, (int)tag_len, NULL));
+        CHECK(EVP_EncryptInit_ex(p_ctx, NULL, NULL, p_key, iv));
+        CHECK(EVP_EncryptUpdate(p_ctx, NULL, &out_len, NULL, (int)length));
+    }
+    CHECK(EVP_EncryptUpdate(p_ctx, p_out, &out_len, p_in, (int)length));
+    CHECK(EVP_EncryptFinal_ex(p_ctx, p_out + out_len, &final_len));
+    if (tag_len > 0)
+    {
+        CHECK(EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_GET_TAG, (int)tag_len, p_out + length));
+    }
+    EVP_CIPHER_CTX_free(p_ctx);
+
+    p_out[length + tag_len]     = (uint8_t)(record >> 8);
+    p_out[length + tag_len + 1] = (uint8_t)record;
+
+    return length + tag_len + CRYPTO_SESSION_SEQ_SIZE;
+}
+
+/* CTR and CCM records sent and received, with records lost between the ends. A lost record only
+ * leaves a gap, the records after it still decrypt. */
+static void test_record_lost(crypto_session_cipher_t cipher)
+{
+    static uint8_t const secret[] = "a shared secret from the key exchange";
+    uint8_t              keys[CRYPTO_SESSION_DIR_COUNT][SESSION_KEY_SIZE];
+    uint8_t              nonce_bases[CRYPTO_SESSION_DIR_COUNT][CRYPTO_SESSION_NONCE_BASE_SIZE];
+    uint32_t             seed     = 0x1057 + cipher;
+    size_t               tag_len  = (cipher == CRYPTO_SESSION_CIPHER_CCM) ? CRYPTO_SESSION_TAG_SIZE : 0;
+    uint8_t              plain[RECORD_MAX];
+    uint8_t              record[RECORD_SIZE];
+    uint8_t              expected[RECORD_SIZE];
+    uint8_t              replay[RECORD_SIZE];
+    size_t               replay_len = 0;
+    size_t               out_len;
+    uint32_t             lost = 0;
+
+    crypto_session_stats_t stats;
+
+    central_keys(secret, sizeof(secret), keys, nonce_bases);
+    CHECK(crypto_session_cipher_set(cipher) == NRF_SUCCESS);
+    CHECK(crypto_session_secret_set(secret, sizeof(secret)) == NRF_SUCCESS);
+    crypto_session_stats_get(&stats);
+    uint32_t skipped = stats.records_skipped;
+
+    CHECK(crypto_session_plaintext_max(RECORD_MAX + tag_len + CRYPTO_SESSION_SEQ_SIZE) == RECORD_MAX);
+    CHECK(crypto_session_encrypt(record, RECORD_MAX, RECORD_MAX + tag_len + 1, &out_len) == NRF_ERROR_NO_MEM);
+    CHECK(crypto_session_decrypt(record, tag_len + 1, &out_len) == NRF_ERROR_INVALID_LENGTH);
+
+    for (uint32_t n = 0; n < 2000; n++)
+    {
+        size_t length = test_rand(&seed) % RECORD_MAX;
+        for (size_t i = 0; i < length; i++)
+        {
+            plain[i] = (uint8_t)test_rand(&seed);
+        }
+
+        // Sent: record n whatever happened to the ones before, a record dropped after encryption
+        // still uses up its number.
+        size_t expected_len = reference_seal(cipher, keys[CRYPTO_SESSION_TX], nonce_bases[CRYPTO_SESSION_TX],
+                                             n, plain, length, expected);
+        memcpy(record, plain, length);
+        CHECK(crypto_session_encrypt(record, length, sizeof(record), &out_len) == NRF_SUCCESS);
+        CHECK((out_len == expected_len) && (memcmp(record, expected, out_len) == 0));
+
+        // Received: every fifth record and a run of three are lost on the way.
+        if (((n % 5) == 3) || ((n >= 100) && (n < 103)))
+        {
+            lost++;
+            continue;
+        }
+
+        size_t record_len = reference_seal(cipher, keys[CRYPTO_SESSION_RX], nonce_bases[CRYPTO_SESSION_RX],
+                                           n, plain, length, record);
+        if (n == 50)
+        {
+            memcpy(replay, record, record_len);
+            replay_len = record_len;
+        }
+        CHECK(crypto_session_decrypt(record, record_len, &out_len) == NRF_SUCCESS);
+        CHECK((out_len == length) && (memcmp(record, plain, length) == 0));
+    }
+
+    crypto_session_stats_get(&stats);
+    CHECK(stats.records_skipped - skipped == lost);
+
+    // A gap across the 16 bit record number sent, nearly the most that can be recovered.
+    uint32_t n = 2000 + 0xFFF0;
+    size_t   record_len = reference_seal(cipher, keys[CRYPTO_SESSION_RX], nonce_bases[CRYPTO_SESSION_RX],
+                                         n, plain, 16, record);
+    CHECK(crypto_session_decrypt(record, record_len, &out_len) == NRF_SUCCESS);
+    CHECK((out_len == 16) && (memcmp(record, plain, 16) == 0));
+
+    if (cipher == CRYPTO_SESSION_CIPHER_CCM)
+    {
+        // A replayed or forged record is refused and does not move the receiver on.
+        CHECK(crypto_session_decrypt(replay, replay_len, &out_len) == NRF_ERROR_INVALID_DATA);
+
+        record_len = reference_seal(cipher, keys[CRYPTO_SESSION_RX], nonce_bases[CRYPTO_SESSION_RX],
+                                    n + 1, plain, 16, record);
+        record[0] ^= 1;
+        CHECK(crypto_session_decrypt(record, record_len, &out_len) == NRF_ERROR_INVALID_DATA);
+
+        record_len = reference_seal(cipher, keys[CRYPTO_SESSION_RX], nonce_bases[CRYPTO_SESSION_RX],
+                                    n + 1, plain, 16, record);
+        CHECK(crypto_session_decrypt(record, record_len, &out_len) == NRF_SUCCESS);
+        CHECK((out_len == 16) && (memcmp(record, plain, 16) == 0));
+
+        crypto_session_stats_get(&stats);
+        CHECK(stats.auth_failed == 2);
+    }
+
+    crypto_session_clear();
+}
+
+static void bench(size_t length)
+{
+    enum { RECORDS = 200000 };
+
+    uint8_t record[RECORD_MAX + CRYPTO_SESSION_BLOCK_SIZE] = {0};
+    size_t  out_len;
+
+    CHECK(crypto_session_key_set(CRYPTO_SESSION_TX, m_key) == NRF_SUCCESS);
+
+    uint64_t start = test_cycles();
+    for (uint32_t n = 0; n < RECORDS; n++)
+    {
+        UNUSED_RETURN_VALUE(crypto_session_encrypt(record, length, sizeof(record), &out_len));
+    }
+    uint64_t kept_cycles = test_cycles() - start;
+
+    start = test_cycles();
+    for (uint32_t n = 0; n < RECORDS; n++)
+    {
+        UNUSED_RETURN_VALUE(crypto_session_key_set(CRYPTO_SESSION_TX, m_key));
+        UNUSED_RETURN_VALUE(crypto_session_encrypt(record, length, sizeof(record), &out_len));
+    }
+    uint64_t rekey_cycles = test_cycles() - start;
+
+    printf("crypto_session, CBC record of %3zu bytes: key kept %6.0f cycles, key set per record %6.0f cycles (%.2fx)\n",
+           length, (double)kept_cycles / RECORDS, (double)rekey_cycles / RECORDS,
+           (double)rekey_cycles / kept_cycles);
+}
+
+int main(void)
+{
+    test_cbc();
+    test_record_lost(CRYPTO_SESSION_CIPHER_CTR);
+    test_record_lost(CRYPTO_SESSION_CIPHER_CCM);
+    CHECK(crypto_session_cipher_set(CRYPTO_SESSION_CIPHER_CBC) == NRF_SUCCESS);
+
+    bench(16);
+    bench(64);
+    bench(RECORD_MAX - 1);
+
+    crypto_session_clear();
+    CHECK(!crypto_session_is_keyed(CRYPTO_SESSION_TX));
+
+    return test_result("crypto_session_test");
+}
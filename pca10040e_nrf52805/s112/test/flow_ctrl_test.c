@@ -0,0 +1,182 @@
+/* Flow control against a simulated UART producer and BLE consumer. The producer adds a 64 byte
+ * chunk per tick unless paused, and like uart_dma still delivers the chunks it had armed when
+ * the pause came. The consumer drains a fixed number of bytes per tick. Checks the hysteresis
+ * after every call, the bound on the level, and reset. */
+#include "flow_ctrl.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#define HIGH            128
+#define LOW             32
+#define CHUNK           64
+#define CHUNKS_ARMED    2
+
+static uint32_t m_pauses;
+static uint32_t m_resumes;
+static bool     m_paused;
+static bool     m_alternates;
+
+static void handler(bool paused, void * p_context)
+{
+    flow_ctrl_t const * p_flow = p_context;
+
+    // Every call changes the state, and only across a watermark.
+    if (paused == m_paused)
+    {
+        m_alternates = false;
+    }
+    if (paused)
+    {
+        CHECK(p_flow->level >= p_flow->high);
+        m_pauses++;
+    }
+    else
+    {
+        CHECK(p_flow->level <= p_flow->low);
+        m_resumes++;
+    }
+    m_paused = paused;
+}
+
+static void counters_reset(void)
+{
+    m_pauses     = 0;
+    m_resumes    = 0;
+    m_paused     = false;
+    m_alternates = true;
+}
+
+/* The state after a call: paused at or above high, running at or below low, unchanged between. */
+static void hysteresis_check(flow_ctrl_t const * p_flow, bool paused_before)
+{
+    if (p_flow->level >= p_flow->high)
+    {
+        CHECK(p_flow->paused);
+    }
+    else if (p_flow->level <= p_flow->low)
+    {
+        CHECK(!p_flow->paused);
+    }
+    else
+    {
+        CHECK(p_flow->paused == paused_before);
+    }
+    CHECK(p_flow->paused == m_paused);
+}
+
+static void simulate(uint32_t drain_per_tick)
+{
+    flow_ctrl_t flow;
+    uint32_t    in_flight    = CHUNKS_ARMED;   // Chunks the UART may still deliver while paused.
+    uint64_t    produced     = 0;
+    uint64_t    drained      = 0;
+    uint32_t    paused_ticks = 0;
+
+    counters_reset();
+    flow_ctrl_init(&flow, HIGH, LOW, handler, &flow);
+
+    for (uint32_t tick = 0; tick < 100000; tick++)
+    {
+        bool before;
+
+        if (!flow.paused)
+        {
+            in_flight = CHUNKS_ARMED;
+        }
+        if (in_flight > 0)
+        {
+            before = flow.paused;
+            flow_ctrl_add(&flow, CHUNK);
+            hysteresis_check(&flow, before);
+            produced += CHUNK;
+            if (flow.paused)
+            {
+                in_flight--;
+            }
+        }
+        else
+        {
+            paused_ticks++;
+        }
+
+        uint32_t drain = MIN(drain_per_tick, flow.level);
+        before = flow.paused;
+        flow_ctrl_remove(&flow, drain);
+        hysteresis_check(&flow, before);
+        drained += drain;
+
+        // The producer overshoots the high watermark by at most the chunks it had armed.
+        CHECK(flow.level <= HIGH + CHUNKS_ARMED * CHUNK);
+    }
+
+    CHECK(m_alternates);
+    CHECK(produced - drained == flow.level);
+    CHECK(flow.level_max <= HIGH + CHUNKS_ARMED * CHUNK);
+    if (drain_per_tick >= CHUNK)
+    {
+        CHECK(m_pauses == 0);
+    }
+    else
+    {
+        CHECK(m_pauses > 0);
+        CHECK((m_pauses == m_resumes) || (m_pauses == m_resumes + 1));
+        // Hysteresis: a pause/resume cycle drains at least high - low bytes.
+        CHECK(m_resumes <= drained / (HIGH - LOW));
+    }
+
+    printf("flow_ctrl, drain %3u bytes/tick: %u pauses, paused %5.1f%% of ticks, level max %u\n",
+           drain_per_tick, m_pauses, 100.0 * paused_ticks / 100000, flow.level_max);
+}
+
+static void test_reset(void)
+{
+    flow_ctrl_t flow;
+
+    counters_reset();
+    flow_ctrl_init(&flow, HIGH, LOW, handler, &flow);
+
+    // Reset while running does not call the handler.
+    flow_ctrl_add(&flow, HIGH - 1);
+    flow_ctrl_reset(&flow);
+    CHECK(flow.level == 0);
+    CHECK(m_pauses == 0);
+    CHECK(m_resumes == 0);
+
+    // Reset while paused resumes once, and the level max is kept.
+    flow_ctrl_add(&flow, HIGH + 10);
+    CHECK(flow.paused);
+    flow_ctrl_remove(&flow, 20);
+    CHECK(flow.paused);
+    flow_ctrl_reset(&flow);
+    CHECK(!flow.paused);
+    CHECK(flow.level == 0);
+    CHECK(flow.level_max == HIGH + 10);
+    CHECK(m_pauses == 1);
+    CHECK(m_resumes == 1);
+
+    // Removing more than is queued stops at zero.
+    flow_ctrl_add(&flow, 10);
+    flow_ctrl_remove(&flow, 1000);
+    CHECK(flow.level == 0);
+    CHECK(m_resumes == 1);
+
+    // Without a handler the state is still tracked.
+    flow_ctrl_init(&flow, HIGH, LOW, NULL, NULL);
+    flow_ctrl_add(&flow, HIGH);
+    CHECK(flow.paused);
+    flow_ctrl_remove(&flow, HIGH - LOW);
+    CHECK(!flow.paused);
+}
+
+int main(void)
+{
+    static uint32_t const drain_rates[] = {1, 8, 20, 32, 48, 63, 64, 100};
+
+    for (size_t i = 0; i < sizeof(drain_rates) / sizeof(drain_rates[0]); i++)
+    {
+        simulate(drain_rates[i]);
+    }
+    test_reset();
+
+    return test_result("flow_ctrl_test");
+}
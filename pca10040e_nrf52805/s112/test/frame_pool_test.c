@@ -0,0 +1,216 @@
+/* Frame pool: exhaustion, free and reallocate, the in use statistics, the double free check, and
+ * two threads allocating and freeing at once, standing in for an interrupt and the main loop.
+ * Every thread fills the blocks it holds with its own pattern, so a block handed out twice is
+ * overwritten and caught. */
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "frame_pool.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#define THREAD_ITERATIONS   2000000
+#define THREAD_HELD_MAX     3       /* Blocks one thread holds at most, two threads fit the pool. */
+
+static frame_pool_stats_t stats_get(void)
+{
+    frame_pool_stats_t stats;
+
+    frame_pool_stats_get(&stats);
+    return stats;
+}
+
+static void test_exhaustion(void)
+{
+    uint8_t * p_blocks[FRAME_POOL_BLOCK_COUNT];
+
+    CHECK(stats_get().in_use == 0);
+
+    // Every block once, word aligned and apart from each other.
+    for (size_t i = 0; i < FRAME_POOL_BLOCK_COUNT; i++)
+    {
+        p_blocks[i] = frame_pool_alloc();
+        CHECK(p_blocks[i] != NULL);
+        CHECK(((uintptr_t)p_blocks[i] % sizeof(uint32_t)) == 0);
+        memset(p_blocks[i], (int)i, FRAME_POOL_BLOCK_SIZE);
+        for (size_t j = 0; j < i; j++)
+        {
+            uint8_t * p_low  = MIN(p_blocks[i], p_blocks[j]);
+            uint8_t * p_high = MAX(p_blocks[i], p_blocks[j]);
+            CHECK(p_low + FRAME_POOL_BLOCK_SIZE <= p_high);
+        }
+    }
+    CHECK(stats_get().in_use == FRAME_POOL_BLOCK_COUNT);
+    CHECK(stats_get().in_use_max == FRAME_POOL_BLOCK_COUNT);
+
+    // Exhausted: refused and counted.
+    CHECK(frame_pool_alloc() == NULL);
+    CHECK(frame_pool_alloc() == NULL);
+    CHECK(stats_get().alloc_failed == 2);
+
+    // Nothing was overwritten.
+    for (size_t i = 0; i < FRAME_POOL_BLOCK_COUNT; i++)
+    {
+        for (size_t k = 0; k < FRAME_POOL_BLOCK_SIZE; k++)
+        {
+            CHECK(p_blocks[i][k] == (uint8_t)i);
+        }
+    }
+
+    // An address inside the block frees it, and the same block comes back.
+    frame_pool_free(p_blocks[3] + FRAME_POOL_BLOCK_SIZE - 1);
+    CHECK(stats_get().in_use == FRAME_POOL_BLOCK_COUNT - 1);
+    CHECK(frame_pool_alloc() == p_blocks[3]);
+    CHECK(frame_pool_alloc() == NULL);
+
+    // The lowest free block is taken first.
+    frame_pool_free(p_blocks[5]);
+    frame_pool_free(p_blocks[1]);
+    uint8_t * p_first  = frame_pool_alloc();
+    uint8_t * p_second = frame_pool_alloc();
+    CHECK(p_first == MIN(p_blocks[1], p_blocks[5]));
+    CHECK(p_second == MAX(p_blocks[1], p_blocks[5]));
+
+    for (size_t i = 0; i < FRAME_POOL_BLOCK_COUNT; i++)
+    {
+        frame_pool_free(p_blocks[i]);
+    }
+
+    // The maximum is kept once the blocks are back.
+    frame_pool_stats_t stats = stats_get();
+    CHECK(stats.in_use == 0);
+    CHECK(stats.in_use_max == FRAME_POOL_BLOCK_COUNT);
+    CHECK(stats.alloc_failed == 3);
+}
+
+/* A block freed twice must trip the assertion, checked in a child process. */
+static void test_double_free(void)
+{
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Keep the expected assertion message out of the test output.
+        UNUSED_RETURN_VALUE(freopen("/dev/null", "w", stderr));
+
+        uint8_t * p_block = frame_pool_alloc();
+        frame_pool_free(p_block);
+        frame_pool_free(p_block);
+        _exit(0);
+    }
+
+    int status = 0;
+    CHECK(pid > 0);
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFSIGNALED(status) && (WTERMSIG(status) == SIGABRT));
+}
+
+typedef struct
+{
+    uint8_t  pattern;
+    uint32_t seed;
+    uint32_t corrupted;
+    uint32_t refused;
+} thread_ctx_t;
+
+static void * thread_main(void * p_arg)
+{
+    thread_ctx_t * p_ctx = p_arg;
+    uint8_t *      p_held[THREAD_HELD_MAX];
+    size_t         held = 0;
+
+    for (uint32_t n = 0; n < THREAD_ITERATIONS; n++)
+    {
+        bool alloc = (held == 0) || ((held < THREAD_HELD_MAX) && (test_rand(&p_ctx->seed) & 1));
+
+        if (alloc)
+        {
+            uint8_t * p_block = frame_pool_alloc();
+            if (p_block == NULL)
+            {
+                p_ctx->refused++;
+                continue;
+            }
+            memset(p_block, p_ctx->pattern, FRAME_POOL_BLOCK_SIZE);
+            p_held[held++] = p_block;
+        }
+        else
+        {
+            // Free a random block after checking nobody else wrote to it.
+            size_t    i       = test_rand(&p_ctx->seed) % held;
+            uint8_t * p_block = p_held[i];
+
+            if ((p_block[0] != p_ctx->pattern) || (p_block[FRAME_POOL_BLOCK_SIZE - 1] != p_ctx->pattern) ||
+                (p_block[test_rand(&p_ctx->seed) % FRAME_POOL_BLOCK_SIZE] != p_ctx->pattern))
+            {
+                p_ctx->corrupted++;
+            }
+            p_held[i] = p_held[--held];
+            frame_pool_free(p_block);
+        }
+    }
+
+    while (held > 0)
+    {
+        frame_pool_free(p_held[--held]);
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    thread_ctx_t ctx[2] =
+    {
+        {.pattern = 0xA1, .seed = 0x1234},
+        {.pattern = 0xB2, .seed = 0x9876},
+    };
+    pthread_t    threads[2];
+
+    uint32_t failed_before = stats_get().alloc_failed;
+
+    for (size_t i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        CHECK(pthread_create(&threads[i], NULL, thread_main, &ctx[i]) == 0);
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        CHECK(pthread_join(threads[i], NULL) == 0);
+    }
+
+    frame_pool_stats_t stats = stats_get();
+    CHECK(ctx[0].corrupted == 0);
+    CHECK(ctx[1].corrupted == 0);
+    // Two threads holding at most THREAD_HELD_MAX each never exhaust the pool.
+    CHECK(ctx[0].refused + ctx[1].refused == 0);
+    CHECK(stats.alloc_failed == failed_before);
+    CHECK(stats.in_use == 0);
+
+    // Every block can still be taken, so no free was lost.
+    uint8_t * p_blocks[FRAME_POOL_BLOCK_COUNT];
+    for (size_t i = 0; i < FRAME_POOL_BLOCK_COUNT; i++)
+    {
+        p_blocks[i] = frame_pool_alloc();
+        CHECK(p_blocks[i] != NULL);
+    }
+    CHECK(frame_pool_alloc() == NULL);
+    for (size_t i = 0; i < FRAME_POOL_BLOCK_COUNT; i++)
+    {
+        frame_pool_free(p_blocks[i]);
+    }
+    CHECK(stats_get().in_use == 0);
+
+    printf("frame_pool, 2 threads x %u operations: no block handed out twice, none lost\n", THREAD_ITERATIONS);
+}
+
+int main(void)
+{
+    test_exhaustion();
+    test_double_free();
+    test_threads();
+
+    return test_result("frame_pool_test");
+}
@@ -0,0 +1,315 @@
+/* Frame scanner: frames are rebuilt from the descriptors, honouring trim, and compared with the
+ * frames that were sent, for every way of splitting a short stream into two or three chunks, for
+ * one byte chunks, and for random splits at random alignments. The benchmark compares the word
+ * at a time scan with the per-byte trailer check it replaced. */
+#include <string.h>
+
+#include "frame_scanner.h"
+#include "nordic_common.h"
+#include "test_util.h"
+
+#define MAX_LEN         244
+#define FRAMES_MAX      4096
+
+static uint8_t  m_expected[FRAMES_MAX][MAX_LEN];
+static uint16_t m_expected_len[FRAMES_MAX];
+static size_t   m_expected_count;
+
+/* Frames rebuilt from the descriptors. */
+static uint8_t  m_frame[MAX_LEN + FRAME_SCANNER_TRAILER_LEN];
+static size_t   m_frame_len;
+static size_t   m_frame_count;
+static uint32_t m_trims[FRAME_SCANNER_TRAILER_LEN];  /* Descriptors by trim. */
+static bool     m_ok;
+
+static void rebuild_handler(uint8_t const * p_chunk, frame_desc_t const * p_desc, void * p_context)
+{
+    if (p_desc->trim > 0)
+    {
+        // The first trailer bytes were reported with the previous chunk.
+        if (p_desc->trim > m_frame_len)
+        {
+            m_ok = false;
+            return;
+        }
+        m_frame_len -= p_desc->trim;
+    }
+    if (p_desc->trim < FRAME_SCANNER_TRAILER_LEN)
+    {
+        m_trims[p_desc->trim]++;
+    }
+
+    if (m_frame_len + p_desc->length > sizeof(m_frame))
+    {
+        m_ok = false;
+        return;
+    }
+    memcpy(m_frame + m_frame_len, p_chunk + p_desc->offset, p_desc->length);
+    m_frame_len += p_desc->length;
+
+    if (p_desc->complete)
+    {
+        if ((m_frame_count >= m_expected_count) ||
+            (m_frame_len != m_expected_len[m_frame_count]) ||
+            (memcmp(m_frame, m_expected[m_frame_count], m_frame_len) != 0))
+        {
+            m_ok = false;
+        }
+        m_frame_count++;
+        m_frame_len = 0;
+    }
+}
+
+/* Build a stream of frames, each ending in the trailer. With @p bias, payload bytes are often
+ * trailer bytes, so partial trailers show up next to real ones. The full trailer never occurs
+ * inside a frame. */
+static size_t stream_build(uint8_t * p_stream, size_t frames, size_t len_max, bool bias, uint32_t * p_seed)
+{
+    static uint8_t const trailer[] = {0xA5, 0xA6, 0xA7};
+    size_t               pos       = 0;
+
+    m_expected_count = frames;
+    for (size_t f = 0; f < frames; f++)
+    {
+        size_t len = 1 + test_rand(p_seed) % len_max;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            uint8_t byte = (uint8_t)test_rand(p_seed);
+            if (bias && ((test_rand(p_seed) % 3) == 0))
+            {
+                byte = trailer[test_rand(p_seed) % 3];
+            }
+            if ((byte == 0xA7) && (i >= 2) &&
+                (m_expected[f][i - 2] == 0xA5) && (m_expected[f][i - 1] == 0xA6))
+            {
+                byte = 0x00;
+            }
+            m_expected[f][i] = byte;
+        }
+        m_expected_len[f] = (uint16_t)len;
+
+        memcpy(p_stream + pos, m_expected[f], len);
+        pos += len;
+        memcpy(p_stream + pos, trailer, sizeof(trailer));
+        pos += sizeof(trailer);
+    }
+
+    return pos;
+}
+
+static void rebuild_start(frame_scanner_t * p_scanner, uint16_t max_len)
+{
+    frame_scanner_init(p_scanner, max_len, rebuild_handler, NULL);
+    m_frame_len   = 0;
+    m_frame_count = 0;
+    m_ok          = true;
+}
+
+/* Scan a chunk from a copy at the given alignment, so the word path sees every alignment. */
+static void scan_aligned(frame_scanner_t * p_scanner, uint8_t const * p_chunk, size_t length, size_t align)
+{
+    static uint8_t buf[MAX_LEN * FRAMES_MAX + 8] __attribute__((aligned(4)));
+
+    memcpy(buf + align, p_chunk, length);
+    frame_scanner_scan(p_scanner, buf + align, length);
+}
+
+static void test_every_split(void)
+{
+    uint8_t         stream[64];
+    uint32_t        seed = 1;
+    frame_scanner_t scanner;
+    uint32_t        trims[FRAME_SCANNER_TRAILER_LEN] = {0};
+
+    size_t length = stream_build(stream, 4, 9, true, &seed);
+    CHECK(length <= sizeof(stream));
+
+    for (size_t a = 0; a <= length; a++)
+    {
+        for (size_t b = a; b <= length; b++)
+        {
+            memset(m_trims, 0, sizeof(m_trims));
+            rebuild_start(&scanner, MAX_LEN);
+            scan_aligned(&scanner, stream, a, a % 4);
+            scan_aligned(&scanner, stream + a, b - a, b % 4);
+            scan_aligned(&scanner, stream + b, length - b, 0);
+
+            CHECK(m_ok);
+            CHECK(m_frame_count == m_expected_count);
+            CHECK(m_frame_len == 0);
+            trims[1] += m_trims[1];
+            trims[2] += m_trims[2];
+        }
+    }
+    // Splits after the first and after the second trailer byte must have been exercised.
+    CHECK(trims[1] > 0);
+    CHECK(trims[2] > 0);
+
+    // One byte at a time: every trailer is split after its second byte.
+    memset(m_trims, 0, sizeof(m_trims));
+    rebuild_start(&scanner, MAX_LEN);
+    for (size_t i = 0; i < length; i++)
+    {
+        frame_scanner_scan(&scanner, stream + i, 1);
+    }
+    CHECK(m_ok);
+    CHECK(m_frame_count == m_expected_count);
+    CHECK(m_trims[2] == m_expected_count);
+    CHECK(m_trims[1] == 0);
+}
+
+static void test_random_splits(void)
+{
+    static uint8_t  stream[MAX_LEN * FRAMES_MAX];
+    uint32_t        seed = 0xC0FFEE;
+    frame_scanner_t scanner;
+
+    size_t length = stream_build(stream, FRAMES_MAX, MAX_LEN - FRAME_SCANNER_TRAILER_LEN, true, &seed);
+
+    for (int run = 0; run < 8; run++)
+    {
+        rebuild_start(&scanner, MAX_LEN);
+        for (size_t pos = 0; pos < length; )
+        {
+            size_t chunk = 1 + test_rand(&seed) % 80;
+
+            chunk = MIN(chunk, length - pos);
+            scan_aligned(&scanner, stream + pos, chunk, test_rand(&seed) % 4);
+            pos += chunk;
+        }
+        CHECK(m_ok);
+        CHECK(m_frame_count == m_expected_count);
+    }
+}
+
+static void cut_handler(uint8_t const * p_chunk, frame_desc_t const * p_desc, void * p_context)
+{
+    size_t * p_lengths = p_context;
+
+    m_frame_len += p_desc->length;
+    if (p_desc->complete)
+    {
+        p_lengths[m_frame_count++] = m_frame_len;
+        m_frame_len = 0;
+    }
+}
+
+static void test_max_len_cut(void)
+{
+    uint8_t         stream[100];
+    size_t          lengths[8] = {0};
+    frame_scanner_t scanner;
+
+    // No trailer: cut every max_len bytes, nothing trimmed, the rest stays in progress.
+    memset(stream, 0x11, sizeof(stream));
+    m_frame_len   = 0;
+    m_frame_count = 0;
+    frame_scanner_init(&scanner, 30, cut_handler, lengths);
+    frame_scanner_scan(&scanner, stream, 45);
+    frame_scanner_scan(&scanner, stream + 45, 55);
+    CHECK(m_frame_count == 3);
+    CHECK((lengths[0] == 30) && (lengths[1] == 30) && (lengths[2] == 30));
+    CHECK(m_frame_len == 10);
+
+    // A trailer that ends exactly at max_len is still a trailer.
+    stream[7] = 0xA5;
+    stream[8] = 0xA6;
+    stream[9] = 0xA7;
+    m_frame_len   = 0;
+    m_frame_count = 0;
+    frame_scanner_init(&scanner, 10, cut_handler, lengths);
+    frame_scanner_scan(&scanner, stream, 10);
+    CHECK(m_frame_count == 1);
+    CHECK(lengths[0] == 7);
+
+    // Reset drops the carry, so a trailer cannot be completed across it.
+    m_frame_len   = 0;
+    m_frame_count = 0;
+    frame_scanner_init(&scanner, MAX_LEN, cut_handler, lengths);
+    frame_scanner_scan(&scanner, stream + 6, 3);
+    frame_scanner_reset(&scanner);
+    frame_scanner_scan(&scanner, stream + 9, 1);
+    CHECK(m_frame_count == 0);
+}
+
+/* The check the scanner replaced: every byte copied into the frame and the last three compared. */
+static size_t reference_scan(uint8_t const * p_chunk, size_t length)
+{
+    static uint8_t data_array[MAX_LEN];
+    static size_t  index;
+    size_t         frames = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data_array[index++] = p_chunk[i];
+
+        if (((index > 3) &&
+             (data_array[index - 3] == 0xA5) &&
+             (data_array[index - 2] == 0xA6) &&
+             (data_array[index - 1] == 0xA7)) ||
+            (index >= MAX_LEN))
+        {
+            frames++;
+            index = 0;
+        }
+    }
+
+    return frames;
+}
+
+static void count_handler(uint8_t const * p_chunk, frame_desc_t const * p_desc, void * p_context)
+{
+    *(size_t *)p_context += p_desc->complete;
+}
+
+static void bench(void)
+{
+    enum { REPEAT = 20 };
+
+    static uint8_t  stream[MAX_LEN * FRAMES_MAX] __attribute__((aligned(4)));
+    uint32_t        seed     = 7;
+    size_t          frames_s = 0;
+    size_t          frames_r = 0;
+    frame_scanner_t scanner;
+
+    // Frames of random bytes up to a full notification, scanned in UART DMA chunks.
+    size_t length = stream_build(stream, FRAMES_MAX, MAX_LEN - FRAME_SCANNER_TRAILER_LEN, false, &seed);
+
+    frame_scanner_init(&scanner, MAX_LEN, count_handler, &frames_s);
+
+    uint64_t start = test_cycles();
+    for (int r = 0; r < REPEAT; r++)
+    {
+        for (size_t pos = 0; pos < length; pos += 64)
+        {
+            frame_scanner_scan(&scanner, stream + pos, MIN(64, length - pos));
+        }
+    }
+    uint64_t scan_cycles = test_cycles() - start;
+
+    start = test_cycles();
+    for (int r = 0; r < REPEAT; r++)
+    {
+        for (size_t pos = 0; pos < length; pos += 64)
+        {
+            frames_r += reference_scan(stream + pos, MIN(64, length - pos));
+        }
+    }
+    uint64_t ref_cycles = test_cycles() - start;
+
+    CHECK(frames_s == REPEAT * FRAMES_MAX);
+    CHECK(frames_r == REPEAT * FRAMES_MAX);
+    printf("frame_scanner, %zu bytes in 64 byte chunks: word scan %.2f bytes/cycle, per-byte check %.2f bytes/cycle\n",
+           length, (double)REPEAT * length / scan_cycles, (double)REPEAT * length / ref_cycles);
+}
+
+int main(void)
+{
+    test_every_split();
+    test_random_splits();
+    test_max_len_cut();
+    bench();
+
+    return test_result("frame_scanner_test");
+}
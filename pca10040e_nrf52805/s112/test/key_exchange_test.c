@@ -0,0 +1,264 @@
+/* Key exchanges against the RFC 7748 section 6.1 X25519 vectors, and against OpenSSL playing the
+ * central on both curves. The public key is checked as sent on the air, the shared secret through
+ * the CBC receive key, which is the raw secret. The benchmark times the key pair and the whole key
+ * exchange job on each curve. nrf_crypto is stood in for by OpenSSL, see
+ * stub/nrf_crypto_ecc_openssl.c, the only ECC backend on the host: the figures compare the curves
+ * with each other, the nRF52805 backends are timed by the Bench build, see crypto_bench.h. */
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "crypto_session.h"
+#include "key_exchange.h"
+#include "nordic_common.h"
+#include "nrf_crypto_ecc.h"
+#include "resume_cache.h"
+#include "test_util.h"
+
+static uint8_t const m_alice_private[] =
+{
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d, 0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a, 0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a,
+};
+static uint8_t const m_alice_public[] =
+{
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54, 0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4, 0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a,
+};
+static uint8_t const m_bob_private[] =
+{
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b, 0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd, 0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb,
+};
+static uint8_t const m_bob_public[] =
+{
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4, 0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d, 0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f,
+};
+static uint8_t const m_shared_secret[] =
+{
+    0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1, 0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+    0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33, 0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42,
+};
+
+static bool       m_done;
+static ret_code_t m_result;
+static uint32_t   m_remembered;
+
+/* resume_cache stand-in, sessions are only counted. */
+void resume_cache_put(uint8_t const * p_id, uint8_t const * p_secret)
+{
+    m_remembered++;
+}
+
+ret_code_t resume_cache_get(uint8_t const * p_id, uint8_t * p_secret)
+{
+    return NRF_ERROR_NOT_FOUND;
+}
+
+static void job_done(ret_code_t result, uint32_t latency_us)
+{
+    m_done   = true;
+    m_result = result;
+}
+
+/* Run a key exchange job to its end, as the main loop does one step per pass. */
+static ret_code_t exchange(key_exchange_curve_t curve, uint8_t const * p_peer_key)
+{
+    m_done = false;
+
+    ret_code_t err_code = key_exchange_start(curve, p_peer_key, job_done);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    while (key_exchange_is_busy())
+    {
+        key_exchange_process();
+    }
+    CHECK(m_done);
+
+    return m_result;
+}
+
+/* Check the session secret: a block encrypted with @p p_secret as the AES-256-CBC key decrypts
+ * with the receive key. */
+static bool secret_is(uint8_t const * p_secret)
+{
+    static uint8_t const iv[CRYPTO_SESSION_BLOCK_SIZE];
+    static uint8_t const plain[CRYPTO_SESSION_BLOCK_SIZE] = "shared secret ok";
+    uint8_t              block[CRYPTO_SESSION_BLOCK_SIZE];
+    int                  len;
+    size_t               out_len;
+    EVP_CIPHER_CTX *     p_ctx = EVP_CIPHER_CTX_new();
+
+    CHECK(EVP_EncryptInit_ex(p_ctx, EVP_aes_256_cbc(), NULL, p_secret, iv));
+    CHECK(EVP_CIPHER_CTX_set_padding(p_ctx, 0));
+    CHECK(EVP_EncryptUpdate(p_ctx, block, &len, plain, sizeof(plain)));
+    EVP_CIPHER_CTX_free(p_ctx);
+
+    return (crypto_session_decrypt(block, sizeof(block), &out_len) == NRF_SUCCESS) &&
+           (memcmp(block, plain, sizeof(plain)) == 0);
+}
+
+/* Make the next key pair generated that of an RFC 7748 private key, given in nrf_crypto raw byte
+ * order. */
+static void x25519_private_key_set(uint8_t const * p_private)
+{
+    uint8_t raw[KEY_EXCHANGE_SECRET_SIZE];
+
+    for (size_t i = 0; i < sizeof(raw); i++)
+    {
+#if NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED
+        raw[i] = p_private[sizeof(raw) - 1 - i];
+#else
+        raw[i] = p_private[i];
+#endif
+    }
+    nrf_crypto_ecc_next_private_key_set(raw, sizeof(raw));
+}
+
+/* Both ends of the RFC 7748 example, the peripheral as Alice and as Bob. Keys and the secret are
+ * little endian on the air, byte for byte as in the RFC, whatever order nrf_crypto keeps. */
+static void test_rfc7748(void)
+{
+    uint8_t const * p_key;
+
+    x25519_private_key_set(m_alice_private);
+    p_key = key_exchange_public_key_get(KEY_EXCHANGE_CURVE_X25519);
+    CHECK((p_key != NULL) && (memcmp(p_key, m_alice_public, sizeof(m_alice_public)) == 0));
+    CHECK(exchange(KEY_EXCHANGE_CURVE_X25519, m_bob_public) == NRF_SUCCESS);
+    CHECK(secret_is(m_shared_secret));
+    key_exchange_session_end();
+
+    x25519_private_key_set(m_bob_private);
+    p_key = key_exchange_public_key_get(KEY_EXCHANGE_CURVE_X25519);
+    CHECK((p_key != NULL) && (memcmp(p_key, m_bob_public, sizeof(m_bob_public)) == 0));
+    CHECK(exchange(KEY_EXCHANGE_CURVE_X25519, m_alice_public) == NRF_SUCCESS);
+    CHECK(secret_is(m_shared_secret));
+    key_exchange_session_end();
+}
+
+/* A central key pair and its public key as sent on the air. */
+static EVP_PKEY * central_key_new(key_exchange_curve_t curve, uint8_t * p_public)
+{
+    EVP_PKEY * p_key = (curve == KEY_EXCHANGE_CURVE_X25519) ? EVP_PKEY_Q_keygen(NULL, NULL, "X25519")
+                                                            : EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256");
+    uint8_t *  p_encoded = NULL;
+    size_t     size      = EVP_PKEY_get1_encoded_public_key(p_key, &p_encoded);
+
+    // secp256r1 goes on the air without the 0x04 of an uncompressed point.
+    size_t skip = (curve == KEY_EXCHANGE_CURVE_SECP256R1) ? 1 : 0;
+    CHECK(size - skip == key_exchange_public_key_size(curve));
+    memcpy(p_public, p_encoded + skip, size - skip);
+    OPENSSL_free(p_encoded);
+
+    return p_key;
+}
+
+/* The secret the central computes with the public key the peripheral sent. */
+static void central_secret(EVP_PKEY * p_central, key_exchange_curve_t curve, uint8_t const * p_peer_key, uint8_t * p_secret)
+{
+    size_t         size  = KEY_EXCHANGE_SECRET_SIZE;
+    EVP_PKEY_CTX * p_ctx = EVP_PKEY_CTX_new(p_central, NULL);
+    EVP_PKEY *     p_peer;
+
+    if (curve == KEY_EXCHANGE_CURVE_X25519)
+    {
+        p_peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, p_peer_key, KEY_EXCHANGE_X25519_PUBLIC_KEY_SIZE);
+    }
+    else
+    {
+        uint8_t point[1 + KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE] = {0x04};
+
+        memcpy(point + 1, p_peer_key, KEY_EXCHANGE_P256_PUBLIC_KEY_SIZE);
+        p_peer = EVP_PKEY_new();
+        CHECK(EVP_PKEY_copy_parameters(p_peer, p_central));
+        CHECK(EVP_PKEY_set1_encoded_public_key(p_peer, point, sizeof(point)));
+    }
+    CHECK(EVP_PKEY_derive_init(p_ctx) > 0);
+    CHECK(EVP_PKEY_derive_set_peer(p_ctx, p_peer) > 0);
+    CHECK((EVP_PKEY_derive(p_ctx, p_secret, &size) > 0) && (size == KEY_EXCHANGE_SECRET_SIZE));
+
+    EVP_PKEY_CTX_free(p_ctx);
+    EVP_PKEY_free(p_peer);
+}
+
+/* Sessions with OpenSSL as the central, a fresh key pair on both ends every time. */
+static void test_central(key_exchange_curve_t curve)
+{
+    uint8_t central_public[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];
+    uint8_t secret[KEY_EXCHANGE_SECRET_SIZE];
+
+    for (uint32_t n = 0; n < 20; n++)
+    {
+        EVP_PKEY *      p_central = central_key_new(curve, central_public);
+        uint8_t const * p_key     = key_exchange_public_key_get(curve);
+
+        CHECK(p_key != NULL);
+        central_secret(p_central, curve, p_key, secret);
+        CHECK(exchange(curve, central_public) == NRF_SUCCESS);
+        CHECK(secret_is(secret));
+
+        key_exchange_session_end();
+        EVP_PKEY_free(p_central);
+    }
+
+    if (curve == KEY_EXCHANGE_CURVE_SECP256R1)
+    {
+        // A point off the curve fails the job, the session keys are kept.
+        memset(central_public, 0x01, sizeof(central_public));
+        CHECK(exchange(curve, central_public) != NRF_SUCCESS);
+        CHECK(secret_is(secret));
+        key_exchange_session_end();
+    }
+}
+
+static void bench(key_exchange_curve_t curve, char const * p_name)
+{
+    enum { RUNS = 500 };
+
+    uint8_t    central_public[KEY_EXCHANGE_PUBLIC_KEY_MAX_SIZE];
+    EVP_PKEY * p_central   = central_key_new(curve, central_public);
+    uint64_t   pair_cycles = 0;
+    uint64_t   job_cycles  = 0;
+
+    for (uint32_t n = 0; n < RUNS; n++)
+    {
+        // The pool is empty, the session generates its key pair.
+        uint64_t start = test_cycles();
+        CHECK(key_exchange_public_key_get(curve) != NULL);
+        pair_cycles += test_cycles() - start;
+
+        start = test_cycles();
+        CHECK(exchange(curve, central_public) == NRF_SUCCESS);
+        job_cycles += test_cycles() - start;
+
+        key_exchange_session_end();
+    }
+    EVP_PKEY_free(p_central);
+
+    printf("key_exchange, %-9s on OpenSSL: key pair %8.0f cycles, key exchange job %8.0f cycles\n",
+           p_name, (double)pair_cycles / RUNS, (double)job_cycles / RUNS);
+}
+
+int main(void)
+{
+    CHECK(crypto_session_cipher_set(CRYPTO_SESSION_CIPHER_CBC) == NRF_SUCCESS);
+
+    test_rfc7748();
+    test_central(KEY_EXCHANGE_CURVE_X25519);
+    test_central(KEY_EXCHANGE_CURVE_SECP256R1);
+
+    key_exchange_stats_t stats;
+    key_exchange_stats_get(&stats);
+    CHECK((stats.completed == 43) && (stats.failed == 1) && (m_remembered == 42));
+
+    bench(KEY_EXCHANGE_CURVE_SECP256R1, "secp256r1");
+    bench(KEY_EXCHANGE_CURVE_X25519, "X25519");
+
+    crypto_session_clear();
+
+    return test_result("key_exchange_test");
+}
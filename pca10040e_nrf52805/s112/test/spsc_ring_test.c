@@ -0,0 +1,331 @@
+/* SPSC ring: a producer and a consumer thread move a known byte sequence through small rings,
+ * with random chunk sizes through both the copy and the span interfaces, and with the indices
+ * starting just below the 2^32 wrap. The consumer checks every byte, both sides check the level
+ * bounds. The benchmark compares cycles per byte with app_fifo, as app_uart used it. */
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "nordic_common.h"
+#include "spsc_ring.h"
+#include "test_util.h"
+
+#define STRESS_BYTES    20000000u
+
+static uint8_t sequence_byte(uint32_t i)
+{
+    return (uint8_t)(i ^ (i >> 8) ^ (i >> 16) ^ (i >> 24));
+}
+
+static void test_basics(void)
+{
+    uint8_t     buf[16];
+    uint8_t     out[32];
+    spsc_ring_t ring;
+
+    CHECK(spsc_ring_init(&ring, buf, 0) == NRF_ERROR_INVALID_PARAM);
+    CHECK(spsc_ring_init(&ring, buf, 12) == NRF_ERROR_INVALID_PARAM);
+    CHECK(spsc_ring_init(&ring, buf, sizeof(buf)) == NRF_SUCCESS);
+    CHECK((spsc_ring_level(&ring) == 0) && (spsc_ring_free(&ring) == 16));
+
+    // Fills up to the size, then refuses.
+    CHECK(spsc_ring_write(&ring, (uint8_t const *)"0123456789abcdefXYZ", 19) == 16);
+    CHECK(spsc_ring_free(&ring) == 0);
+
+    uint8_t * p_span;
+    CHECK(spsc_ring_write_span(&ring, &p_span) == 0);
+
+    // A read across the end of the buffer comes back in order.
+    CHECK(spsc_ring_read(&ring, out, 10) == 10);
+    CHECK(spsc_ring_write(&ring, (uint8_t const *)"ghij", 4) == 4);
+    CHECK(spsc_ring_read(&ring, out, sizeof(out)) == 10);
+    CHECK(memcmp(out, "abcdefghij", 10) == 0);
+
+    // The read span stops at the end of the buffer.
+    uint8_t const * p_read;
+    CHECK(spsc_ring_write(&ring, (uint8_t const *)"0123456789abcd", 14) == 14);
+    size_t span = spsc_ring_read_span(&ring, &p_read);
+    CHECK(span == 12);
+    CHECK(memcmp(p_read, "0123456789ab", 12) == 0);
+    spsc_ring_read_commit(&ring, span);
+    CHECK(spsc_ring_read_span(&ring, &p_read) == 2);
+    CHECK(memcmp(p_read, "cd", 2) == 0);
+
+    // Reset empties it.
+    spsc_ring_reset(&ring);
+    CHECK((spsc_ring_level(&ring) == 0) && (spsc_ring_free(&ring) == 16));
+    CHECK(spsc_ring_read_span(&ring, &p_read) == 0);
+
+    // The indices wrap at 2^32.
+    ring.write = UINT32_MAX - 5;
+    ring.read  = UINT32_MAX - 5;
+    CHECK(spsc_ring_write(&ring, (uint8_t const *)"0123456789ab", 12) == 12);
+    CHECK(spsc_ring_level(&ring) == 12);
+    CHECK(spsc_ring_read(&ring, out, sizeof(out)) == 12);
+    CHECK(memcmp(out, "0123456789ab", 12) == 0);
+    CHECK(ring.read == 6);
+
+    SPSC_RING_DEF(m_defined, 64);
+    CHECK((spsc_ring_free(&m_defined) == 64) && (m_defined.mask == 63));
+}
+
+typedef struct
+{
+    spsc_ring_t * p_ring;
+    uint32_t      seed;
+    uint32_t      errors;
+    uint32_t      spans;        /* Calls through the span interface. */
+    uint32_t      waits;        /* Calls that found the ring full or empty. */
+} side_t;
+
+/* Full or empty: let the other side run, the host may have a single core. */
+static void side_wait(side_t * p_side)
+{
+    p_side->waits++;
+    sched_yield();
+}
+
+static void * producer_main(void * p_arg)
+{
+    side_t *      p_side = p_arg;
+    spsc_ring_t * p_ring = p_side->p_ring;
+    size_t        size   = p_ring->mask + 1;
+    uint8_t       chunk[256];
+
+    for (uint32_t pos = 0; pos < STRESS_BYTES; )
+    {
+        uint32_t r   = test_rand(&p_side->seed);
+        size_t   len = 1 + (r % MIN(sizeof(chunk), size + size / 2));
+
+        len = MIN(len, STRESS_BYTES - pos);
+        if (spsc_ring_level(p_ring) > size)
+        {
+            p_side->errors++;
+        }
+
+        if ((r >> 16) & 1)
+        {
+            uint8_t * p_span;
+            size_t    span = spsc_ring_write_span(p_ring, &p_span);
+
+            span = MIN(span, len);
+
+            for (size_t i = 0; i < span; i++)
+            {
+                p_span[i] = sequence_byte(pos + i);
+            }
+            spsc_ring_write_commit(p_ring, span);
+            pos += span;
+            p_side->spans++;
+            if (span == 0)
+            {
+                side_wait(p_side);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                chunk[i] = sequence_byte(pos + i);
+            }
+            size_t written = spsc_ring_write(p_ring, chunk, len);
+            if (written > len)
+            {
+                p_side->errors++;
+            }
+            pos += written;
+            if (written == 0)
+            {
+                side_wait(p_side);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void * consumer_main(void * p_arg)
+{
+    side_t *      p_side = p_arg;
+    spsc_ring_t * p_ring = p_side->p_ring;
+    size_t        size   = p_ring->mask + 1;
+    uint8_t       chunk[256];
+
+    for (uint32_t pos = 0; pos < STRESS_BYTES; )
+    {
+        uint32_t r   = test_rand(&p_side->seed);
+        size_t   len = 1 + (r % MIN(sizeof(chunk), size + size / 2));
+
+        if (spsc_ring_free(p_ring) > size)
+        {
+            p_side->errors++;
+        }
+
+        uint8_t const * p_data;
+        size_t          got;
+        if ((r >> 16) & 1)
+        {
+            got    = spsc_ring_read_span(p_ring, &p_data);
+            got    = MIN(got, len);
+            p_side->spans++;
+        }
+        else
+        {
+            got    = spsc_ring_read(p_ring, chunk, len);
+            p_data = chunk;
+            if (got > len)
+            {
+                p_side->errors++;
+            }
+        }
+
+        for (size_t i = 0; i < got; i++)
+        {
+            if (p_data[i] != sequence_byte(pos + i))
+            {
+                p_side->errors++;
+            }
+        }
+        if (p_data != chunk)
+        {
+            spsc_ring_read_commit(p_ring, got);
+        }
+        pos += got;
+        if (got == 0)
+        {
+            side_wait(p_side);
+        }
+    }
+    return NULL;
+}
+
+static void stress(size_t size, uint32_t start_index)
+{
+    static uint8_t buf[1024];
+    spsc_ring_t    ring;
+    pthread_t      threads[2];
+
+    CHECK(size <= sizeof(buf));
+    CHECK(spsc_ring_init(&ring, buf, size) == NRF_SUCCESS);
+    ring.write = start_index;
+    ring.read  = start_index;
+
+    side_t producer = {.p_ring = &ring, .seed = 0x1357 + (uint32_t)size};
+    side_t consumer = {.p_ring = &ring, .seed = 0x2468 + (uint32_t)size};
+
+    uint64_t start = test_cycles();
+    CHECK(pthread_create(&threads[0], NULL, producer_main, &producer) == 0);
+    CHECK(pthread_create(&threads[1], NULL, consumer_main, &consumer) == 0);
+    CHECK(pthread_join(threads[0], NULL) == 0);
+    CHECK(pthread_join(threads[1], NULL) == 0);
+    uint64_t cycles = test_cycles() - start;
+
+    CHECK(producer.errors == 0);
+    CHECK(consumer.errors == 0);
+    CHECK(spsc_ring_level(&ring) == 0);
+    CHECK(ring.write == start_index + STRESS_BYTES);
+    // Both interfaces were used, and the ring ran full and empty.
+    CHECK((producer.spans > 0) && (consumer.spans > 0));
+    CHECK((producer.waits > 0) || (consumer.waits > 0));
+
+    printf("spsc_ring, 2 threads, %4zu byte ring from index 0x%08x: %u bytes, %u errors, %.1f cycles/byte\n",
+           size, start_index, STRESS_BYTES, producer.errors + consumer.errors, (double)cycles / STRESS_BYTES);
+}
+
+/* app_fifo from the SDK, as app_uart used it: one byte per put and get, each checking the length
+ * on the volatile indices. The block functions loop over the same per-byte steps. */
+typedef struct
+{
+    uint8_t *         p_buf;
+    uint16_t          buf_size_mask;
+    volatile uint32_t read_pos;
+    volatile uint32_t write_pos;
+} app_fifo_t;
+
+static uint32_t fifo_length(app_fifo_t * p_fifo)
+{
+    uint32_t tmp = p_fifo->read_pos;
+    return p_fifo->write_pos - tmp;
+}
+
+static ret_code_t app_fifo_put(app_fifo_t * p_fifo, uint8_t byte)
+{
+    if (fifo_length(p_fifo) <= p_fifo->buf_size_mask)
+    {
+        p_fifo->p_buf[p_fifo->write_pos & p_fifo->buf_size_mask] = byte;
+        p_fifo->write_pos++;
+        return NRF_SUCCESS;
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+static ret_code_t app_fifo_get(app_fifo_t * p_fifo, uint8_t * p_byte)
+{
+    if (fifo_length(p_fifo) != 0)
+    {
+        *p_byte = p_fifo->p_buf[p_fifo->read_pos & p_fifo->buf_size_mask];
+        p_fifo->read_pos++;
+        return NRF_SUCCESS;
+    }
+    return NRF_ERROR_NOT_FOUND;
+}
+
+static void bench(void)
+{
+    enum { RING_SIZE = 512, CHUNK = 64, BYTES = 64000000 };
+
+    static uint8_t ring_buf[RING_SIZE];
+    static uint8_t fifo_buf[RING_SIZE];
+    uint8_t        in[CHUNK];
+    uint8_t        out[CHUNK];
+    uint32_t       sum_ring = 0;
+    uint32_t       sum_fifo = 0;
+    uint32_t       seed     = 11;
+    spsc_ring_t    ring;
+    app_fifo_t     fifo = {.p_buf = fifo_buf, .buf_size_mask = RING_SIZE - 1};
+
+    for (size_t i = 0; i < sizeof(in); i++)
+    {
+        in[i] = (uint8_t)test_rand(&seed);
+    }
+    CHECK(spsc_ring_init(&ring, ring_buf, sizeof(ring_buf)) == NRF_SUCCESS);
+
+    // One UART DMA chunk in, one chunk out, as the UART interrupt and the main loop do.
+    uint64_t start = test_cycles();
+    for (uint32_t n = 0; n < BYTES / CHUNK; n++)
+    {
+        UNUSED_RETURN_VALUE(spsc_ring_write(&ring, in, CHUNK));
+        UNUSED_RETURN_VALUE(spsc_ring_read(&ring, out, CHUNK));
+        sum_ring += out[n % CHUNK];
+    }
+    uint64_t ring_cycles = test_cycles() - start;
+
+    start = test_cycles();
+    for (uint32_t n = 0; n < BYTES / CHUNK; n++)
+    {
+        for (size_t i = 0; i < CHUNK; i++)
+        {
+            UNUSED_RETURN_VALUE(app_fifo_put(&fifo, in[i]));
+        }
+        for (size_t i = 0; i < CHUNK; i++)
+        {
+            UNUSED_RETURN_VALUE(app_fifo_get(&fifo, &out[i]));
+        }
+        sum_fifo += out[n % CHUNK];
+    }
+    uint64_t fifo_cycles = test_cycles() - start;
+
+    CHECK(sum_ring == sum_fifo);
+    printf("spsc_ring, %u byte chunks through a %u byte ring: spsc_ring %.2f cycles/byte, app_fifo %.2f cycles/byte\n",
+           CHUNK, RING_SIZE, (double)ring_cycles / BYTES, (double)fifo_cycles / BYTES);
+}
+
+int main(void)
+{
+    test_basics();
+    stress(16, 0);
+    stress(64, UINT32_MAX - 1000);
+    stress(1024, 0x80000000u - 7);
+    bench();
+
+    return test_result("spsc_ring_test");
+}
@@ -0,0 +1,27 @@
+/* Host stand-in for the SDK header, just enough for the modules under test. */
+#ifndef APP_ERROR_H
+#define APP_ERROR_H
+#include <assert.h>
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS                 0
+#define NRF_ERROR_INTERNAL          3
+#define NRF_ERROR_NO_MEM            4
+#define NRF_ERROR_NOT_FOUND         5
+#define NRF_ERROR_NOT_SUPPORTED     6
+#define NRF_ERROR_INVALID_PARAM     7
+#define NRF_ERROR_INVALID_STATE     8
+#define NRF_ERROR_INVALID_LENGTH    9
+#define NRF_ERROR_INVALID_DATA      11
+#define NRF_ERROR_DATA_SIZE         12
+#define NRF_ERROR_TIMEOUT           13
+#define NRF_ERROR_NULL              14
+#define NRF_ERROR_FORBIDDEN         15
+#define NRF_ERROR_BUSY              17
+#define NRF_ERROR_RESOURCES         19
+
+#define APP_ERROR_CHECK(err_code)   assert((err_code) == NRF_SUCCESS)
+
+#endif //APP_ERROR_H
@@ -0,0 +1,72 @@
+/* Host stand-in for the SDK header. Timers are created but never fire, tests call the timeout
+ * handlers themselves where they need them. The counter follows the host clock. */
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "app_error.h"
+
+typedef enum
+{
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+typedef struct
+{
+    app_timer_timeout_handler_t handler;
+    uint32_t                    ticks;
+    void *                      p_context;
+    bool                        running;
+} app_timer_t;
+
+typedef app_timer_t * app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)                                 \
+    static app_timer_t timer_id##_data;                         \
+    static app_timer_id_t const timer_id = &timer_id##_data
+
+#define APP_TIMER_TICKS(ms)         ((uint32_t)(ms) * 32u)
+#define APP_TIMER_CLOCK_FREQ        32768
+#define APP_TIMER_MAX_CNT_VAL       0x00FFFFFF
+
+static inline ret_code_t app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode,
+                                          app_timer_timeout_handler_t handler)
+{
+    (*p_timer_id)->handler = handler;
+    return NRF_SUCCESS;
+}
+
+static inline ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t ticks, void * p_context)
+{
+    timer_id->ticks     = ticks;
+    timer_id->p_context = p_context;
+    timer_id->running   = true;
+    return NRF_SUCCESS;
+}
+
+static inline ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_id->running = false;
+    return NRF_SUCCESS;
+}
+
+static inline uint32_t app_timer_cnt_get(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t ticks = (uint64_t)ts.tv_sec * APP_TIMER_CLOCK_FREQ +
+                     ((uint64_t)ts.tv_nsec * APP_TIMER_CLOCK_FREQ) / 1000000000u;
+    return (uint32_t)(ticks & APP_TIMER_MAX_CNT_VAL);
+}
+
+static inline uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+    return (ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL;
+}
+
+#endif //APP_TIMER_H__
@@ -0,0 +1,27 @@
+/* Host stand-in for the SDK header: the byte order helpers the modules use. */
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+#include <stdint.h>
+
+static inline uint8_t uint16_big_encode(uint16_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)(value >> 8);
+    p_encoded_data[1] = (uint8_t)value;
+    return sizeof(uint16_t);
+}
+
+static inline uint8_t uint32_big_encode(uint32_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)(value >> 24);
+    p_encoded_data[1] = (uint8_t)(value >> 16);
+    p_encoded_data[2] = (uint8_t)(value >> 8);
+    p_encoded_data[3] = (uint8_t)value;
+    return sizeof(uint32_t);
+}
+
+static inline uint16_t uint16_big_decode(const uint8_t * p_encoded_data)
+{
+    return (uint16_t)(((uint16_t)p_encoded_data[0] << 8) | p_encoded_data[1]);
+}
+
+#endif //APP_UTIL_H__
@@ -0,0 +1,11 @@
+/* Host stand-in for the SDK header. The tests call each module from one thread at a time, except
+ * for the lock-free ones, so the critical region is empty. */
+#ifndef APP_UTIL_PLATFORM_H
+#define APP_UTIL_PLATFORM_H
+
+#define CRITICAL_REGION_ENTER()     {
+#define CRITICAL_REGION_EXIT()      }
+
+#define __DMB()                     __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif //APP_UTIL_PLATFORM_H
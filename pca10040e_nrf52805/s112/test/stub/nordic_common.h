@@ -0,0 +1,15 @@
+/* Host stand-in for the SDK header, just enough for the modules under test. */
+#ifndef NORDIC_COMMON_H
+#define NORDIC_COMMON_H
+
+#define MIN(a, b)                   ((a) < (b) ? (a) : (b))
+#define MAX(a, b)                   ((a) < (b) ? (b) : (a))
+#define ARRAY_SIZE(arr)             (sizeof(arr) / sizeof((arr)[0]))
+#define CONCAT_2(p1, p2)            CONCAT_2_(p1, p2)
+#define CONCAT_2_(p1, p2)           p1##p2
+#define STATIC_ASSERT(expr, ...)    _Static_assert(expr, "" __VA_ARGS__)
+#define UNUSED_PARAMETER(x)         ((void)(x))
+#define UNUSED_VARIABLE(x)          ((void)(x))
+#define UNUSED_RETURN_VALUE(x)      ((void)(x))
+
+#endif //NORDIC_COMMON_H
@@ -0,0 +1,40 @@
+/* Host stand-in for the SDK header. The DWT cycle counter reads the clock of test_cycles(),
+ * truncated to 32 bits as on the target: every access to DWT yields a fresh register block, so
+ * writes to it have no effect. SystemCoreClock is the rate of that counter, the test that uses it
+ * sets it. */
+#ifndef NRF_H
+#define NRF_H
+#include <stdint.h>
+#include <time.h>
+
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+
+typedef struct
+{
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+static inline uint32_t nrf_host_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+#define CoreDebug   (&(CoreDebug_Type){0})
+#define DWT         (&(DWT_Type){.CYCCNT = nrf_host_cycles()})
+
+extern uint32_t SystemCoreClock;
+
+#endif //NRF_H
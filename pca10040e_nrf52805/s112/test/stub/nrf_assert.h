@@ -0,0 +1,8 @@
+/* Host stand-in for the SDK header: ASSERT is always checked. */
+#ifndef NRF_ASSERT_H
+#define NRF_ASSERT_H
+#include <assert.h>
+
+#define ASSERT(expr)                assert(expr)
+
+#endif //NRF_ASSERT_H
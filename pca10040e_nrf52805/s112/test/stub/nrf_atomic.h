@@ -0,0 +1,34 @@
+/* Host stand-in for the SDK header, on the compiler's atomic builtins. */
+#ifndef NRF_ATOMIC_H
+#define NRF_ATOMIC_H
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef volatile uint32_t nrf_atomic_u32_t;
+
+static inline uint32_t nrf_atomic_u32_add(nrf_atomic_u32_t * p_data, uint32_t value)
+{
+    return __atomic_add_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_sub(nrf_atomic_u32_t * p_data, uint32_t value)
+{
+    return __atomic_sub_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_or(nrf_atomic_u32_t * p_data, uint32_t value)
+{
+    return __atomic_or_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_or(nrf_atomic_u32_t * p_data, uint32_t value)
+{
+    return __atomic_fetch_or(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool nrf_atomic_u32_cmp_exch(nrf_atomic_u32_t * p_data, uint32_t * p_expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(p_data, p_expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#endif //NRF_ATOMIC_H
@@ -0,0 +1,70 @@
+/* Host stand-in for the SDK header: the AES-256-CBC, AES-128-CTR and HMAC-SHA256 parts of
+ * nrf_crypto the modules use, implemented on OpenSSL in nrf_crypto_openssl.c. */
+#ifndef NRF_CRYPTO_H__
+#define NRF_CRYPTO_H__
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+#define NRF_CRYPTO_AES_CBC_ENABLED  1
+#define NRF_CRYPTO_AES_CTR_ENABLED  1
+
+typedef enum
+{
+    NRF_CRYPTO_DECRYPT = 0,
+    NRF_CRYPTO_ENCRYPT = 1,
+} nrf_crypto_operation_t;
+
+typedef struct
+{
+    uint32_t key_size;      /**< In bytes. */
+    uint32_t mode;          /**< Index of the OpenSSL cipher in nrf_crypto_openssl.c. */
+} nrf_crypto_aes_info_t;
+
+typedef struct
+{
+    void *                        p_cipher_ctx;     /**< EVP_CIPHER_CTX, kept across init and uninit. */
+    nrf_crypto_aes_info_t const * p_info;
+    nrf_crypto_operation_t        operation;
+    uint8_t                       key_set;
+} nrf_crypto_aes_context_t;
+
+typedef struct
+{
+    uint32_t digest_size;
+} nrf_crypto_hmac_info_t;
+
+typedef struct
+{
+    uint8_t unused;
+} nrf_crypto_hmac_context_t;
+
+typedef enum
+{
+    NRF_CRYPTO_HKDF_EXTRACT_AND_EXPAND,
+    NRF_CRYPTO_HKDF_EXPAND_ONLY,
+} nrf_crypto_hkdf_mode_t;
+
+extern nrf_crypto_aes_info_t const  g_nrf_crypto_aes_cbc_256_info;
+extern nrf_crypto_aes_info_t const  g_nrf_crypto_aes_ctr_128_info;
+extern nrf_crypto_hmac_info_t const g_nrf_crypto_hmac_sha256_info;
+
+ret_code_t nrf_crypto_aes_init(nrf_crypto_aes_context_t * p_context, nrf_crypto_aes_info_t const * p_info,
+                               nrf_crypto_operation_t operation);
+ret_code_t nrf_crypto_aes_uninit(nrf_crypto_aes_context_t * p_context);
+ret_code_t nrf_crypto_aes_key_set(nrf_crypto_aes_context_t * p_context, uint8_t * p_key);
+ret_code_t nrf_crypto_aes_iv_set(nrf_crypto_aes_context_t * p_context, uint8_t * p_iv);
+ret_code_t nrf_crypto_aes_finalize(nrf_crypto_aes_context_t * p_context, uint8_t * p_data_in, size_t data_size,
+                                   uint8_t * p_data_out, size_t * p_data_out_size);
+ret_code_t nrf_crypto_aes_crypt(nrf_crypto_aes_context_t * p_context, nrf_crypto_aes_info_t const * p_info,
+                                nrf_crypto_operation_t operation, uint8_t * p_key, uint8_t * p_iv,
+                                uint8_t * p_data_in, size_t data_size, uint8_t * p_data_out, size_t * p_data_out_size);
+
+ret_code_t nrf_crypto_hkdf_calculate(nrf_crypto_hmac_context_t * p_context, nrf_crypto_hmac_info_t const * p_info,
+                                     uint8_t * p_output_key, size_t * p_output_key_size,
+                                     uint8_t const * p_input_key, size_t input_key_size,
+                                     uint8_t const * p_salt, size_t salt_size,
+                                     uint8_t const * p_ainfo, size_t ainfo_size,
+                                     nrf_crypto_hkdf_mode_t mode);
+
+#endif //NRF_CRYPTO_H__
@@ -0,0 +1,34 @@
+/* Host stand-in for the SDK header: AES-128-CCM and AES-128-GCM, implemented on OpenSSL in
+ * nrf_crypto_openssl.c. */
+#ifndef NRF_CRYPTO_AEAD_H__
+#define NRF_CRYPTO_AEAD_H__
+#include "nrf_crypto.h"
+
+#define NRF_CRYPTO_AES_CCM_ENABLED  1
+#define NRF_CRYPTO_AES_GCM_ENABLED  1
+
+typedef struct
+{
+    uint32_t key_size;      /**< In bytes. */
+    uint32_t mode;          /**< Index of the OpenSSL cipher in nrf_crypto_openssl.c. */
+} nrf_crypto_aead_info_t;
+
+typedef struct
+{
+    void *                         p_cipher_ctx;    /**< EVP_CIPHER_CTX. */
+    nrf_crypto_aead_info_t const * p_info;
+    uint8_t                        key[16];
+} nrf_crypto_aead_context_t;
+
+extern nrf_crypto_aead_info_t const g_nrf_crypto_aes_ccm_128_info;
+extern nrf_crypto_aead_info_t const g_nrf_crypto_aes_gcm_128_info;
+
+ret_code_t nrf_crypto_aead_init(nrf_crypto_aead_context_t * p_context, nrf_crypto_aead_info_t const * p_info,
+                                uint8_t * p_key);
+ret_code_t nrf_crypto_aead_uninit(void * p_context);
+ret_code_t nrf_crypto_aead_crypt(nrf_crypto_aead_context_t * p_context, nrf_crypto_operation_t operation,
+                                 uint8_t * p_nonce, size_t nonce_size, uint8_t * p_adata, size_t adata_size,
+                                 uint8_t * p_data_in, size_t data_in_size, uint8_t * p_data_out,
+                                 uint8_t * p_mac, size_t mac_size);
+
+#endif //NRF_CRYPTO_AEAD_H__
@@ -0,0 +1,70 @@
+/* Host stand-in for the SDK header: the secp256r1 and Curve25519 parts of nrf_crypto_ecc the
+ * modules use, implemented on OpenSSL in nrf_crypto_ecc_openssl.c. Raw Curve25519 values are
+ * little endian unless NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED is set, as in the SDK. */
+#ifndef NRF_CRYPTO_ECC_H__
+#define NRF_CRYPTO_ECC_H__
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "sdk_config.h"
+
+#define NRF_CRYPTO_ECC_SECP256R1_ENABLED    1
+#define NRF_CRYPTO_ECC_CURVE25519_ENABLED   1
+
+typedef struct
+{
+    uint8_t unused;                 /**< OpenSSL keeps its own state. */
+} nrf_crypto_ecc_key_pair_generate_context_t;
+
+typedef struct
+{
+    int      nid;                   /**< OpenSSL curve. */
+    uint16_t raw_private_key_size;
+    uint16_t raw_public_key_size;
+} nrf_crypto_ecc_curve_info_t;
+
+typedef struct
+{
+    void *                              p_key;      /**< EVP_PKEY. */
+    nrf_crypto_ecc_curve_info_t const * p_info;
+} nrf_crypto_ecc_private_key_t;
+
+typedef struct
+{
+    void *                              p_key;      /**< EVP_PKEY. */
+    nrf_crypto_ecc_curve_info_t const * p_info;
+} nrf_crypto_ecc_public_key_t;
+
+typedef uint8_t nrf_crypto_ecc_secp256r1_raw_private_key_t[32];
+typedef uint8_t nrf_crypto_ecc_secp256r1_raw_public_key_t[64];     /**< X and Y, big endian. */
+typedef uint8_t nrf_crypto_ecc_curve25519_raw_private_key_t[32];
+typedef uint8_t nrf_crypto_ecc_curve25519_raw_public_key_t[32];
+
+extern nrf_crypto_ecc_curve_info_t const g_nrf_crypto_ecc_secp256r1_curve_info;
+extern nrf_crypto_ecc_curve_info_t const g_nrf_crypto_ecc_curve25519_curve_info;
+
+ret_code_t nrf_crypto_ecc_key_pair_generate(void * p_context, nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                            nrf_crypto_ecc_private_key_t * p_private_key,
+                                            nrf_crypto_ecc_public_key_t * p_public_key);
+ret_code_t nrf_crypto_ecc_private_key_from_raw(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                               nrf_crypto_ecc_private_key_t * p_private_key,
+                                               uint8_t const * p_raw_data, size_t raw_data_size);
+ret_code_t nrf_crypto_ecc_private_key_to_raw(nrf_crypto_ecc_private_key_t const * p_private_key,
+                                             uint8_t * p_raw_data, size_t * p_raw_data_size);
+ret_code_t nrf_crypto_ecc_public_key_from_raw(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                              nrf_crypto_ecc_public_key_t * p_public_key,
+                                              uint8_t const * p_raw_data, size_t raw_data_size);
+ret_code_t nrf_crypto_ecc_public_key_to_raw(nrf_crypto_ecc_public_key_t const * p_public_key,
+                                            uint8_t * p_raw_data, size_t * p_raw_data_size);
+ret_code_t nrf_crypto_ecc_private_key_free(nrf_crypto_ecc_private_key_t * p_private_key);
+ret_code_t nrf_crypto_ecc_public_key_free(nrf_crypto_ecc_public_key_t * p_public_key);
+ret_code_t nrf_crypto_ecc_byte_order_invert(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                            uint8_t const * p_raw_input, uint8_t * p_raw_output,
+                                            size_t raw_data_size);
+
+/**@brief Host only: generate the next key pair from this raw private key instead of a random one,
+ *        for test vectors.
+ */
+void nrf_crypto_ecc_next_private_key_set(uint8_t const * p_raw_data, size_t raw_data_size);
+
+#endif //NRF_CRYPTO_ECC_H__
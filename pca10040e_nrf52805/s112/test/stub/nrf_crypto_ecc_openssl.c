@@ -0,0 +1,349 @@
+/* Host stand-in for the nrf_crypto ECC, ECDH and RNG backends, on OpenSSL. Keys are EVP_PKEYs,
+ * the raw formats are those of nrf_crypto: secp256r1 big endian, Curve25519 in the byte order
+ * NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED selects. */
+#include <stdbool.h>
+#include <string.h>
+
+#include <openssl/core_names.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+#include <openssl/rand.h>
+
+#include "nordic_common.h"
+#include "nrf_crypto_ecc.h"
+#include "nrf_crypto_ecdh.h"
+#include "nrf_crypto_rng.h"
+
+#define P256_COORD_SIZE     32
+#define P256_POINT_SIZE     (1 + 2 * P256_COORD_SIZE)  /* Uncompressed, 0x04 first. */
+
+nrf_crypto_ecc_curve_info_t const g_nrf_crypto_ecc_secp256r1_curve_info  = {NID_X9_62_prime256v1, 32, 64};
+nrf_crypto_ecc_curve_info_t const g_nrf_crypto_ecc_curve25519_curve_info = {NID_X25519, 32, 32};
+
+static uint8_t m_next_private_key[32];
+static size_t  m_next_private_key_size;
+
+static bool is_x25519(nrf_crypto_ecc_curve_info_t const * p_info)
+{
+    return p_info->nid == NID_X25519;
+}
+
+/* Copy a Curve25519 value between OpenSSL, always little endian, and the nrf_crypto raw format. */
+static void x25519_copy(uint8_t * p_out, uint8_t const * p_in, size_t size)
+{
+#if NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED
+    uint8_t value[32];
+
+    memcpy(value, p_in, size);
+    for (size_t i = 0; i < size; i++)
+    {
+        p_out[i] = value[size - 1 - i];
+    }
+#else
+    memmove(p_out, p_in, size);
+#endif
+}
+
+/* secp256r1 key from a group and parameters, a public point and an optional private scalar. */
+static EVP_PKEY * p256_key_new(uint8_t const * p_point, BIGNUM const * p_private)
+{
+    EVP_PKEY *       p_key = NULL;
+    OSSL_PARAM_BLD * p_bld = OSSL_PARAM_BLD_new();
+    OSSL_PARAM *     p_params;
+    EVP_PKEY_CTX *   p_ctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+
+    UNUSED_RETURN_VALUE(OSSL_PARAM_BLD_push_utf8_string(p_bld, OSSL_PKEY_PARAM_GROUP_NAME, "prime256v1", 0));
+    UNUSED_RETURN_VALUE(OSSL_PARAM_BLD_push_octet_string(p_bld, OSSL_PKEY_PARAM_PUB_KEY, p_point, P256_POINT_SIZE));
+    if (p_private != NULL)
+    {
+        UNUSED_RETURN_VALUE(OSSL_PARAM_BLD_push_BN(p_bld, OSSL_PKEY_PARAM_PRIV_KEY, p_private));
+    }
+    p_params = OSSL_PARAM_BLD_to_param(p_bld);
+
+    if ((EVP_PKEY_fromdata_init(p_ctx) <= 0) ||
+        (EVP_PKEY_fromdata(p_ctx, &p_key, (p_private != NULL) ? EVP_PKEY_KEYPAIR : EVP_PKEY_PUBLIC_KEY, p_params) <= 0))
+    {
+        p_key = NULL;
+    }
+
+    OSSL_PARAM_free(p_params);
+    OSSL_PARAM_BLD_free(p_bld);
+    EVP_PKEY_CTX_free(p_ctx);
+
+    return p_key;
+}
+
+/* secp256r1 key pair from a raw private key, the public point computed from it. */
+static EVP_PKEY * p256_private_key_new(uint8_t const * p_raw)
+{
+    uint8_t    point[P256_POINT_SIZE];
+    BIGNUM *   p_private = BN_bin2bn(p_raw, P256_COORD_SIZE, NULL);
+    EC_GROUP * p_group   = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+    EC_POINT * p_point   = EC_POINT_new(p_group);
+    EVP_PKEY * p_key     = NULL;
+
+    if (EC_POINT_mul(p_group, p_point, p_private, NULL, NULL, NULL) &&
+        (EC_POINT_point2oct(p_group, p_point, POINT_CONVERSION_UNCOMPRESSED, point, sizeof(point), NULL) == sizeof(point)))
+    {
+        p_key = p256_key_new(point, p_private);
+    }
+
+    EC_POINT_free(p_point);
+    EC_GROUP_free(p_group);
+    BN_clear_free(p_private);
+
+    return p_key;
+}
+
+void nrf_crypto_ecc_next_private_key_set(uint8_t const * p_raw_data, size_t raw_data_size)
+{
+    memcpy(m_next_private_key, p_raw_data, raw_data_size);
+    m_next_private_key_size = raw_data_size;
+}
+
+ret_code_t nrf_crypto_ecc_key_pair_generate(void * p_context, nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                            nrf_crypto_ecc_private_key_t * p_private_key,
+                                            nrf_crypto_ecc_public_key_t * p_public_key)
+{
+    EVP_PKEY * p_key;
+
+    if (m_next_private_key_size > 0)
+    {
+        ret_code_t err_code = nrf_crypto_ecc_private_key_from_raw(p_curve_info, p_private_key,
+                                                                  m_next_private_key, m_next_private_key_size);
+        m_next_private_key_size = 0;
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        p_key = p_private_key->p_key;
+    }
+    else
+    {
+        p_key = is_x25519(p_curve_info) ? EVP_PKEY_Q_keygen(NULL, NULL, "X25519")
+                                        : EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256");
+        if (p_key == NULL)
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+        p_private_key->p_key  = p_key;
+        p_private_key->p_info = p_curve_info;
+    }
+
+    // Both halves hold the same key.
+    UNUSED_RETURN_VALUE(EVP_PKEY_up_ref(p_key));
+    p_public_key->p_key  = p_key;
+    p_public_key->p_info = p_curve_info;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_private_key_from_raw(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                               nrf_crypto_ecc_private_key_t * p_private_key,
+                                               uint8_t const * p_raw_data, size_t raw_data_size)
+{
+    if (raw_data_size != p_curve_info->raw_private_key_size)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    if (is_x25519(p_curve_info))
+    {
+        uint8_t raw[32];
+
+        x25519_copy(raw, p_raw_data, raw_data_size);
+        p_private_key->p_key = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, raw, sizeof(raw));
+        memset(raw, 0, sizeof(raw));
+    }
+    else
+    {
+        p_private_key->p_key = p256_private_key_new(p_raw_data);
+    }
+    p_private_key->p_info = p_curve_info;
+
+    return (p_private_key->p_key != NULL) ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
+
+ret_code_t nrf_crypto_ecc_private_key_to_raw(nrf_crypto_ecc_private_key_t const * p_private_key,
+                                             uint8_t * p_raw_data, size_t * p_raw_data_size)
+{
+    nrf_crypto_ecc_curve_info_t const * p_info = p_private_key->p_info;
+
+    if (*p_raw_data_size < p_info->raw_private_key_size)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    *p_raw_data_size = p_info->raw_private_key_size;
+
+    if (is_x25519(p_info))
+    {
+        if (!EVP_PKEY_get_raw_private_key(p_private_key->p_key, p_raw_data, p_raw_data_size))
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+        x25519_copy(p_raw_data, p_raw_data, *p_raw_data_size);
+        return NRF_SUCCESS;
+    }
+
+    BIGNUM * p_private = NULL;
+    if (!EVP_PKEY_get_bn_param(p_private_key->p_key, OSSL_PKEY_PARAM_PRIV_KEY, &p_private) ||
+        (BN_bn2binpad(p_private, p_raw_data, P256_COORD_SIZE) != P256_COORD_SIZE))
+    {
+        BN_clear_free(p_private);
+        return NRF_ERROR_INTERNAL;
+    }
+    BN_clear_free(p_private);
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_public_key_from_raw(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                              nrf_crypto_ecc_public_key_t * p_public_key,
+                                              uint8_t const * p_raw_data, size_t raw_data_size)
+{
+    if (raw_data_size != p_curve_info->raw_public_key_size)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    p_public_key->p_info = p_curve_info;
+
+    if (is_x25519(p_curve_info))
+    {
+        uint8_t raw[32];
+
+        x25519_copy(raw, p_raw_data, raw_data_size);
+        p_public_key->p_key = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, raw, sizeof(raw));
+
+        return (p_public_key->p_key != NULL) ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+    }
+
+    // A point that is not on the curve is refused, as by the nrf_crypto backends.
+    uint8_t point[P256_POINT_SIZE] = {POINT_CONVERSION_UNCOMPRESSED};
+
+    memcpy(point + 1, p_raw_data, raw_data_size);
+    p_public_key->p_key = p256_key_new(point, NULL);
+    if (p_public_key->p_key == NULL)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    EVP_PKEY_CTX * p_ctx = EVP_PKEY_CTX_new(p_public_key->p_key, NULL);
+    int            valid = EVP_PKEY_public_check(p_ctx);
+
+    EVP_PKEY_CTX_free(p_ctx);
+    if (valid <= 0)
+    {
+        EVP_PKEY_free(p_public_key->p_key);
+        p_public_key->p_key = NULL;
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_public_key_to_raw(nrf_crypto_ecc_public_key_t const * p_public_key,
+                                            uint8_t * p_raw_data, size_t * p_raw_data_size)
+{
+    nrf_crypto_ecc_curve_info_t const * p_info = p_public_key->p_info;
+
+    if (*p_raw_data_size < p_info->raw_public_key_size)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    *p_raw_data_size = p_info->raw_public_key_size;
+
+    if (is_x25519(p_info))
+    {
+        if (!EVP_PKEY_get_raw_public_key(p_public_key->p_key, p_raw_data, p_raw_data_size))
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+        x25519_copy(p_raw_data, p_raw_data, *p_raw_data_size);
+        return NRF_SUCCESS;
+    }
+
+    uint8_t point[P256_POINT_SIZE];
+    size_t  point_size = 0;
+
+    if (!EVP_PKEY_get_octet_string_param(p_public_key->p_key, OSSL_PKEY_PARAM_PUB_KEY, point, sizeof(point), &point_size) ||
+        (point_size != sizeof(point)))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+    memcpy(p_raw_data, point + 1, P256_POINT_SIZE - 1);
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_private_key_free(nrf_crypto_ecc_private_key_t * p_private_key)
+{
+    EVP_PKEY_free(p_private_key->p_key);
+    p_private_key->p_key = NULL;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_public_key_free(nrf_crypto_ecc_public_key_t * p_public_key)
+{
+    EVP_PKEY_free(p_public_key->p_key);
+    p_public_key->p_key = NULL;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_byte_order_invert(nrf_crypto_ecc_curve_info_t const * p_curve_info,
+                                            uint8_t const * p_raw_input, uint8_t * p_raw_output,
+                                            size_t raw_data_size)
+{
+    // Curve25519 values are one number, secp256r1 public keys two coordinates inverted each.
+    size_t part = is_x25519(p_curve_info) ? raw_data_size : P256_COORD_SIZE;
+
+    if ((raw_data_size % part) != 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    for (size_t offset = 0; offset < raw_data_size; offset += part)
+    {
+        for (size_t i = 0; i < part / 2; i++)
+        {
+            uint8_t low  = p_raw_input[offset + i];
+            uint8_t high = p_raw_input[offset + part - 1 - i];
+
+            p_raw_output[offset + i]            = high;
+            p_raw_output[offset + part - 1 - i] = low;
+        }
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecdh_compute(void * p_context,
+                                   nrf_crypto_ecc_private_key_t const * p_private_key,
+                                   nrf_crypto_ecc_public_key_t const * p_public_key,
+                                   uint8_t * p_shared_secret, size_t * p_shared_secret_size)
+{
+    EVP_PKEY_CTX * p_ctx = EVP_PKEY_CTX_new(p_private_key->p_key, NULL);
+    ret_code_t     err_code = NRF_ERROR_INTERNAL;
+
+    if ((EVP_PKEY_derive_init(p_ctx) > 0) &&
+        (EVP_PKEY_derive_set_peer(p_ctx, p_public_key->p_key) > 0) &&
+        (EVP_PKEY_derive(p_ctx, p_shared_secret, p_shared_secret_size) > 0))
+    {
+        if (is_x25519(p_private_key->p_info))
+        {
+            x25519_copy(p_shared_secret, p_shared_secret, *p_shared_secret_size);
+        }
+        err_code = NRF_SUCCESS;
+    }
+    EVP_PKEY_CTX_free(p_ctx);
+
+    return err_code;
+}
+
+ret_code_t nrf_crypto_rng_vector_generate(uint8_t * p_target, size_t size)
+{
+    return (RAND_bytes(p_target, (int)size) == 1) ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
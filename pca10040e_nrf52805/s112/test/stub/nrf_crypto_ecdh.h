@@ -0,0 +1,19 @@
+/* Host stand-in for the SDK header, implemented on OpenSSL in nrf_crypto_ecc_openssl.c. */
+#ifndef NRF_CRYPTO_ECDH_H__
+#define NRF_CRYPTO_ECDH_H__
+#include "nrf_crypto_ecc.h"
+
+typedef struct
+{
+    uint8_t unused;                 /**< OpenSSL keeps its own state. */
+} nrf_crypto_ecdh_context_t;
+
+typedef uint8_t nrf_crypto_ecdh_secp256r1_shared_secret_t[32];     /**< X, big endian. */
+typedef uint8_t nrf_crypto_ecdh_curve25519_shared_secret_t[32];
+
+ret_code_t nrf_crypto_ecdh_compute(void * p_context,
+                                   nrf_crypto_ecc_private_key_t const * p_private_key,
+                                   nrf_crypto_ecc_public_key_t const * p_public_key,
+                                   uint8_t * p_shared_secret, size_t * p_shared_secret_size);
+
+#endif //NRF_CRYPTO_ECDH_H__
@@ -0,0 +1,6 @@
+/* Host stand-in for the SDK header, declared with the rest in nrf_crypto.h. */
+#ifndef NRF_CRYPTO_HMAC_H__
+#define NRF_CRYPTO_HMAC_H__
+#include "nrf_crypto.h"
+
+#endif //NRF_CRYPTO_HMAC_H__
@@ -0,0 +1,246 @@
+/* Host stand-in for the nrf_crypto AES, AEAD and HKDF backends, on OpenSSL. As on the target, the
+ * AES key is expanded in nrf_crypto_aes_key_set, setting the IV only copies it. */
+#include <stdbool.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "nordic_common.h"
+#include "nrf_crypto.h"
+#include "nrf_crypto_aead.h"
+
+enum
+{
+    MODE_CBC,
+    MODE_CTR,
+    MODE_CCM,
+    MODE_GCM,
+};
+
+nrf_crypto_aes_info_t const  g_nrf_crypto_aes_cbc_256_info = {.key_size = 32, .mode = MODE_CBC};
+nrf_crypto_aes_info_t const  g_nrf_crypto_aes_ctr_128_info = {.key_size = 16, .mode = MODE_CTR};
+nrf_crypto_aead_info_t const g_nrf_crypto_aes_ccm_128_info = {.key_size = 16, .mode = MODE_CCM};
+nrf_crypto_aead_info_t const g_nrf_crypto_aes_gcm_128_info = {.key_size = 16, .mode = MODE_GCM};
+nrf_crypto_hmac_info_t const g_nrf_crypto_hmac_sha256_info = {.digest_size = 32};
+
+/* Fetched once, an implicit fetch on every init would be counted in the benchmarks. */
+static EVP_CIPHER * cipher_get(uint32_t mode)
+{
+    static char const * const names[] = {"AES-256-CBC", "AES-128-CTR", "AES-128-CCM", "AES-128-GCM"};
+    static EVP_CIPHER *       p_ciphers[ARRAY_SIZE(names)];
+
+    if (p_ciphers[mode] == NULL)
+    {
+        p_ciphers[mode] = EVP_CIPHER_fetch(NULL, names[mode], NULL);
+    }
+    return p_ciphers[mode];
+}
+
+ret_code_t nrf_crypto_aes_init(nrf_crypto_aes_context_t * p_context, nrf_crypto_aes_info_t const * p_info,
+                               nrf_crypto_operation_t operation)
+{
+    if (p_context->p_cipher_ctx == NULL)
+    {
+        p_context->p_cipher_ctx = EVP_CIPHER_CTX_new();
+    }
+    p_context->p_info    = p_info;
+    p_context->operation = operation;
+    p_context->key_set   = 0;
+
+    return (p_context->p_cipher_ctx != NULL) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+ret_code_t nrf_crypto_aes_uninit(nrf_crypto_aes_context_t * p_context)
+{
+    // The OpenSSL context is kept for the next init, the key schedule is wiped.
+    UNUSED_RETURN_VALUE(EVP_CIPHER_CTX_reset(p_context->p_cipher_ctx));
+    p_context->key_set = 0;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_key_set(nrf_crypto_aes_context_t * p_context, uint8_t * p_key)
+{
+    if (!EVP_CipherInit_ex(p_context->p_cipher_ctx, cipher_get(p_context->p_info->mode), NULL, p_key, NULL,
+                           p_context->operation == NRF_CRYPTO_ENCRYPT))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+    UNUSED_RETURN_VALUE(EVP_CIPHER_CTX_set_padding(p_context->p_cipher_ctx, 0));
+    p_context->key_set = 1;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_iv_set(nrf_crypto_aes_context_t * p_context, uint8_t * p_iv)
+{
+    if (!p_context->key_set || !EVP_CipherInit_ex(p_context->p_cipher_ctx, NULL, NULL, NULL, p_iv, -1))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_finalize(nrf_crypto_aes_context_t * p_context, uint8_t * p_data_in, size_t data_size,
+                                   uint8_t * p_data_out, size_t * p_data_out_size)
+{
+    int out_len   = 0;
+    int final_len = 0;
+
+    if ((p_context->p_info->mode == MODE_CBC) && ((data_size % 16) != 0))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (*p_data_out_size < data_size)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    if (!EVP_CipherUpdate(p_context->p_cipher_ctx, p_data_out, &out_len, p_data_in, (int)data_size) ||
+        !EVP_CipherFinal_ex(p_context->p_cipher_ctx, p_data_out + out_len, &final_len))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+    *p_data_out_size = (size_t)(out_len + final_len);
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_crypt(nrf_crypto_aes_context_t * p_context, nrf_crypto_aes_info_t const * p_info,
+                                nrf_crypto_operation_t operation, uint8_t * p_key, uint8_t * p_iv,
+                                uint8_t * p_data_in, size_t data_size, uint8_t * p_data_out, size_t * p_data_out_size)
+{
+    ret_code_t err_code = nrf_crypto_aes_init(p_context, p_info, operation);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = nrf_crypto_aes_key_set(p_context, p_key);
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = nrf_crypto_aes_iv_set(p_context, p_iv);
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = nrf_crypto_aes_finalize(p_context, p_data_in, data_size, p_data_out, p_data_out_size);
+    }
+    UNUSED_RETURN_VALUE(nrf_crypto_aes_uninit(p_context));
+
+    return err_code;
+}
+
+ret_code_t nrf_crypto_aead_init(nrf_crypto_aead_context_t * p_context, nrf_crypto_aead_info_t const * p_info,
+                                uint8_t * p_key)
+{
+    p_context->p_cipher_ctx = EVP_CIPHER_CTX_new();
+    p_context->p_info       = p_info;
+    memcpy(p_context->key, p_key, p_info->key_size);
+
+    return (p_context->p_cipher_ctx != NULL) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+ret_code_t nrf_crypto_aead_uninit(void * p_context)
+{
+    nrf_crypto_aead_context_t * p_aead = p_context;
+
+    EVP_CIPHER_CTX_free(p_aead->p_cipher_ctx);
+    p_aead->p_cipher_ctx = NULL;
+    memset(p_aead->key, 0, sizeof(p_aead->key));
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aead_crypt(nrf_crypto_aead_context_t * p_context, nrf_crypto_operation_t operation,
+                                 uint8_t * p_nonce, size_t nonce_size, uint8_t * p_adata, size_t adata_size,
+                                 uint8_t * p_data_in, size_t data_in_size, uint8_t * p_data_out,
+                                 uint8_t * p_mac, size_t mac_size)
+{
+    EVP_CIPHER_CTX * p_ctx   = p_context->p_cipher_ctx;
+    bool             ccm     = (p_context->p_info->mode == MODE_CCM);
+    int              encrypt = (operation == NRF_CRYPTO_ENCRYPT);
+    int              len;
+
+    // OpenSSL expands the key with every nonce, unlike the nrf_crypto backends that key once.
+    if (!EVP_CipherInit_ex(p_ctx, cipher_get(p_context->p_info->mode), NULL, NULL, NULL, encrypt) ||
+        !EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_SET_IVLEN, (int)nonce_size, NULL) ||
+        (ccm && !EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_SET_TAG, (int)mac_size, encrypt ? NULL : p_mac)) ||
+        !EVP_CipherInit_ex(p_ctx, NULL, NULL, p_context->key, p_nonce, encrypt) ||
+        (ccm && !EVP_CipherUpdate(p_ctx, NULL, &len, NULL, (int)data_in_size)) ||
+        ((adata_size > 0) && !EVP_CipherUpdate(p_ctx, NULL, &len, p_adata, (int)adata_size)))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    if (!ccm && !encrypt && !EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_SET_TAG, (int)mac_size, p_mac))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    if (!EVP_CipherUpdate(p_ctx, p_data_out, &len, p_data_in, (int)data_in_size) ||
+        (!ccm && !EVP_CipherFinal_ex(p_ctx, p_data_out + len, &len)))
+    {
+        return encrypt ? NRF_ERROR_INTERNAL : NRF_ERROR_INVALID_DATA;
+    }
+
+    if (encrypt && !EVP_CIPHER_CTX_ctrl(p_ctx, EVP_CTRL_AEAD_GET_TAG, (int)mac_size, p_mac))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_hkdf_calculate(nrf_crypto_hmac_context_t * p_context, nrf_crypto_hmac_info_t const * p_info,
+                                     uint8_t * p_output_key, size_t * p_output_key_size,
+                                     uint8_t const * p_input_key, size_t input_key_size,
+                                     uint8_t const * p_salt, size_t salt_size,
+                                     uint8_t const * p_ainfo, size_t ainfo_size,
+                                     nrf_crypto_hkdf_mode_t mode)
+{
+    static uint8_t const zeros[32];
+    uint8_t              prk[32];
+    uint8_t              block[32];
+    unsigned int         len;
+
+    // RFC 5869, no salt means a salt of zeros.
+    if (mode == NRF_CRYPTO_HKDF_EXTRACT_AND_EXPAND)
+    {
+        if (p_salt == NULL)
+        {
+            p_salt    = zeros;
+            salt_size = sizeof(zeros);
+        }
+        HMAC(EVP_sha256(), p_salt, (int)salt_size, p_input_key, input_key_size, prk, &len);
+    }
+    else
+    {
+        memcpy(prk, p_input_key, sizeof(prk));
+    }
+
+    for (size_t pos = 0, n = 1; pos < *p_output_key_size; n++)
+    {
+        uint8_t msg[32 + 64 + 1];
+        size_t  msg_len = 0;
+
+        if (pos > 0)
+        {
+            memcpy(msg, block, sizeof(block));
+            msg_len = sizeof(block);
+        }
+        if (ainfo_size > 64)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        memcpy(msg + msg_len, p_ainfo, ainfo_size);
+        msg_len += ainfo_size;
+        msg[msg_len++] = (uint8_t)n;
+
+        HMAC(EVP_sha256(), prk, sizeof(prk), msg, msg_len, block, &len);
+
+        size_t count = MIN(sizeof(block), *p_output_key_size - pos);
+        memcpy(p_output_key + pos, block, count);
+        pos += count;
+    }
+
+    return NRF_SUCCESS;
+}
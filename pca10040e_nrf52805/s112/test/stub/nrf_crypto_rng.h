@@ -0,0 +1,10 @@
+/* Host stand-in for the SDK header, implemented on OpenSSL in nrf_crypto_ecc_openssl.c. */
+#ifndef NRF_CRYPTO_RNG_H__
+#define NRF_CRYPTO_RNG_H__
+#include <stddef.h>
+#include <stdint.h>
+#include "app_error.h"
+
+ret_code_t nrf_crypto_rng_vector_generate(uint8_t * p_target, size_t size);
+
+#endif //NRF_CRYPTO_RNG_H__
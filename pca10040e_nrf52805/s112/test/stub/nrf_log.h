@@ -0,0 +1,11 @@
+/* Host stand-in for the SDK header: logging is compiled out. */
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+#define NRF_LOG_ERROR(...)          ((void)0)
+#define NRF_LOG_WARNING(...)        ((void)0)
+#define NRF_LOG_INFO(...)           ((void)0)
+#define NRF_LOG_DEBUG(...)          ((void)0)
+#define NRF_LOG_HEXDUMP_DEBUG(...)  ((void)0)
+
+#endif //NRF_LOG_H_
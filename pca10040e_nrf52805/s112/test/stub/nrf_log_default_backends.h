@@ -0,0 +1,6 @@
+/* Host stand-in for the SDK header. */
+#ifndef NRF_LOG_DEFAULT_BACKENDS_H
+#define NRF_LOG_DEFAULT_BACKENDS_H
+#include "nrf_log.h"
+
+#endif //NRF_LOG_DEFAULT_BACKENDS_H
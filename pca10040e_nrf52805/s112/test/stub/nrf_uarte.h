@@ -0,0 +1,10 @@
+/* Host stand-in for the SDK header, only the types the module headers use. */
+#ifndef NRF_UARTE_H__
+#define NRF_UARTE_H__
+
+typedef enum
+{
+    NRF_UARTE_BAUDRATE_115200 = 0x01D60000,
+} nrf_uarte_baudrate_t;
+
+#endif //NRF_UARTE_H__
@@ -0,0 +1,21 @@
+/* Host stand-in for config/sdk_config.h: the settings the modules under test read, with the same
+ * values. The nrf_crypto backends are all off, the host ones run on OpenSSL. */
+#ifndef SDK_CONFIG_H
+#define SDK_CONFIG_H
+
+#ifndef NRF_CRYPTO_BACKEND_CC310_ENABLED
+#define NRF_CRYPTO_BACKEND_CC310_ENABLED            0
+#endif
+
+#define NRF_CRYPTO_BACKEND_CC310_BL_ENABLED         0
+#define NRF_CRYPTO_BACKEND_MBEDTLS_ENABLED          0
+#define NRF_CRYPTO_BACKEND_OBERON_ENABLED           0
+#define NRF_CRYPTO_BACKEND_CIFRA_ENABLED            0
+#define NRF_CRYPTO_BACKEND_MICRO_ECC_ENABLED        0
+#define NRF_CRYPTO_BACKEND_NRF_HW_RNG_ENABLED       0
+
+#ifndef NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED
+#define NRF_CRYPTO_CURVE25519_BIG_ENDIAN_ENABLED    0
+#endif
+
+#endif //SDK_CONFIG_H
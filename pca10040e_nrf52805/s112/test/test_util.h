@@ -0,0 +1,53 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Host test helpers. Every test program is a plain executable that returns non-zero on failure. */
+
+static int m_test_failures;
+
+/**@brief Count and report a failed condition, then carry on with the test. */
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);        \
+            m_test_failures++;                                                      \
+        }                                                                           \
+    } while (0)
+
+/**@brief Result of the test program, to return from main. */
+static inline int test_result(char const * p_name)
+{
+    printf("%s: %s\n", p_name, (m_test_failures == 0) ? "OK" : "FAILED");
+    return (m_test_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**@brief Host time stamp for the benchmarks, in CPU cycles where the host has a counter. */
+static inline uint64_t test_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**@brief Small deterministic generator, so failures can be reproduced. */
+static inline uint32_t test_rand(uint32_t * p_state)
+{
+    uint32_t x = *p_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *p_state = x;
+    return x;
+}
+
+#endif //TEST_UTIL_H
@@ -0,0 +1,321 @@
+/* UART framing: payloads are framed, concatenated into one stream and fed back in random chunk
+ * splits, and the frames handed over must be the payloads, cut into pieces of the maximum
+ * length. COBS payloads include 253 to 255 byte zero-free runs around the 0xFF group limit.
+ * Also checks the UART_FRAMING_ENCODED_SIZE bound and benchmarks each codec. */
+#include <string.h>
+
+#include "nordic_common.h"
+#include "test_util.h"
+#include "uart_framing.h"
+
+#define MAX_LEN         UART_FRAMING_BUF_SIZE
+#define PAYLOAD_MAX     600
+#define FRAMES          2000
+#define STREAM_SIZE     (FRAMES * UART_FRAMING_ENCODED_SIZE(PAYLOAD_MAX))
+
+static uint8_t m_payload[FRAMES][PAYLOAD_MAX];
+static size_t  m_payload_len[FRAMES];
+static uint8_t m_stream[STREAM_SIZE];
+
+/* Position of the next expected piece. */
+static size_t m_frame;
+static size_t m_offset;
+static bool   m_ok;
+
+/* Skip frames that hand nothing over, the empty ones. */
+static void expect_next(void)
+{
+    while ((m_frame < FRAMES) && (m_offset == m_payload_len[m_frame]))
+    {
+        m_frame++;
+        m_offset = 0;
+    }
+}
+
+static void frame_handler(uint8_t const * p_frame, size_t length)
+{
+    expect_next();
+    if (m_frame == FRAMES)
+    {
+        m_ok = false;
+        return;
+    }
+
+    size_t piece = MIN(m_payload_len[m_frame] - m_offset, (size_t)MAX_LEN);
+    if ((length != piece) || (memcmp(p_frame, &m_payload[m_frame][m_offset], length) != 0))
+    {
+        m_ok = false;
+    }
+    m_offset += piece;
+}
+
+enum
+{
+    PAYLOAD_RANDOM,         /* Random bytes, with zeros. */
+    PAYLOAD_ZERO_FREE,      /* No zero at all. */
+    PAYLOAD_RUNS,           /* Zero-free runs of 253 to 255 bytes between zeros. */
+    PAYLOAD_ZEROS,          /* Only zeros. */
+    PAYLOAD_KIND_COUNT
+};
+
+static size_t payload_fill(uint8_t * p_out, size_t length, int kind, uint32_t * p_seed)
+{
+    size_t run = 253 + test_rand(p_seed) % 3;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t byte = (uint8_t)test_rand(p_seed);
+
+        switch (kind)
+        {
+            case PAYLOAD_RANDOM:
+                break;
+
+            case PAYLOAD_ZERO_FREE:
+                byte |= (byte == 0) ? 1 : 0;
+                break;
+
+            case PAYLOAD_RUNS:
+                byte = ((i % (run + 1)) == run) ? 0 : (uint8_t)(1 + byte % 255);
+                break;
+
+            default:
+                byte = 0;
+                break;
+        }
+        p_out[i] = byte;
+    }
+
+    return length;
+}
+
+/* Payloads of every kind and of lengths around the group and frame limits. */
+static void payloads_build(size_t len_max, bool text, uint32_t * p_seed)
+{
+    static size_t const edges[] = {0, 1, 2, 243, 244, 245, 253, 254, 255, 256, 488, 508, 509};
+
+    for (size_t f = 0; f < FRAMES; f++)
+    {
+        size_t length = ((f % 4) == 0) ? edges[(f / 4) % ARRAY_SIZE(edges)] : test_rand(p_seed) % (len_max + 1);
+        length = MIN(length, len_max);
+
+        // Every edge length comes with every kind of payload.
+        m_payload_len[f] = payload_fill(m_payload[f], length, (f + f / 4) % PAYLOAD_KIND_COUNT, p_seed);
+
+        if (text)
+        {
+            // Keep the trailer out of text payloads.
+            for (size_t i = 0; i < length; i++)
+            {
+                m_payload[f][i] = (m_payload[f][i] == 0xA7) ? 0x41 : m_payload[f][i];
+            }
+        }
+    }
+}
+
+static void feed(uint8_t const * p_stream, size_t length, uint32_t * p_seed)
+{
+    for (size_t pos = 0; pos < length; )
+    {
+        size_t chunk = 1 + test_rand(p_seed) % 96;
+
+        chunk = MIN(chunk, length - pos);
+        uart_framing_rx(p_stream + pos, chunk);
+        pos += chunk;
+    }
+}
+
+static void expect_start(void)
+{
+    m_frame  = 0;
+    m_offset = 0;
+    m_ok     = true;
+}
+
+static void expect_done(char const * p_name)
+{
+    expect_next();
+    CHECK(m_ok);
+    CHECK(m_frame == FRAMES);
+    if (!m_ok || (m_frame != FRAMES))
+    {
+        printf("uart_framing, %s round trip failed at frame %zu\n", p_name, m_frame);
+    }
+}
+
+static void test_binary_round_trip(uart_framing_mode_t mode, char const * p_name)
+{
+    uint32_t seed   = 0x1234 + mode;
+    size_t   length = 0;
+
+    uart_framing_init(mode, MAX_LEN, frame_handler);
+    payloads_build(PAYLOAD_MAX, false, &seed);
+
+    for (size_t f = 0; f < FRAMES; f++)
+    {
+        size_t out_len = sizeof(m_stream) - length;
+        CHECK(uart_framing_encode(m_payload[f], m_payload_len[f], m_stream + length, &out_len) == NRF_SUCCESS);
+        length += out_len;
+    }
+
+    for (int run = 0; run < 4; run++)
+    {
+        expect_start();
+        feed(m_stream, length, &seed);
+        expect_done(p_name);
+    }
+}
+
+/* The text modes send payloads as they are: the trailer is added here, or the line goes idle. */
+static void test_text_round_trip(void)
+{
+    uint32_t seed   = 0x5678;
+    size_t   length = 0;
+
+    uart_framing_init(UART_FRAMING_TRAILER, MAX_LEN, frame_handler);
+    payloads_build(MAX_LEN - FRAME_SCANNER_TRAILER_LEN, true, &seed);
+    for (size_t f = 0; f < FRAMES; f++)
+    {
+        // Empty frames are handed over in trailer mode, they are skipped here.
+        if (m_payload_len[f] == 0)
+        {
+            m_payload[f][0]  = 0x41;
+            m_payload_len[f] = 1;
+        }
+        memcpy(m_stream + length, m_payload[f], m_payload_len[f]);
+        length += m_payload_len[f];
+        memcpy(m_stream + length, "\xA5\xA6\xA7", FRAME_SCANNER_TRAILER_LEN);
+        length += FRAME_SCANNER_TRAILER_LEN;
+    }
+    expect_start();
+    feed(m_stream, length, &seed);
+    expect_done("trailer");
+
+    uart_framing_mode_set(UART_FRAMING_TRANSPARENT);
+    payloads_build(PAYLOAD_MAX, false, &seed);
+    expect_start();
+    for (size_t f = 0; f < FRAMES; f++)
+    {
+        feed(m_payload[f], m_payload_len[f], &seed);
+        uart_framing_idle();
+    }
+    expect_done("transparent");
+}
+
+/* Encoded size against the bound, with a guard after the output, for every length up to beyond
+ * two COBS groups. The zero-free payload is the worst case and must meet the bound exactly. */
+static void test_encoded_size(void)
+{
+    static uint8_t payload[PAYLOAD_MAX];
+    static uint8_t out[UART_FRAMING_ENCODED_SIZE(PAYLOAD_MAX) + 4];
+    uint32_t       seed = 99;
+
+    uart_framing_init(UART_FRAMING_COBS, MAX_LEN, frame_handler);
+
+    for (size_t length = 0; length <= PAYLOAD_MAX; length++)
+    {
+        for (int kind = 0; kind < PAYLOAD_KIND_COUNT; kind++)
+        {
+            size_t bound   = UART_FRAMING_ENCODED_SIZE(length);
+            size_t out_len = bound;
+
+            payload_fill(payload, length, kind, &seed);
+            memset(out, 0xEE, sizeof(out));
+
+            CHECK(uart_framing_encode(payload, length, out, &out_len) == NRF_SUCCESS);
+            CHECK(out_len <= bound);
+            CHECK(out[bound] == 0xEE);
+            CHECK(out[out_len - 1] == 0x00);
+            CHECK(memchr(out, 0x00, out_len - 1) == NULL);
+            if ((kind == PAYLOAD_ZERO_FREE) && (length > 0))
+            {
+                CHECK(out_len == bound);
+            }
+
+            out_len = bound - 1;
+            CHECK(uart_framing_encode(payload, length, out, &out_len) == NRF_ERROR_NO_MEM);
+        }
+    }
+
+    // A 254 byte zero-free run fills a group: 0xFF, the run, an empty group, the delimiter.
+    size_t out_len = sizeof(out);
+    memset(payload, 0x11, 254);
+    CHECK(uart_framing_encode(payload, 254, out, &out_len) == NRF_SUCCESS);
+    CHECK(out_len == 257);
+    CHECK((out[0] == 0xFF) && (out[255] == 0x01) && (out[256] == 0x00));
+}
+
+static void null_handler(uint8_t const * p_frame, size_t length)
+{
+    m_offset += length;
+}
+
+static void bench_codec(uart_framing_mode_t mode, char const * p_name)
+{
+    enum { FRAMES_BENCH = 4000, REPEAT = 10 };
+
+    static uint8_t payload[MAX_LEN];
+    static uint8_t stream[FRAMES_BENCH * UART_FRAMING_ENCODED_SIZE(MAX_LEN)];
+    uint32_t       seed   = 3;
+    size_t         length = 0;
+
+    payload_fill(payload, sizeof(payload), PAYLOAD_RANDOM, &seed);
+    uart_framing_init(mode, MAX_LEN, null_handler);
+
+    uint64_t start = test_cycles();
+    for (int r = 0; r < REPEAT; r++)
+    {
+        length = 0;
+        for (size_t f = 0; f < FRAMES_BENCH; f++)
+        {
+            size_t out_len = sizeof(stream) - length;
+            UNUSED_RETURN_VALUE(uart_framing_encode(payload, sizeof(payload), stream + length, &out_len));
+            length += out_len;
+        }
+    }
+    uint64_t encode_cycles = test_cycles() - start;
+
+    if (mode == UART_FRAMING_TRAILER)
+    {
+        // Text payloads go back through the scanner with a trailer.
+        length = 0;
+        for (size_t f = 0; f < FRAMES_BENCH; f++)
+        {
+            memcpy(stream + length, payload, MAX_LEN - FRAME_SCANNER_TRAILER_LEN);
+            length += MAX_LEN - FRAME_SCANNER_TRAILER_LEN;
+            memcpy(stream + length, "\xA5\xA6\xA7", FRAME_SCANNER_TRAILER_LEN);
+            length += FRAME_SCANNER_TRAILER_LEN;
+        }
+    }
+
+    m_offset = 0;
+    start    = test_cycles();
+    for (int r = 0; r < REPEAT; r++)
+    {
+        for (size_t pos = 0; pos < length; pos += 64)
+        {
+            uart_framing_rx(stream + pos, MIN(64, length - pos));
+        }
+    }
+    uint64_t decode_cycles = test_cycles() - start;
+
+    CHECK(m_offset > 0);
+    printf("uart_framing, %-11s: encode %.2f cycles/byte, decode %.2f cycles/byte\n", p_name,
+           (double)encode_cycles / ((double)REPEAT * FRAMES_BENCH * sizeof(payload)),
+           (double)decode_cycles / ((double)REPEAT * length));
+}
+
+int main(void)
+{
+    test_binary_round_trip(UART_FRAMING_LENGTH, "length");
+    test_binary_round_trip(UART_FRAMING_COBS, "COBS");
+    test_text_round_trip();
+    test_encoded_size();
+
+    bench_codec(UART_FRAMING_TRAILER, "trailer");
+    bench_codec(UART_FRAMING_TRANSPARENT, "transparent");
+    bench_codec(UART_FRAMING_LENGTH, "length");
+    bench_codec(UART_FRAMING_COBS, "COBS");
+
+    return test_result("uart_framing_test");
+}
@@ -0,0 +1,354 @@
+/* Chunked reception against a fake UART: a byte source with bursts and idle gaps, an EasyDMA
+ * model that fills the armed chunks, RTS flow control while no chunk is armed, and the idle
+ * timer. Checks that the delivered stream equals the sent one, that every idle gap ends in one
+ * RX_IDLE after all its bytes, and the short transfer, error, pause and stop handling. */
+#include <string.h>
+
+#include "nordic_common.h"
+#include "test_util.h"
+#include "uart_rx_chunk.h"
+
+#define STREAM_LEN      200000
+#define TICK_BYTES      20      /* Idle timer period, in byte times. */
+
+/* Fake UARTE with EasyDMA: the chunks it owns, in the order they are filled. */
+static struct
+{
+    uint8_t * p_buf[2];
+    uint8_t   count;
+    size_t    filled;           /* Bytes in p_buf[0]. */
+    bool      rxdrdy;
+    bool      fail_arm;
+    uint32_t  arm_calls;
+} m_uarte;
+
+static uart_rx_chunk_t m_rx;
+
+/* What the application saw. */
+static uint8_t  m_received[STREAM_LEN];
+static size_t   m_received_len;
+static uint32_t m_data_evts;
+static uint32_t m_idle_evts;
+static uint32_t m_error_evts;
+static uint32_t m_last_error;
+static size_t   m_sent_len;     /* Bytes the fake UART has taken off the line. */
+static bool     m_idle_ok;
+
+static ret_code_t fake_arm(uint8_t * p_buf, size_t length)
+{
+    m_uarte.arm_calls++;
+    if (m_uarte.fail_arm || (m_uarte.count == 2))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    CHECK(length == UART_DMA_RX_CHUNK_SIZE);
+    m_uarte.p_buf[m_uarte.count++] = p_buf;
+    return NRF_SUCCESS;
+}
+
+/* Hand the chunk being filled back, as ENDRX does. */
+static void fake_endrx(void)
+{
+    uint8_t * p_buf  = m_uarte.p_buf[0];
+    size_t    filled = m_uarte.filled;
+
+    m_uarte.p_buf[0] = m_uarte.p_buf[1];
+    m_uarte.count--;
+    m_uarte.filled = 0;
+
+    uart_rx_chunk_done(&m_rx, p_buf, filled);
+}
+
+/* One byte arrives. Returns false if RTS holds the sender off because nothing is armed. */
+static bool fake_rx_byte(uint8_t byte)
+{
+    if (m_uarte.count == 0)
+    {
+        return false;
+    }
+
+    m_uarte.p_buf[0][m_uarte.filled++] = byte;
+    m_uarte.rxdrdy = true;
+    m_sent_len++;
+
+    if (m_uarte.filled == UART_DMA_RX_CHUNK_SIZE)
+    {
+        fake_endrx();
+    }
+    return true;
+}
+
+/* STOPRX: the chunk being filled ends short, the secondary one is released. */
+static void fake_abort(void)
+{
+    CHECK(m_uarte.count > 0);
+    m_uarte.count = 1;
+    fake_endrx();
+}
+
+static void fake_error(uint32_t error_mask)
+{
+    m_uarte.count  = 0;
+    m_uarte.filled = 0;
+    uart_rx_chunk_error(&m_rx, error_mask);
+}
+
+static void fake_tick(void)
+{
+    bool byte_seen = m_uarte.rxdrdy;
+
+    m_uarte.rxdrdy = false;
+    if (uart_rx_chunk_idle_check(&m_rx, byte_seen))
+    {
+        fake_abort();
+    }
+}
+
+static void fake_reset(void)
+{
+    memset(&m_uarte, 0, sizeof(m_uarte));
+    m_received_len = 0;
+    m_data_evts    = 0;
+    m_idle_evts    = 0;
+    m_error_evts   = 0;
+    m_sent_len     = 0;
+    m_idle_ok      = true;
+}
+
+static void evt_handler(uart_dma_evt_t const * p_evt)
+{
+    switch (p_evt->type)
+    {
+        case UART_DMA_EVT_RX_DATA:
+            CHECK(p_evt->data.rx.length > 0);
+            CHECK(p_evt->data.rx.length <= UART_DMA_RX_CHUNK_SIZE);
+            if (m_received_len + p_evt->data.rx.length <= sizeof(m_received))
+            {
+                memcpy(m_received + m_received_len, p_evt->data.rx.p_data, p_evt->data.rx.length);
+            }
+            m_received_len += p_evt->data.rx.length;
+            m_data_evts++;
+            break;
+
+        case UART_DMA_EVT_RX_IDLE:
+            // Every byte taken off the line must have been delivered by now.
+            if (m_received_len != m_sent_len)
+            {
+                m_idle_ok = false;
+            }
+            m_idle_evts++;
+            break;
+
+        case UART_DMA_EVT_COMM_ERROR:
+            m_last_error = p_evt->data.error_mask;
+            m_error_evts++;
+            break;
+    }
+}
+
+static void test_chunk_events(void)
+{
+    fake_reset();
+    uart_rx_chunk_init(&m_rx, fake_arm, evt_handler);
+    uart_rx_chunk_arm(&m_rx);
+    CHECK(m_uarte.count == 2);
+    CHECK(m_uarte.p_buf[0] != m_uarte.p_buf[1]);
+    CHECK(uart_rx_chunk_is_armed(&m_rx));
+
+    // A full chunk is data only, and its buffer is armed again.
+    for (int i = 0; i < UART_DMA_RX_CHUNK_SIZE; i++)
+    {
+        fake_rx_byte((uint8_t)i);
+    }
+    CHECK(m_data_evts == 1);
+    CHECK(m_idle_evts == 0);
+    CHECK(m_received_len == UART_DMA_RX_CHUNK_SIZE);
+    CHECK(m_uarte.count == 2);
+    CHECK(m_rx.armed == 2);
+
+    // A short chunk is an abort: data, then idle, then both chunks armed again.
+    for (int i = 0; i < 10; i++)
+    {
+        fake_rx_byte((uint8_t)i);
+    }
+    fake_abort();
+    CHECK(m_data_evts == 2);
+    CHECK(m_idle_evts == 1);
+    CHECK(m_idle_ok);
+    CHECK(m_received_len == UART_DMA_RX_CHUNK_SIZE + 10);
+    CHECK(m_rx.armed == 2);
+    CHECK(m_uarte.count == 2);
+
+    // An abort with nothing received is idle only.
+    fake_abort();
+    CHECK(m_data_evts == 2);
+    CHECK(m_idle_evts == 2);
+
+    // The idle timer needs one tick with bytes and one without before it aborts.
+    CHECK(!uart_rx_chunk_idle_check(&m_rx, false));
+    CHECK(!uart_rx_chunk_idle_check(&m_rx, true));
+    CHECK(uart_rx_chunk_idle_check(&m_rx, false));
+    CHECK(!uart_rx_chunk_idle_check(&m_rx, false));
+
+    // Errors drop both chunks and are reported, reception goes on.
+    fake_rx_byte(0x55);
+    fake_error(0x4);
+    CHECK(m_error_evts == 1);
+    CHECK(m_last_error == 0x4);
+    CHECK(m_rx.armed == 2);
+    CHECK(m_uarte.count == 2);
+
+    // A failed arm leaves the chunk with the module.
+    fake_abort();
+    m_uarte.count    = 0;
+    m_rx.armed       = 0;
+    m_uarte.fail_arm = true;
+    uart_rx_chunk_arm(&m_rx);
+    CHECK(!uart_rx_chunk_is_armed(&m_rx));
+    m_uarte.fail_arm = false;
+    uart_rx_chunk_arm(&m_rx);
+    CHECK(m_rx.armed == 2);
+
+    // Paused: armed chunks are still delivered, but not armed again.
+    uart_rx_chunk_pause(&m_rx, true);
+    for (int i = 0; i < 2 * UART_DMA_RX_CHUNK_SIZE; i++)
+    {
+        CHECK(fake_rx_byte((uint8_t)i));
+    }
+    CHECK(!uart_rx_chunk_is_armed(&m_rx));
+    CHECK(!fake_rx_byte(0));
+    uart_rx_chunk_pause(&m_rx, false);
+    CHECK(m_rx.armed == 2);
+
+    // Stopped: the abort is requested and nothing is armed afterwards, until reset.
+    CHECK(uart_rx_chunk_stop(&m_rx));
+    fake_abort();
+    CHECK(!uart_rx_chunk_is_armed(&m_rx));
+    CHECK(!uart_rx_chunk_stop(&m_rx));
+    uart_rx_chunk_reset(&m_rx);
+    m_uarte.count = 0;
+    uart_rx_chunk_arm(&m_rx);
+    CHECK(m_rx.armed == 2);
+}
+
+/* Bursts of random length with idle gaps of random length, optionally with the application
+ * pausing reception at random. */
+static void test_stream(bool with_pause)
+{
+    static uint8_t stream[STREAM_LEN];
+    uint32_t       seed   = with_pause ? 0x2545F491u : 0x9E3779B9u;
+    uint32_t       bursts = 0;
+    size_t         pos    = 0;
+    uint32_t       time   = 0;
+
+    fake_reset();
+    uart_rx_chunk_init(&m_rx, fake_arm, evt_handler);
+    uart_rx_chunk_arm(&m_rx);
+
+    for (size_t i = 0; i < sizeof(stream); i++)
+    {
+        stream[i] = (uint8_t)test_rand(&seed);
+    }
+
+    while (pos < sizeof(stream))
+    {
+        size_t burst = 1 + test_rand(&seed) % 300;
+        size_t gap   = (test_rand(&seed) % 2) ? 0 : 3 * TICK_BYTES + test_rand(&seed) % 100;
+
+        burst = MIN(burst, sizeof(stream) - pos);
+        if (gap == 0)
+        {
+            // Back to back with the next burst, no idle detected in between.
+            gap = 1;
+        }
+        else
+        {
+            bursts++;
+        }
+
+        for (size_t sent = 0; sent < burst + gap; time++)
+        {
+            if (with_pause && ((test_rand(&seed) % 64) == 0))
+            {
+                uart_rx_chunk_pause(&m_rx, !m_rx.paused);
+            }
+
+            if ((sent >= burst) || fake_rx_byte(stream[pos]))
+            {
+                if (sent < burst)
+                {
+                    pos++;
+                }
+                sent++;
+            }
+
+            if ((time % TICK_BYTES) == 0)
+            {
+                fake_tick();
+            }
+        }
+    }
+
+    // Let the last bytes go idle.
+    uart_rx_chunk_pause(&m_rx, false);
+    for (int i = 0; i < 3; i++)
+    {
+        fake_tick();
+    }
+
+    CHECK(m_sent_len == sizeof(stream));
+    CHECK(m_received_len == sizeof(stream));
+    CHECK(memcmp(m_received, stream, sizeof(stream)) == 0);
+    CHECK(m_idle_ok);
+    if (!with_pause)
+    {
+        // One idle per gap, plus the end of the stream if it did not end in a gap.
+        CHECK((m_idle_evts == bursts) || (m_idle_evts == bursts + 1));
+    }
+    CHECK(m_idle_evts > 0);
+
+    printf("uart_rx_chunk, stream%s: %zu bytes, %u data, %u idle events, %u gaps\n",
+           with_pause ? " with pauses" : "", m_received_len, m_data_evts, m_idle_evts, bursts);
+}
+
+static void count_handler(uart_dma_evt_t const * p_evt)
+{
+    m_received_len += (p_evt->type == UART_DMA_EVT_RX_DATA) ? p_evt->data.rx.length : 0;
+}
+
+static ret_code_t bench_arm(uint8_t * p_buf, size_t length)
+{
+    return NRF_SUCCESS;
+}
+
+/* Cost of the chunk bookkeeping per received byte, as seen from the UARTE interrupt. */
+static void bench_chunks(void)
+{
+    enum { CHUNKS = 1000000 };
+
+    fake_reset();
+    uart_rx_chunk_init(&m_rx, bench_arm, count_handler);
+    uart_rx_chunk_arm(&m_rx);
+
+    uint64_t start = test_cycles();
+    for (uint32_t i = 0; i < CHUNKS; i++)
+    {
+        uart_rx_chunk_done(&m_rx, m_rx.buf[i % UART_DMA_RX_CHUNK_COUNT], UART_DMA_RX_CHUNK_SIZE);
+    }
+    uint64_t cycles = test_cycles() - start;
+
+    CHECK(m_received_len == (size_t)CHUNKS * UART_DMA_RX_CHUNK_SIZE);
+    printf("uart_rx_chunk, RX_DONE: %.1f cycles per chunk, %.3f cycles per byte\n",
+           (double)cycles / CHUNKS, (double)cycles / ((double)CHUNKS * UART_DMA_RX_CHUNK_SIZE));
+}
+
+int main(void)
+{
+    test_chunk_events();
+    test_stream(false);
+    test_stream(true);
+    bench_chunks();
+
+    return test_result("uart_rx_chunk_test");
+}